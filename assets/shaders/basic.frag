@@ -1,18 +1,47 @@
-#version 460 core
+#version 450 core
 
 layout (location = 0) in vec2 TexCoords;
 layout (location = 1) in vec3 Normal;
 layout (location = 2) in vec3 FragPos;
+layout (location = 3) in float Light;
+// Baked ambient occlusion, 0 in a corner closed on both sides to 1 in the open
+layout (location = 4) in float Occlusion;
 out vec4 FragColor;
 
 uniform vec3 sunPosition;
 uniform vec3 eye;
 uniform sampler2D sampler;
 
+// ShadowMaps::CASCADES
+const int CASCADES = 3;
+uniform int shadows;
+uniform mat4 shadowMatrices[CASCADES];
+uniform sampler2DArrayShadow shadowMap;
+
+// 1 where the sun reaches the fragment. The nearest cascade containing it is used, fragments close to a cascade's
+// border go to the next one so filtering never reads outside the map.
+float Shadow(vec3 normal) {
+  if (shadows == 0) {
+    return 1.0;
+  }
+
+  // Pushed off the surface a little against acne on faces the sun grazes
+  vec3 position = FragPos + normal * 0.05;
+  for (int i = 0; i < CASCADES; ++i) {
+    vec3 coords = (shadowMatrices[i] * vec4(position, 1.0)).xyz * 0.5 + 0.5;
+    if (all(greaterThan(coords.xy, vec2(0.01))) && all(lessThan(coords.xy, vec2(0.99))) && coords.z <= 1.0) {
+      return texture(shadowMap, vec4(coords.xy, i, coords.z));
+    }
+  }
+
+  return 1.0;
+}
+
 void main() {
-  float ambientStrength = 0.1;
+  // Dark corners keep some light, fully occluded ones would look like holes
+  float occlusion = mix(0.45, 1.0, Occlusion);
   vec3 lightColor = vec3(1.0, 1.0, 1.0);
-  vec3 ambient = 0.1 * lightColor;
+  vec3 ambient = 0.2 * occlusion * lightColor;
 
   vec3 normal = normalize(Normal);
   vec3 lightDir = normalize(sunPosition - FragPos);
@@ -25,5 +54,10 @@ void main() {
   float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
   vec3 specular = specularStrength * spec * lightColor;
 
-  FragColor = vec4((ambient + diffuse + specular), 1.0) * texture(sampler, TexCoords);
+  // Baked sky and block light, keep a little so caves aren't pitch black. Occlusion darkens the sky light in corners.
+  float light = max(Light * occlusion, 0.05);
+
+  float shadow = Shadow(normal);
+
+  FragColor = vec4((ambient + (diffuse + specular) * shadow) * light, 1.0) * texture(sampler, TexCoords);
 }
@@ -1,21 +1,49 @@
-#version 460 core
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
 
 layout (location = 0) in vec3 inPos;
 layout (location = 1) in vec2 inTexCoords;
 layout (location = 2) in vec3 inNormal;
+layout (location = 3) in float inLight;
+layout (location = 4) in float inOcclusion;
 
 layout (location = 0) out vec2 TexCoords;
 layout (location = 1) out vec3 Normal;
 layout (location = 2) out vec3 FragPos;
+layout (location = 3) out float Light;
+layout (location = 4) out float Occlusion;
+
+struct ChunkRecord {
+  vec4 origin;
+  vec4 boundsMin;
+  vec4 boundsMax;
+  uint first;
+  uint count;
+  uint faces[6];
+};
+
+// Filled by the occlusion culler, indirect draws find their chunk through the base instance
+layout (std430, binding = 0) readonly buffer Chunks {
+  ChunkRecord chunks[];
+};
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
+uniform int indirect;
 
 void main() {
-  gl_Position = projection * view * model * vec4(inPos, 1.0);
+  mat4 chunkModel = model;
+  if (indirect != 0) {
+    chunkModel = mat4(1.0);
+    chunkModel[3] = vec4(chunks[gl_BaseInstanceARB].origin.xyz, 1.0);
+  }
+
+  gl_Position = projection * view * chunkModel * vec4(inPos, 1.0);
   TexCoords = inTexCoords;
-  FragPos = vec3(model * vec4(inPos, 1.0));
-  Normal = mat3(transpose(inverse(model))) * inNormal;
+  FragPos = vec3(chunkModel * vec4(inPos, 1.0));
+  Light = inLight;
+  Occlusion = inOcclusion;
+  Normal = mat3(transpose(inverse(chunkModel))) * inNormal;
 }
 
@@ -0,0 +1,5 @@
+#version 450 core
+
+// Depth only, the shadow maps have no color attachment
+void main() {
+}
@@ -0,0 +1,10 @@
+#version 450 core
+
+layout (location = 0) in vec3 inPos;
+
+uniform mat4 viewProjection;
+uniform mat4 model;
+
+void main() {
+  gl_Position = viewProjection * model * vec4(inPos, 1.0);
+}
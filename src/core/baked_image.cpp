@@ -0,0 +1,250 @@
+#include "baked_image.h"
+#include "SDL3/SDL_log.h"
+#include <SDL3_image/SDL_image.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static const char *CACHE_DIRECTORY = "cache/assets";
+static const char MAGIC[4] = {'V', 'X', 'B', 'I'};
+static const size_t HEADER_SIZE = sizeof(MAGIC) + 4 * sizeof(uint32_t);
+
+bool BakedImage::sEnabled = true;
+
+void BakedImage::SetEnabled(bool enabled) {
+  sEnabled = enabled;
+}
+
+BakedImage::BakedImage() : mData(nullptr), mSize(0), mWidth(0), mHeight(0), mLevels(0), mLayers(0) {
+}
+
+BakedImage::~BakedImage() {
+#ifndef _WIN32
+  if (mData && mOwned.empty()) {
+    munmap(const_cast<unsigned char *>(mData), mSize);
+  }
+#endif
+}
+
+static std::string bakedPath(const std::string &source, const std::string &variant) {
+  std::string name = source;
+  for (auto &c : name) {
+    if (c == '/' || c == '\\' || c == '.') {
+      c = '_';
+    }
+  }
+
+  return std::string(CACHE_DIRECTORY) + "/" + name + "." + variant + ".bin";
+}
+
+std::unique_ptr<BakedImage> BakedImage::Load(const std::string &source, const std::string &variant, bool mipmaps,
+                                             const Splitter &split) {
+  auto path = bakedPath(source, variant);
+
+  std::error_code error;
+  if (sEnabled && std::filesystem::exists(path, error) &&
+      std::filesystem::last_write_time(path, error) >= std::filesystem::last_write_time(source, error)) {
+    auto image = Open(path);
+    if (image) {
+      return image;
+    }
+  }
+
+  SDL_Surface *image = IMG_Load(source.c_str());
+  if (!image) {
+    SDL_Log("Failed to load image: %s", source.c_str());
+    return nullptr;
+  }
+
+  // Everything is uploaded as RGBA8 no matter what the PNG contains
+  SDL_Surface *converted = SDL_ConvertSurface(image, SDL_PIXELFORMAT_RGBA32);
+  SDL_DestroySurface(image);
+  if (!converted) {
+    SDL_Log("Failed to convert image (%s): %s", source.c_str(), SDL_GetError());
+    return nullptr;
+  }
+
+  auto data = Bake(converted, mipmaps, split);
+  SDL_DestroySurface(converted);
+
+  if (sEnabled) {
+    std::filesystem::create_directories(CACHE_DIRECTORY, error);
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(data.data()), data.size());
+    if (out) {
+      SDL_Log("Baked image %s into %s", source.c_str(), path.c_str());
+    } else {
+      SDL_Log("Failed to write baked image: %s", path.c_str());
+    }
+  }
+
+  return FromMemory(std::move(data));
+}
+
+std::vector<unsigned char> BakedImage::Bake(SDL_Surface *surface, bool mipmaps, const Splitter &split) {
+  auto layers = split(surface);
+  int width = layers.front()->w;
+  int height = layers.front()->h;
+
+  int levels = 1;
+  if (mipmaps) {
+    while ((width >> levels) > 0 || (height >> levels) > 0) {
+      levels++;
+    }
+  }
+
+  std::vector<unsigned char> data(HEADER_SIZE);
+  std::memcpy(data.data(), MAGIC, sizeof(MAGIC));
+  uint32_t header[4] = {static_cast<uint32_t>(width), static_cast<uint32_t>(height), static_cast<uint32_t>(levels),
+                        static_cast<uint32_t>(layers.size())};
+  std::memcpy(data.data() + sizeof(MAGIC), header, sizeof(header));
+
+  for (auto *layer : layers) {
+    // Level 0 comes straight from the surface, dropping any row padding
+    std::vector<unsigned char> level(width * height * 4);
+    for (int y = 0; y < height; ++y) {
+      std::memcpy(level.data() + y * width * 4, static_cast<unsigned char *>(layer->pixels) + y * layer->pitch,
+                  width * 4);
+    }
+    data.insert(data.end(), level.begin(), level.end());
+
+    // Every further level is a 2x2 box filter of the previous one, like glGenerateMipmap
+    int levelWidth = width, levelHeight = height;
+    for (int i = 1; i < levels; ++i) {
+      int nextWidth = std::max(1, levelWidth / 2);
+      int nextHeight = std::max(1, levelHeight / 2);
+      std::vector<unsigned char> next(nextWidth * nextHeight * 4);
+      for (int y = 0; y < nextHeight; ++y) {
+        for (int x = 0; x < nextWidth; ++x) {
+          int x0 = std::min(2 * x, levelWidth - 1), x1 = std::min(2 * x + 1, levelWidth - 1);
+          int y0 = std::min(2 * y, levelHeight - 1), y1 = std::min(2 * y + 1, levelHeight - 1);
+          for (int c = 0; c < 4; ++c) {
+            int sum = level[(y0 * levelWidth + x0) * 4 + c] + level[(y0 * levelWidth + x1) * 4 + c] +
+                      level[(y1 * levelWidth + x0) * 4 + c] + level[(y1 * levelWidth + x1) * 4 + c];
+            next[(y * nextWidth + x) * 4 + c] = (sum + 2) / 4;
+          }
+        }
+      }
+
+      data.insert(data.end(), next.begin(), next.end());
+      level.swap(next);
+      levelWidth = nextWidth;
+      levelHeight = nextHeight;
+    }
+
+    if (layer != surface) {
+      SDL_DestroySurface(layer);
+    }
+  }
+
+  return data;
+}
+
+std::unique_ptr<BakedImage> BakedImage::Open(const std::string &path) {
+#ifdef _WIN32
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  if (!in) {
+    return nullptr;
+  }
+
+  std::vector<unsigned char> data(static_cast<size_t>(in.tellg()));
+  in.seekg(0);
+  in.read(reinterpret_cast<char *>(data.data()), data.size());
+  return FromMemory(std::move(data));
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  off_t size = lseek(fd, 0, SEEK_END);
+  void *mapped = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return nullptr;
+  }
+
+  auto image = std::unique_ptr<BakedImage>(new BakedImage());
+  image->mData = static_cast<const unsigned char *>(mapped);
+  image->mSize = size;
+  if (!image->ParseHeader()) {
+    SDL_Log("Ignoring invalid baked image: %s", path.c_str());
+    return nullptr;
+  }
+
+  return image;
+#endif
+}
+
+std::unique_ptr<BakedImage> BakedImage::FromMemory(std::vector<unsigned char> data) {
+  auto image = std::unique_ptr<BakedImage>(new BakedImage());
+  image->mOwned = std::move(data);
+  image->mData = image->mOwned.data();
+  image->mSize = image->mOwned.size();
+  if (!image->ParseHeader()) {
+    return nullptr;
+  }
+
+  return image;
+}
+
+bool BakedImage::ParseHeader() {
+  if (mSize < HEADER_SIZE || std::memcmp(mData, MAGIC, sizeof(MAGIC)) != 0) {
+    return false;
+  }
+
+  uint32_t header[4];
+  std::memcpy(header, mData + sizeof(MAGIC), sizeof(header));
+  mWidth = header[0];
+  mHeight = header[1];
+  mLevels = header[2];
+  mLayers = header[3];
+
+  size_t expected = HEADER_SIZE;
+  for (int level = 0; level < mLevels; ++level) {
+    expected += static_cast<size_t>(std::max(1, mWidth >> level)) * std::max(1, mHeight >> level) * 4 * mLayers;
+  }
+
+  return mWidth > 0 && mHeight > 0 && mLevels > 0 && mLayers > 0 && expected == mSize;
+}
+
+int BakedImage::Width() const {
+  return mWidth;
+}
+
+int BakedImage::Height() const {
+  return mHeight;
+}
+
+int BakedImage::Levels() const {
+  return mLevels;
+}
+
+int BakedImage::Layers() const {
+  return mLayers;
+}
+
+BakedLevel BakedImage::Level(int layer, int level) const {
+  size_t layerSize = 0;
+  for (int i = 0; i < mLevels; ++i) {
+    layerSize += static_cast<size_t>(std::max(1, mWidth >> i)) * std::max(1, mHeight >> i) * 4;
+  }
+
+  size_t offset = HEADER_SIZE + layer * layerSize;
+  for (int i = 0; i < level; ++i) {
+    offset += static_cast<size_t>(std::max(1, mWidth >> i)) * std::max(1, mHeight >> i) * 4;
+  }
+
+  return BakedLevel{
+      .width = std::max(1, mWidth >> level),
+      .height = std::max(1, mHeight >> level),
+      .pixels = mData + offset,
+  };
+}
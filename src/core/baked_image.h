@@ -0,0 +1,57 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct BakedLevel {
+  int width;
+  int height;
+  const unsigned char *pixels;
+};
+
+// RGBA8 image with all of its layers and mip levels laid out ready for upload. Baked images live under cache/assets
+// and are memory mapped, so loading one costs a page fault per page instead of a PNG decode.
+//
+// Layout: "VXBI", u32 width, u32 height, u32 levels, u32 layers, then the pixels of every level of layer 0, every level
+// of layer 1, ...
+class BakedImage {
+public:
+  // Splits the decoded source image into the layers to bake. It receives a RGBA32 surface and returns surfaces of equal
+  // size which are destroyed by the caller.
+  using Splitter = std::function<std::vector<SDL_Surface *>(SDL_Surface *)>;
+
+  // Loads the baked version of `source`, baking it first if it's missing or older than the source file. `variant`
+  // tells apart different bakes of the same source.
+  static std::unique_ptr<BakedImage> Load(const std::string &source, const std::string &variant, bool mipmaps,
+                                          const Splitter &split);
+  // Without baking, every load decodes the source again
+  static void SetEnabled(bool enabled);
+
+  ~BakedImage();
+
+  int Width() const;
+  int Height() const;
+  int Levels() const;
+  int Layers() const;
+  BakedLevel Level(int layer, int level) const;
+
+private:
+  BakedImage();
+
+  static bool sEnabled;
+
+  const unsigned char *mData;
+  size_t mSize;
+  // Only used when the image was decoded instead of mapped
+  std::vector<unsigned char> mOwned;
+
+  int mWidth, mHeight, mLevels, mLayers;
+
+  static std::unique_ptr<BakedImage> Open(const std::string &path);
+  static std::vector<unsigned char> Bake(SDL_Surface *surface, bool mipmaps, const Splitter &split);
+  static std::unique_ptr<BakedImage> FromMemory(std::vector<unsigned char> data);
+  bool ParseHeader();
+};
@@ -0,0 +1,25 @@
+#include "benchmark.h"
+#include "SDL3/SDL_log.h"
+
+std::ofstream OpenBenchmarkOutput(const std::string &path) {
+  std::ofstream out(path);
+  if (!out) {
+    SDL_Log("Failed to write benchmark results: %s", path.c_str());
+  }
+  return out;
+}
+
+BenchmarkCsv::BenchmarkCsv(const std::string &path) : mOut(OpenBenchmarkOutput(path)), mFirstTable(true) {
+}
+
+bool BenchmarkCsv::Ok() const {
+  return static_cast<bool>(mOut);
+}
+
+void BenchmarkCsv::Table(const char *columns) {
+  if (!mFirstTable) {
+    mOut << '\n';
+  }
+  mOut << columns << '\n';
+  mFirstTable = false;
+}
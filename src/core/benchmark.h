@@ -0,0 +1,55 @@
+#pragma once
+
+#include "SDL3/SDL_timer.h"
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+// Timing and output shared by the benchmarks of voxel_bench and the game's headless modes
+
+// A difference of SDL_GetPerformanceCounter() values in milliseconds
+inline float TicksToMs(Uint64 ticks) {
+  return static_cast<float>(ticks) / SDL_GetPerformanceFrequency() * 1000.0f;
+}
+
+// Milliseconds since start, a SDL_GetPerformanceCounter() value
+inline float ElapsedMs(Uint64 start) {
+  return TicksToMs(SDL_GetPerformanceCounter() - start);
+}
+
+// Calls run() runs times and returns the fastest of them in milliseconds, the one the rest of the system disturbed the
+// least
+template <typename Run> float BestOfRuns(int runs, Run &&run) {
+  float best = 1e9f;
+  for (int i = 0; i < runs; ++i) {
+    auto start = SDL_GetPerformanceCounter();
+    run();
+    best = std::min(best, ElapsedMs(start));
+  }
+  return best;
+}
+
+// Creates a results file, logs if that fails
+std::ofstream OpenBenchmarkOutput(const std::string &path);
+
+// Results file with one or more CSV tables, separated by empty lines
+class BenchmarkCsv {
+public:
+  // Logs if the file can't be created, which Ok() then reports
+  BenchmarkCsv(const std::string &path);
+
+  bool Ok() const;
+
+  // Starts a table, columns are the comma separated column names
+  void Table(const char *columns);
+
+  template <typename First, typename... Rest> void Row(const First &first, const Rest &...rest) {
+    mOut << first;
+    ((mOut << ',' << rest), ...);
+    mOut << '\n';
+  }
+
+private:
+  std::ofstream mOut;
+  bool mFirstTable;
+};
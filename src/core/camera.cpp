@@ -44,8 +44,13 @@ void Camera::HandleKeyboardEvent(const KeyboardState &keyboard) {
 
 void Camera::HandleMouseEvent(const glm::vec2 &relative) {
   float turnSpeed = 0.1f;
-  mYaw += relative.x * turnSpeed;
-  mPitch -= relative.y * turnSpeed;
+  SetPose(mPosition, mYaw + relative.x * turnSpeed, mPitch - relative.y * turnSpeed);
+}
+
+void Camera::SetPose(const glm::vec3 &position, float yaw, float pitch) {
+  mPosition = position;
+  mYaw = yaw;
+  mPitch = pitch;
 
   if (mPitch > 89.0f) {
     mPitch = 89.0f;
@@ -70,3 +75,15 @@ glm::mat4 Camera::GetView() const {
 glm::vec3 Camera::GetPosition() const {
   return mPosition;
 }
+
+glm::vec3 Camera::GetFront() const {
+  return mFront;
+}
+
+float Camera::GetYaw() const {
+  return mYaw;
+}
+
+float Camera::GetPitch() const {
+  return mPitch;
+}
@@ -10,9 +10,13 @@ public:
 
   void HandleMouseEvent(const glm::vec2 &relative);
   void HandleKeyboardEvent(const KeyboardState &keyboard);
+  void SetPose(const glm::vec3 &position, float yaw, float pitch);
 
   glm::mat4 GetView() const;
   glm::vec3 GetPosition() const;
+  glm::vec3 GetFront() const;
+  float GetYaw() const;
+  float GetPitch() const;
 
 private:
   glm::vec3 mPosition, mFront, mUp;
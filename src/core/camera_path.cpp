@@ -0,0 +1,74 @@
+#include "camera_path.h"
+#include "SDL3/SDL_log.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// Yaw in degrees, turning the short way round: -135 to 180 is a 45 degree turn, not 315
+float MixYaw(float from, float to, float blend) {
+  float difference = std::fmod(to - from, 360.0f);
+  if (difference > 180.0f) {
+    difference -= 360.0f;
+  } else if (difference < -180.0f) {
+    difference += 360.0f;
+  }
+  return from + difference * blend;
+}
+
+} // namespace
+
+std::optional<CameraPath> CameraPath::Load(const std::string &path) {
+  std::ifstream in(path);
+  if (!in) {
+    SDL_Log("Failed to load camera path: %s", path.c_str());
+    return std::nullopt;
+  }
+
+  std::vector<CameraPose> keyframes;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    CameraPose pose;
+    std::istringstream stream(line);
+    if (!(stream >> pose.position.x >> pose.position.y >> pose.position.z >> pose.yaw >> pose.pitch)) {
+      SDL_Log("Invalid camera path keyframe (%s): %s", path.c_str(), line.c_str());
+      return std::nullopt;
+    }
+
+    keyframes.push_back(pose);
+  }
+
+  if (keyframes.empty()) {
+    SDL_Log("Camera path has no keyframes: %s", path.c_str());
+    return std::nullopt;
+  }
+
+  return CameraPath(keyframes);
+}
+
+CameraPath::CameraPath(const std::vector<CameraPose> &keyframes) : mKeyframes(keyframes) {
+}
+
+CameraPose CameraPath::Sample(float t) const {
+  if (mKeyframes.size() == 1) {
+    return mKeyframes.front();
+  }
+
+  float position = std::clamp(t, 0.0f, 1.0f) * (mKeyframes.size() - 1);
+  size_t index = std::min(static_cast<size_t>(position), mKeyframes.size() - 2);
+  float blend = position - index;
+
+  const auto &from = mKeyframes[index];
+  const auto &to = mKeyframes[index + 1];
+  return CameraPose{
+      .position = glm::mix(from.position, to.position, blend),
+      .yaw = MixYaw(from.yaw, to.yaw, blend),
+      .pitch = glm::mix(from.pitch, to.pitch, blend),
+  };
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct CameraPose {
+  glm::vec3 position;
+  float yaw;
+  float pitch;
+};
+
+// Scripted camera path made of keyframes which are spread evenly over the path. The file has one keyframe per line as
+// "x y z yaw pitch", empty lines and lines starting with # are ignored.
+class CameraPath {
+public:
+  static std::optional<CameraPath> Load(const std::string &path);
+
+  CameraPath(const std::vector<CameraPose> &keyframes);
+
+  // t goes from 0.0f (first keyframe) to 1.0f (last keyframe)
+  CameraPose Sample(float t) const;
+
+private:
+  std::vector<CameraPose> mKeyframes;
+};
@@ -0,0 +1,88 @@
+#include "frame_benchmark.h"
+#include "SDL3/SDL_log.h"
+#include "benchmark.h"
+#include <algorithm>
+
+FrameBenchmark::FrameBenchmark(int frames) : mFrames(frames), mFrame(0), mFrameStart(0), mQueries(2 * frames) {
+  glGenQueries(mQueries.size(), mQueries.data());
+  mCpuMs.reserve(frames);
+}
+
+FrameBenchmark::~FrameBenchmark() {
+  glDeleteQueries(mQueries.size(), mQueries.data());
+}
+
+void FrameBenchmark::BeginFrame() {
+  mFrameStart = SDL_GetPerformanceCounter();
+  glQueryCounter(mQueries[2 * mFrame], GL_TIMESTAMP);
+}
+
+void FrameBenchmark::EndFrame() {
+  glQueryCounter(mQueries[2 * mFrame + 1], GL_TIMESTAMP);
+  mCpuMs.push_back(ElapsedMs(mFrameStart));
+  mFrame++;
+}
+
+bool FrameBenchmark::Done() const {
+  return mFrame >= mFrames;
+}
+
+float FrameBenchmark::Progress() const {
+  return static_cast<float>(mFrame) / std::max(1, mFrames - 1);
+}
+
+bool FrameBenchmark::Write(const std::string &path) {
+  std::vector<float> gpuMs;
+  for (int i = 0; i < mFrame; ++i) {
+    GLuint64 start = 0, end = 0;
+    glGetQueryObjectui64v(mQueries[2 * i], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(mQueries[2 * i + 1], GL_QUERY_RESULT, &end);
+    gpuMs.push_back((end - start) / 1000000.0f);
+  }
+
+  bool written = path.ends_with(".json") ? WriteJson(path, gpuMs) : WriteCsv(path, gpuMs);
+  if (!written) {
+    return false;
+  }
+
+  if (mFrame > 0) {
+    auto sorted = mCpuMs;
+    std::sort(sorted.begin(), sorted.end());
+    float total = 0.0f;
+    for (auto ms : gpuMs) {
+      total += ms;
+    }
+    SDL_Log("Benchmark: %d frames, CPU median %.2f ms, p99 %.2f ms, GPU avg %.2f ms", mFrame, sorted[sorted.size() / 2],
+            sorted[sorted.size() * 99 / 100], total / mFrame);
+  }
+
+  return true;
+}
+
+bool FrameBenchmark::WriteCsv(const std::string &path, const std::vector<float> &gpuMs) const {
+  BenchmarkCsv out(path);
+  if (!out.Ok()) {
+    return false;
+  }
+
+  out.Table("frame,cpu_ms,gpu_ms");
+  for (int i = 0; i < mFrame; ++i) {
+    out.Row(i, mCpuMs[i], gpuMs[i]);
+  }
+  return true;
+}
+
+bool FrameBenchmark::WriteJson(const std::string &path, const std::vector<float> &gpuMs) const {
+  auto out = OpenBenchmarkOutput(path);
+  if (!out) {
+    return false;
+  }
+
+  out << "{\n  \"frames\": [\n";
+  for (int i = 0; i < mFrame; ++i) {
+    out << "    {\"frame\": " << i << ", \"cpu_ms\": " << mCpuMs[i] << ", \"gpu_ms\": " << gpuMs[i] << "}"
+        << (i + 1 < mFrame ? ",\n" : "\n");
+  }
+  out << "  ]\n}\n";
+  return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+// Records CPU and GPU time for every frame of a benchmark run. GPU time comes from a pair of GL_TIMESTAMP queries per
+// frame (GL_TIME_ELAPSED can't be used as the passes inside the frame are timed with it), the queries are only read
+// back when the results are written so the run itself never waits on the GPU.
+class FrameBenchmark {
+public:
+  FrameBenchmark(int frames);
+  ~FrameBenchmark();
+
+  void BeginFrame();
+  void EndFrame();
+  bool Done() const;
+  // How far along the run the current frame is, from 0.0f to 1.0f
+  float Progress() const;
+
+  // Writes JSON if the path ends in .json, CSV otherwise
+  bool Write(const std::string &path);
+
+private:
+  int mFrames;
+  int mFrame;
+  unsigned long mFrameStart;
+  // Start and end timestamp of every frame
+  std::vector<GLuint> mQueries;
+  std::vector<float> mCpuMs;
+
+  bool WriteCsv(const std::string &path, const std::vector<float> &gpuMs) const;
+  bool WriteJson(const std::string &path, const std::vector<float> &gpuMs) const;
+};
@@ -0,0 +1,143 @@
+#include "gpu_profiler.h"
+#include "SDL3/SDL_log.h"
+#include <algorithm>
+#include <fstream>
+
+std::vector<GpuProfiler::Scope> GpuProfiler::sScopes{};
+int GpuProfiler::sActiveScope = -1;
+unsigned long GpuProfiler::sFrame = 0;
+RenderCounters GpuProfiler::sCounters{};
+RenderCounters GpuProfiler::sLastCounters{};
+
+void GpuProfiler::BeginFrame() {
+  sCounters = {};
+}
+
+void GpuProfiler::EndFrame() {
+  sLastCounters = sCounters;
+  sFrame++;
+}
+
+void GpuProfiler::Collect(Scope &scope, int slot) {
+  if (!scope.pending[slot]) {
+    return;
+  }
+
+  // Three frames should always be enough, if the driver is further behind than that drop the sample instead of waiting
+  GLint available = 0;
+  glGetQueryObjectiv(scope.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+  scope.pending[slot] = false;
+  if (!available) {
+    return;
+  }
+
+  GLuint64 elapsed = 0;
+  glGetQueryObjectui64v(scope.queries[slot], GL_QUERY_RESULT, &elapsed);
+  scope.samples.push_back(elapsed / 1000000.0f);
+  if (scope.samples.size() > HISTORY) {
+    scope.samples.pop_front();
+  }
+}
+
+void GpuProfiler::BeginScope(const std::string &name) {
+  auto it = std::find_if(sScopes.begin(), sScopes.end(), [&](const Scope &scope) { return scope.name == name; });
+  if (it == sScopes.end()) {
+    Scope scope{.name = name, .queries = {}, .pending = {}, .samples = {}};
+    glGenQueries(FRAMES_IN_FLIGHT, scope.queries);
+    sScopes.push_back(scope);
+    it = sScopes.end() - 1;
+  }
+
+  int slot = sFrame % FRAMES_IN_FLIGHT;
+  Collect(*it, slot);
+
+  glBeginQuery(GL_TIME_ELAPSED, it->queries[slot]);
+  it->pending[slot] = true;
+  sActiveScope = it - sScopes.begin();
+}
+
+void GpuProfiler::EndScope() {
+  if (sActiveScope < 0) {
+    return;
+  }
+
+  glEndQuery(GL_TIME_ELAPSED);
+  sActiveScope = -1;
+}
+
+void GpuProfiler::CountDraw(long triangles) {
+  sCounters.drawCalls++;
+  sCounters.triangles += triangles;
+}
+
+void GpuProfiler::CountStateChange() {
+  sCounters.stateChanges++;
+}
+
+void GpuProfiler::CountSkippedVertices(long vertices) {
+  sCounters.skippedVertices += vertices;
+}
+
+std::vector<GpuScopeStats> GpuProfiler::GetScopeStats() {
+  std::vector<GpuScopeStats> result;
+  for (auto &scope : sScopes) {
+    GpuScopeStats stats{.name = scope.name, .lastMs = 0.0f, .avgMs = 0.0f, .minMs = 0.0f, .maxMs = 0.0f, .samples = 0};
+    if (!scope.samples.empty()) {
+      stats.lastMs = scope.samples.back();
+      stats.minMs = *std::min_element(scope.samples.begin(), scope.samples.end());
+      stats.maxMs = *std::max_element(scope.samples.begin(), scope.samples.end());
+      for (auto sample : scope.samples) {
+        stats.avgMs += sample;
+      }
+      stats.avgMs /= scope.samples.size();
+      stats.samples = scope.samples.size();
+    }
+
+    result.push_back(stats);
+  }
+
+  return result;
+}
+
+RenderCounters GpuProfiler::GetCounters() {
+  return sLastCounters;
+}
+
+bool GpuProfiler::WriteJson(const std::string &path) {
+  std::ofstream out(path);
+  if (!out) {
+    SDL_Log("Failed to write GPU statistics: %s", path.c_str());
+    return false;
+  }
+
+  auto scopes = GetScopeStats();
+  out << "{\n  \"scopes\": [\n";
+  for (size_t i = 0; i < scopes.size(); ++i) {
+    auto &scope = scopes[i];
+    out << "    {\"name\": \"" << scope.name << "\", \"last_ms\": " << scope.lastMs << ", \"avg_ms\": " << scope.avgMs
+        << ", \"min_ms\": " << scope.minMs << ", \"max_ms\": " << scope.maxMs << ", \"samples\": " << scope.samples
+        << "}" << (i + 1 < scopes.size() ? ",\n" : "\n");
+  }
+
+  auto counters = GetCounters();
+  out << "  ],\n  \"counters\": {\"draw_calls\": " << counters.drawCalls << ", \"triangles\": " << counters.triangles
+      << ", \"state_changes\": " << counters.stateChanges << ", \"skipped_vertices\": " << counters.skippedVertices
+      << "}\n}\n";
+  return true;
+}
+
+void GpuProfiler::Cleanup() {
+  for (auto &scope : sScopes) {
+    glDeleteQueries(FRAMES_IN_FLIGHT, scope.queries);
+  }
+
+  sScopes.clear();
+}
+
+GpuScope::GpuScope(const std::string &name) {
+  GpuProfiler::BeginScope(name);
+}
+
+GpuScope::~GpuScope() {
+  GpuProfiler::EndScope();
+}
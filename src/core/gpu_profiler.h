@@ -0,0 +1,71 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+struct GpuScopeStats {
+  std::string name;
+  float lastMs;
+  float avgMs;
+  float minMs;
+  float maxMs;
+  int samples;
+};
+
+struct RenderCounters {
+  int drawCalls;
+  long triangles;
+  int stateChanges;
+  // Vertices of face directions that point away from the camera and weren't drawn
+  long skippedVertices;
+};
+
+// Times named render passes on the GPU. Every scope cycles through FRAMES_IN_FLIGHT GL_TIME_ELAPSED queries and only
+// reads back the one issued that many frames ago, so reading results never stalls the pipeline. Scopes must not nest.
+class GpuProfiler {
+public:
+  static const int FRAMES_IN_FLIGHT = 3;
+  // Number of frames the rolling statistics are computed over
+  static const int HISTORY = 120;
+
+  static void BeginFrame();
+  static void EndFrame();
+
+  static void BeginScope(const std::string &name);
+  static void EndScope();
+
+  static void CountDraw(long triangles);
+  static void CountStateChange();
+  static void CountSkippedVertices(long vertices);
+
+  static std::vector<GpuScopeStats> GetScopeStats();
+  // Counters of the last completed frame
+  static RenderCounters GetCounters();
+
+  static bool WriteJson(const std::string &path);
+  static void Cleanup();
+
+private:
+  struct Scope {
+    std::string name;
+    GLuint queries[FRAMES_IN_FLIGHT];
+    bool pending[FRAMES_IN_FLIGHT];
+    std::deque<float> samples;
+  };
+
+  static std::vector<Scope> sScopes;
+  static int sActiveScope;
+  static unsigned long sFrame;
+  static RenderCounters sCounters, sLastCounters;
+
+  static void Collect(Scope &scope, int slot);
+};
+
+// Times everything until the end of the enclosing block
+class GpuScope {
+public:
+  GpuScope(const std::string &name);
+  ~GpuScope();
+};
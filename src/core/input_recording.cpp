@@ -0,0 +1,125 @@
+#include "input_recording.h"
+#include "SDL3/SDL_log.h"
+#include <cstring>
+#include <fstream>
+
+static const char MAGIC[4] = {'V', 'X', 'I', 'N'};
+static const uint32_t VERSION = 1;
+
+template <typename T> static void WriteValue(std::ofstream &out, const T &value) {
+  out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T> static bool ReadValue(std::ifstream &in, T &value) {
+  return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+std::optional<InputRecording> InputRecording::Load(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    SDL_Log("Failed to load input recording: %s", path.c_str());
+    return std::nullopt;
+  }
+
+  char magic[4];
+  uint32_t version, tickRate, tickCount, recordCount;
+  if (!ReadValue(in, magic) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || !ReadValue(in, version) ||
+      version != VERSION || !ReadValue(in, tickRate) || !ReadValue(in, tickCount) || !ReadValue(in, recordCount)) {
+    SDL_Log("Invalid input recording header: %s", path.c_str());
+    return std::nullopt;
+  }
+
+  InputRecording recording(tickRate);
+  recording.mTickCount = tickCount;
+  recording.mRecords.reserve(recordCount);
+  for (uint32_t i = 0; i < recordCount; ++i) {
+    Entry record;
+    if (!ReadValue(in, record.tick) || !ReadValue(in, record.keys) || !ReadValue(in, record.mouse.x) ||
+        !ReadValue(in, record.mouse.y)) {
+      SDL_Log("Input recording is truncated: %s", path.c_str());
+      return std::nullopt;
+    }
+
+    recording.mRecords.push_back(record);
+  }
+
+  return recording;
+}
+
+InputRecording::InputRecording(uint32_t tickRate) : mTickRate(tickRate), mTickCount(0), mLastKeys(0), mCursor(0) {
+}
+
+uint8_t InputRecording::PackKeys(const KeyboardState &keyboard) {
+  uint8_t keys = 0;
+  for (int i = 0; i < static_cast<int>(Key::ALL); ++i) {
+    keys |= keyboard.pressed[i] ? (1 << i) : 0;
+  }
+
+  return keys;
+}
+
+KeyboardState InputRecording::UnpackKeys(uint8_t keys) {
+  KeyboardState keyboard;
+  for (int i = 0; i < static_cast<int>(Key::ALL); ++i) {
+    keyboard.pressed[i] = keys & (1 << i);
+  }
+
+  return keyboard;
+}
+
+void InputRecording::Record(uint32_t tick, const TickInput &input) {
+  uint8_t keys = PackKeys(input.keyboard);
+  if (keys != mLastKeys || input.mouse.x != 0.0f || input.mouse.y != 0.0f) {
+    mRecords.push_back({.tick = tick, .keys = keys, .mouse = input.mouse});
+    mLastKeys = keys;
+  }
+
+  mTickCount = tick + 1;
+}
+
+bool InputRecording::Save(const std::string &path) const {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    SDL_Log("Failed to save input recording: %s", path.c_str());
+    return false;
+  }
+
+  out.write(MAGIC, sizeof(MAGIC));
+  WriteValue(out, VERSION);
+  WriteValue(out, mTickRate);
+  WriteValue(out, mTickCount);
+  WriteValue(out, static_cast<uint32_t>(mRecords.size()));
+  for (auto &record : mRecords) {
+    WriteValue(out, record.tick);
+    WriteValue(out, record.keys);
+    WriteValue(out, record.mouse.x);
+    WriteValue(out, record.mouse.y);
+  }
+
+  SDL_Log("Saved input recording (%s): %u ticks, %zu records", path.c_str(), mTickCount, mRecords.size());
+  return true;
+}
+
+std::optional<TickInput> InputRecording::Replay(uint32_t tick) {
+  if (tick >= mTickCount) {
+    return std::nullopt;
+  }
+
+  TickInput input{.keyboard = {}, .mouse = {0.0f, 0.0f}};
+  if (mCursor < mRecords.size() && mRecords[mCursor].tick == tick) {
+    mLastKeys = mRecords[mCursor].keys;
+    input.mouse = mRecords[mCursor].mouse;
+    mCursor++;
+  }
+
+  input.keyboard = UnpackKeys(mLastKeys);
+  return input;
+}
+
+uint32_t InputRecording::TickRate() const {
+  return mTickRate;
+}
+
+uint32_t InputRecording::TickCount() const {
+  return mTickCount;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "keyboard.h"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Input for one simulation tick, mouse is the relative motion accumulated during the tick
+struct TickInput {
+  KeyboardState keyboard;
+  glm::vec2 mouse;
+};
+
+// Binary input recording. Only ticks where a key changed or the mouse moved are stored, the keyboard state carries over
+// to the ticks in between.
+//
+// Layout (little endian): "VXIN", u32 version, u32 tick rate, u32 tick count, u32 record count, then for every record
+// u32 tick, u8 key mask, f32 mouse x, f32 mouse y.
+class InputRecording {
+public:
+  static std::optional<InputRecording> Load(const std::string &path);
+
+  InputRecording(uint32_t tickRate);
+
+  void Record(uint32_t tick, const TickInput &input);
+  bool Save(const std::string &path) const;
+
+  // Returns nothing once the recording is over
+  std::optional<TickInput> Replay(uint32_t tick);
+
+  uint32_t TickRate() const;
+  uint32_t TickCount() const;
+
+private:
+  struct Entry {
+    uint32_t tick;
+    uint8_t keys;
+    glm::vec2 mouse;
+  };
+
+  uint32_t mTickRate;
+  uint32_t mTickCount;
+  std::vector<Entry> mRecords;
+
+  uint8_t mLastKeys;
+  size_t mCursor;
+
+  static uint8_t PackKeys(const KeyboardState &keyboard);
+  static KeyboardState UnpackKeys(uint8_t keys);
+};
@@ -7,6 +7,7 @@ enum class Key {
   Down,
   Jump,
   Crouch,
+  Sand,
   ALL,
 };
 
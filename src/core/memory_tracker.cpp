@@ -0,0 +1,175 @@
+#include "memory_tracker.h"
+#include "SDL3/SDL_log.h"
+#include "SDL3/SDL_stdinc.h"
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+const char *CPU_NAMES[] = {"chunks", "voxels", "light", "meshes", "caches", "scratch"};
+const char *GPU_NAMES[] = {"mesh_pool", "chunk_buffers", "streaming", "atlas", "textures", "sky", "culling", "shadows",
+                           "meshing"};
+
+static_assert(std::size(CPU_NAMES) == static_cast<size_t>(MemoryTag::Count));
+static_assert(std::size(GPU_NAMES) == static_cast<size_t>(GpuTag::Count));
+
+float Megabytes(size_t bytes) {
+  return bytes / (1024.0f * 1024.0f);
+}
+
+void WriteCounter(std::ofstream &out, const MemoryCounter &counter) {
+  out << "{\"name\": \"" << counter.name << "\", \"current_bytes\": " << counter.current
+      << ", \"peak_bytes\": " << counter.peak << ", \"count\": " << counter.count << "}";
+}
+
+void WriteGroup(std::ofstream &out, const char *name, const MemoryCounter &total,
+                const std::vector<MemoryCounter> &counters) {
+  out << "  \"" << name << "\": {\n    \"total\": ";
+  WriteCounter(out, total);
+  out << ",\n    \"tags\": [\n";
+  for (size_t i = 0; i < counters.size(); ++i) {
+    out << "      ";
+    WriteCounter(out, counters[i]);
+    out << (i + 1 < counters.size() ? ",\n" : "\n");
+  }
+  out << "    ]\n  }";
+}
+
+} // namespace
+
+MemoryTracker::Counter MemoryTracker::sCpu[static_cast<int>(MemoryTag::Count)]{};
+MemoryTracker::Counter MemoryTracker::sCpuTotal{};
+MemoryTracker::Counter MemoryTracker::sGpu[static_cast<int>(GpuTag::Count)]{};
+MemoryTracker::Counter MemoryTracker::sGpuTotal{};
+std::unordered_map<GLuint, MemoryTracker::Resource> MemoryTracker::sBuffers{};
+std::unordered_map<GLuint, MemoryTracker::Resource> MemoryTracker::sTextures{};
+
+void MemoryTracker::Counter::Add(size_t bytes) {
+  size_t now = current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  count.fetch_add(1, std::memory_order_relaxed);
+
+  size_t highest = peak.load(std::memory_order_relaxed);
+  while (now > highest && !peak.compare_exchange_weak(highest, now, std::memory_order_relaxed)) {
+  }
+}
+
+void MemoryTracker::Counter::Remove(size_t bytes) {
+  current.fetch_sub(bytes, std::memory_order_relaxed);
+  count.fetch_sub(1, std::memory_order_relaxed);
+}
+
+MemoryCounter MemoryTracker::Counter::Read(const std::string &name) const {
+  return {name, current.load(std::memory_order_relaxed), peak.load(std::memory_order_relaxed),
+          count.load(std::memory_order_relaxed)};
+}
+
+void MemoryTracker::Allocate(MemoryTag tag, size_t bytes) {
+  sCpu[static_cast<int>(tag)].Add(bytes);
+  sCpuTotal.Add(bytes);
+}
+
+void MemoryTracker::Free(MemoryTag tag, size_t bytes) {
+  sCpu[static_cast<int>(tag)].Remove(bytes);
+  sCpuTotal.Remove(bytes);
+}
+
+void MemoryTracker::Register(std::unordered_map<GLuint, Resource> &resources, GLuint name, GpuTag tag,
+                             size_t bytes) {
+  // Storage can be respecified with glBufferData, only the latest size counts
+  Release(resources, name);
+  resources[name] = {tag, bytes};
+  sGpu[static_cast<int>(tag)].Add(bytes);
+  sGpuTotal.Add(bytes);
+}
+
+void MemoryTracker::Release(std::unordered_map<GLuint, Resource> &resources, GLuint name) {
+  auto it = resources.find(name);
+  if (it == resources.end()) {
+    return;
+  }
+
+  sGpu[static_cast<int>(it->second.tag)].Remove(it->second.bytes);
+  sGpuTotal.Remove(it->second.bytes);
+  resources.erase(it);
+}
+
+void MemoryTracker::RegisterBuffer(GLuint buffer, GpuTag tag, size_t bytes) {
+  Register(sBuffers, buffer, tag, bytes);
+}
+
+void MemoryTracker::RegisterTexture(GLuint texture, GpuTag tag, size_t bytes) {
+  Register(sTextures, texture, tag, bytes);
+}
+
+void MemoryTracker::ReleaseBuffer(GLuint buffer) {
+  Release(sBuffers, buffer);
+}
+
+void MemoryTracker::ReleaseTexture(GLuint texture) {
+  Release(sTextures, texture);
+}
+
+size_t MemoryTracker::TextureBytes(int width, int height, int levels, int bytesPerTexel) {
+  size_t bytes = 0;
+  for (int level = 0; level < levels; ++level) {
+    bytes += static_cast<size_t>(width) * height * bytesPerTexel;
+    width = std::max(width / 2, 1);
+    height = std::max(height / 2, 1);
+  }
+  return bytes;
+}
+
+MemorySnapshot MemoryTracker::Snapshot() {
+  MemorySnapshot snapshot;
+  for (int i = 0; i < static_cast<int>(MemoryTag::Count); ++i) {
+    snapshot.cpu.push_back(sCpu[i].Read(CPU_NAMES[i]));
+  }
+  for (int i = 0; i < static_cast<int>(GpuTag::Count); ++i) {
+    snapshot.gpu.push_back(sGpu[i].Read(GPU_NAMES[i]));
+  }
+  snapshot.cpuTotal = sCpuTotal.Read("total");
+  snapshot.gpuTotal = sGpuTotal.Read("total");
+  return snapshot;
+}
+
+bool MemoryTracker::WriteJson(const std::string &path) {
+  std::ofstream out(path);
+  if (!out) {
+    SDL_Log("Failed to write memory statistics: %s", path.c_str());
+    return false;
+  }
+
+  auto snapshot = Snapshot();
+  out << "{\n";
+  WriteGroup(out, "cpu", snapshot.cpuTotal, snapshot.cpu);
+  out << ",\n";
+  WriteGroup(out, "gpu", snapshot.gpuTotal, snapshot.gpu);
+  out << "\n}\n";
+  return true;
+}
+
+void MemoryTracker::LogSummary() {
+  auto snapshot = Snapshot();
+  auto log = [](const char *side, const MemoryCounter &total, const std::vector<MemoryCounter> &counters) {
+    std::string tags;
+    for (const auto &counter : counters) {
+      char entry[96];
+      SDL_snprintf(entry, sizeof(entry), "%s%s %.2f", tags.empty() ? "" : ", ", counter.name.c_str(),
+                   Megabytes(counter.current));
+      tags += entry;
+    }
+    SDL_Log("%s memory: %.2f MB (peak %.2f MB): %s", side, Megabytes(total.current), Megabytes(total.peak),
+            tags.c_str());
+  };
+
+  log("CPU", snapshot.cpuTotal, snapshot.cpu);
+  log("GPU", snapshot.gpuTotal, snapshot.gpu);
+}
+
+MemoryScope::MemoryScope(MemoryTag tag, size_t bytes) : mTag(tag), mBytes(bytes) {
+  MemoryTracker::Allocate(mTag, mBytes);
+}
+
+MemoryScope::~MemoryScope() {
+  MemoryTracker::Free(mTag, mBytes);
+}
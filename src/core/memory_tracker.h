@@ -0,0 +1,120 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Owners of CPU heap memory
+enum class MemoryTag {
+  Chunks,
+  Voxels,
+  Light,
+  Meshes,
+  Caches,
+  Scratch,
+  Count
+};
+
+// Owners of GPU buffers and textures
+enum class GpuTag {
+  MeshPool,
+  ChunkBuffers,
+  Streaming,
+  Atlas,
+  Textures,
+  Sky,
+  Culling,
+  Shadows,
+  Meshing,
+  Count
+};
+
+struct MemoryCounter {
+  std::string name;
+  size_t current;
+  size_t peak;
+  // Live allocations or resources
+  long count;
+};
+
+struct MemorySnapshot {
+  std::vector<MemoryCounter> cpu;
+  std::vector<MemoryCounter> gpu;
+  MemoryCounter cpuTotal;
+  MemoryCounter gpuTotal;
+};
+
+// Bytes in use per owner, with the peak since startup. CPU counters can be updated from any thread; GPU resources are
+// registered by GL name when they are created and released when they are deleted, so only from the GL thread.
+class MemoryTracker {
+public:
+  static void Allocate(MemoryTag tag, size_t bytes);
+  static void Free(MemoryTag tag, size_t bytes);
+
+  static void RegisterBuffer(GLuint buffer, GpuTag tag, size_t bytes);
+  static void RegisterTexture(GLuint texture, GpuTag tag, size_t bytes);
+  // Deleting name 0 is fine, like with glDelete*
+  static void ReleaseBuffer(GLuint buffer);
+  static void ReleaseTexture(GLuint texture);
+
+  // Storage of a 2D texture with the given number of mip levels
+  static size_t TextureBytes(int width, int height, int levels, int bytesPerTexel);
+
+  // The GPU side must only be read from the GL thread
+  static MemorySnapshot Snapshot();
+  static bool WriteJson(const std::string &path);
+  static void LogSummary();
+
+private:
+  struct Counter {
+    std::atomic<size_t> current;
+    std::atomic<size_t> peak;
+    std::atomic<long> count;
+
+    void Add(size_t bytes);
+    void Remove(size_t bytes);
+    MemoryCounter Read(const std::string &name) const;
+  };
+
+  struct Resource {
+    GpuTag tag;
+    size_t bytes;
+  };
+
+  static Counter sCpu[static_cast<int>(MemoryTag::Count)];
+  static Counter sCpuTotal;
+  static Counter sGpu[static_cast<int>(GpuTag::Count)];
+  static Counter sGpuTotal;
+  static std::unordered_map<GLuint, Resource> sBuffers;
+  static std::unordered_map<GLuint, Resource> sTextures;
+
+  static void Register(std::unordered_map<GLuint, Resource> &resources, GLuint name, GpuTag tag, size_t bytes);
+  static void Release(std::unordered_map<GLuint, Resource> &resources, GLuint name);
+};
+
+// Shared object whose bytes are counted under the tag for as long as it lives
+template <typename T> std::shared_ptr<const T> MakeTracked(MemoryTag tag, size_t bytes, T *object) {
+  MemoryTracker::Allocate(tag, bytes);
+  return std::shared_ptr<const T>(object, [tag, bytes](const T *object) {
+    MemoryTracker::Free(tag, bytes);
+    delete object;
+  });
+}
+
+// Counts short lived working memory until the end of the enclosing block
+class MemoryScope {
+public:
+  MemoryScope(MemoryTag tag, size_t bytes);
+  ~MemoryScope();
+
+  MemoryScope(const MemoryScope &) = delete;
+  MemoryScope &operator=(const MemoryScope &) = delete;
+
+private:
+  MemoryTag mTag;
+  size_t mBytes;
+};
@@ -0,0 +1,58 @@
+#include "range_allocator.h"
+#include <iterator>
+
+RangeAllocator::RangeAllocator(size_t capacity) : mCapacity(capacity), mUsed(0) {
+  if (capacity > 0) {
+    mFree.emplace(0, capacity);
+  }
+}
+
+std::optional<RangeAllocation> RangeAllocator::Allocate(size_t size) {
+  if (size == 0) {
+    return std::nullopt;
+  }
+
+  for (auto it = mFree.begin(); it != mFree.end(); ++it) {
+    auto [offset, available] = *it;
+    if (available < size) {
+      continue;
+    }
+
+    mFree.erase(it);
+    if (available > size) {
+      mFree.emplace(offset + size, available - size);
+    }
+
+    mUsed += size;
+    return RangeAllocation{offset, size};
+  }
+
+  return std::nullopt;
+}
+
+void RangeAllocator::Free(const RangeAllocation &allocation) {
+  mUsed -= allocation.size;
+  auto [it, inserted] = mFree.emplace(allocation.offset, allocation.size);
+
+  auto next = std::next(it);
+  if (next != mFree.end() && it->first + it->second == next->first) {
+    it->second += next->second;
+    mFree.erase(next);
+  }
+
+  if (it != mFree.begin()) {
+    auto previous = std::prev(it);
+    if (previous->first + previous->second == it->first) {
+      previous->second += it->second;
+      mFree.erase(it);
+    }
+  }
+}
+
+size_t RangeAllocator::Capacity() const {
+  return mCapacity;
+}
+
+size_t RangeAllocator::Used() const {
+  return mUsed;
+}
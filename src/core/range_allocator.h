@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <optional>
+
+struct RangeAllocation {
+  size_t offset;
+  size_t size;
+};
+
+// First fit allocator over a fixed size range, in whatever unit the caller uses. Like RingAllocator it doesn't know
+// what backs the range; unlike it, allocations can be freed in any order and neighbouring free ranges are merged.
+class RangeAllocator {
+public:
+  RangeAllocator(size_t capacity);
+
+  // Returns nothing if no free range is big enough
+  std::optional<RangeAllocation> Allocate(size_t size);
+  void Free(const RangeAllocation &allocation);
+
+  size_t Capacity() const;
+  size_t Used() const;
+
+private:
+  size_t mCapacity;
+  size_t mUsed;
+  // Offset to size of every free range
+  std::map<size_t, size_t> mFree;
+};
@@ -0,0 +1,66 @@
+#include "ring_allocator.h"
+
+RingAllocator::RingAllocator(size_t capacity) : mCapacity(capacity), mHead(0), mFenced(0), mReleased(0) {
+}
+
+std::optional<RingAllocation> RingAllocator::Allocate(size_t size, size_t alignment) {
+  if (size == 0 || size > mCapacity) {
+    return std::nullopt;
+  }
+
+  // When nothing is in flight start over at the beginning of the ring, so big allocations don't have to skip the tail
+  if (mHead == mReleased && mHead % mCapacity != 0) {
+    mHead = (mHead / mCapacity + 1) * mCapacity;
+    mFenced = mHead;
+    mReleased = mHead;
+  }
+
+  size_t position = mHead % mCapacity;
+  size_t offset = (position + alignment - 1) / alignment * alignment;
+
+  // Allocations never straddle the end of the ring, the rest of the ring is skipped instead
+  if (offset + size > mCapacity) {
+    offset = 0;
+  }
+
+  size_t padding = offset >= position ? offset - position : mCapacity - position;
+  if (mHead + padding + size - mReleased > mCapacity) {
+    return std::nullopt;
+  }
+
+  mHead += padding + size;
+  mRecords.push_back({.end = mHead, .submitted = false});
+  return RingAllocation{.offset = offset, .size = size, .end = mHead};
+}
+
+void RingAllocator::Submit(const RingAllocation &allocation) {
+  for (auto &record : mRecords) {
+    if (record.end == allocation.end) {
+      record.submitted = true;
+      return;
+    }
+  }
+}
+
+size_t RingAllocator::Fence() {
+  while (!mRecords.empty() && mRecords.front().submitted) {
+    mFenced = mRecords.front().end;
+    mRecords.pop_front();
+  }
+
+  return mFenced;
+}
+
+void RingAllocator::Release(size_t position) {
+  if (position > mReleased) {
+    mReleased = position;
+  }
+}
+
+size_t RingAllocator::Capacity() const {
+  return mCapacity;
+}
+
+size_t RingAllocator::Used() const {
+  return mHead - mReleased;
+}
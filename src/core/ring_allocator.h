@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+
+struct RingAllocation {
+  size_t offset;
+  size_t size;
+  // Position of the end of this allocation in the ever growing stream of allocated bytes
+  size_t end;
+};
+
+// Hands out space from a fixed size ring without knowing anything about what backs it. Allocations can be submitted
+// out of order, but space is only given back in order: Fence() returns how far everything has been submitted, and once
+// whoever consumes the data is done with it the caller passes that position to Release().
+class RingAllocator {
+public:
+  RingAllocator(size_t capacity);
+
+  // Returns nothing if the ring is full, or if the allocation would never fit
+  std::optional<RingAllocation> Allocate(size_t size, size_t alignment);
+  void Submit(const RingAllocation &allocation);
+
+  size_t Fence();
+  void Release(size_t position);
+
+  size_t Capacity() const;
+  size_t Used() const;
+
+private:
+  struct Record {
+    size_t end;
+    bool submitted;
+  };
+
+  size_t mCapacity;
+  size_t mHead;
+  size_t mFenced;
+  size_t mReleased;
+  std::deque<Record> mRecords;
+};
@@ -0,0 +1,199 @@
+#include "ring_benchmark.h"
+#include "SDL3/SDL_log.h"
+#include "benchmark.h"
+#include "ring_allocator.h"
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace {
+
+// The streaming buffer's alignment
+const size_t ALIGNMENT = 16;
+const size_t STRESS_CAPACITY = 64 * 1024;
+const int STRESS_FRAMES = 20000;
+// The GPU is done with a frame's copies this many frames later
+const int FENCE_LAG = 2;
+const int MAX_ALLOCATIONS_PER_FRAME = 12;
+
+struct Check {
+  const char *name;
+  bool passed;
+};
+
+bool Offset(const std::optional<RingAllocation> &allocation, size_t offset) {
+  return allocation && allocation->offset == offset;
+}
+
+std::vector<Check> Checks() {
+  std::vector<Check> checks;
+
+  {
+    RingAllocator ring(100);
+    auto a = ring.Allocate(60, 1);
+    auto b = ring.Allocate(30, 1);
+    ring.Submit(*a);
+    ring.Release(ring.Fence());
+    // 10 bytes are left at the end, too few, so the allocation starts over at the beginning
+    auto c = ring.Allocate(20, 1);
+    checks.push_back({"wraps instead of straddling the end", Offset(a, 0) && Offset(b, 60) && Offset(c, 0)});
+    checks.push_back({"skipped tail counts as used", ring.Used() == 60});
+  }
+
+  {
+    RingAllocator ring(100);
+    auto a = ring.Allocate(70, 1);
+    bool full = !ring.Allocate(40, 1);
+    ring.Submit(*a);
+    size_t fence = ring.Fence();
+    // Submitted but not released, the GPU may still be reading it
+    bool stillFull = !ring.Allocate(40, 1);
+    ring.Release(fence);
+    auto b = ring.Allocate(40, 1);
+    checks.push_back({"full ring fails until released", full && stillFull && fence == 70 && Offset(b, 0)});
+  }
+
+  {
+    RingAllocator ring(100);
+    auto a = ring.Allocate(10, 1);
+    auto b = ring.Allocate(10, 1);
+    auto c = ring.Allocate(10, 1);
+    ring.Submit(*c);
+    ring.Submit(*b);
+    size_t early = ring.Fence();
+    ring.Submit(*a);
+    checks.push_back({"fence waits for out of order submits", early == 0 && ring.Fence() == c->end});
+  }
+
+  {
+    RingAllocator ring(256);
+    auto a = ring.Allocate(10, ALIGNMENT);
+    auto b = ring.Allocate(10, ALIGNMENT);
+    checks.push_back({"aligned offsets", Offset(a, 0) && Offset(b, ALIGNMENT) && ring.Used() == ALIGNMENT + 10});
+  }
+
+  {
+    RingAllocator ring(100);
+    checks.push_back({"empty or too big never fits", !ring.Allocate(0, 1) && !ring.Allocate(101, 1)});
+    auto whole = ring.Allocate(100, 1);
+    checks.push_back({"whole ring fits", Offset(whole, 0)});
+  }
+
+  {
+    RingAllocator ring(100);
+    auto a = ring.Allocate(90, 1);
+    ring.Submit(*a);
+    ring.Release(ring.Fence());
+    // Nothing is in flight, so the ring starts over instead of leaving the allocation only the last 10 bytes
+    auto b = ring.Allocate(80, 1);
+    checks.push_back({"restarts at the beginning when idle", Offset(b, 0) && ring.Used() == 80});
+  }
+
+  return checks;
+}
+
+struct Stress {
+  long allocations = 0;
+  long failed = 0;
+  long wraps = 0;
+  size_t bytes = 0;
+  long overlaps = 0;
+  long misplaced = 0;
+  float ms = 0.0f;
+};
+
+bool Overlap(const RingAllocation &a, const RingAllocation &b) {
+  return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+}
+
+// Allocates like the chunk workers and frees like the main thread: allocations are submitted in random order within
+// the frame, and each frame's fence is released FENCE_LAG frames later
+Stress RunStress(int seed) {
+  Stress stress;
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<size_t> size(1, STRESS_CAPACITY / 4);
+  std::uniform_int_distribution<int> count(0, MAX_ALLOCATIONS_PER_FRAME);
+
+  RingAllocator ring(STRESS_CAPACITY);
+  std::vector<RingAllocation> inFlight;
+  std::deque<size_t> fences;
+  size_t lastOffset = 0;
+
+  auto start = SDL_GetPerformanceCounter();
+  for (int frame = 0; frame < STRESS_FRAMES; ++frame) {
+    std::vector<RingAllocation> frameAllocations;
+    for (int i = count(random); i > 0; --i) {
+      auto allocation = ring.Allocate(size(random), ALIGNMENT);
+      if (!allocation) {
+        stress.failed++;
+        continue;
+      }
+
+      stress.allocations++;
+      stress.bytes += allocation->size;
+      stress.wraps += allocation->offset < lastOffset;
+      lastOffset = allocation->offset;
+      if (allocation->offset % ALIGNMENT != 0 || allocation->offset + allocation->size > STRESS_CAPACITY) {
+        stress.misplaced++;
+      }
+      for (const auto &other : inFlight) {
+        stress.overlaps += Overlap(*allocation, other);
+      }
+      inFlight.push_back(*allocation);
+      frameAllocations.push_back(*allocation);
+    }
+
+    std::shuffle(frameAllocations.begin(), frameAllocations.end(), random);
+    for (const auto &allocation : frameAllocations) {
+      ring.Submit(allocation);
+    }
+    fences.push_back(ring.Fence());
+
+    if (fences.size() > FENCE_LAG) {
+      size_t released = fences.front();
+      fences.pop_front();
+      ring.Release(released);
+      std::erase_if(inFlight, [&](const RingAllocation &allocation) { return allocation.end <= released; });
+    }
+  }
+  stress.ms = ElapsedMs(start);
+
+  // Everything was submitted, so releasing the last fence empties the ring
+  ring.Release(ring.Fence());
+  stress.misplaced += ring.Used() != 0;
+  return stress;
+}
+
+} // namespace
+
+bool RunRingBenchmark(int seed, const std::string &path) {
+  auto checks = Checks();
+  int failures = 0;
+  for (const auto &check : checks) {
+    if (!check.passed) {
+      SDL_Log("Ring allocator test '%s' failed", check.name);
+      failures++;
+    }
+  }
+  SDL_Log("Ring allocator tests: %d failures", failures);
+
+  Stress stress = RunStress(seed);
+  SDL_Log("Ring allocator stress: %ld allocations, %ld failed, %ld wraps, %ld overlaps, %ld misplaced, %.3f ms",
+          stress.allocations, stress.failed, stress.wraps, stress.overlaps, stress.misplaced, stress.ms);
+
+  BenchmarkCsv out(path);
+  if (!out.Ok()) {
+    return false;
+  }
+
+  out.Table("check,passed");
+  for (const auto &check : checks) {
+    out.Row(check.name, check.passed);
+  }
+  out.Table("frames,allocations,failed_allocations,wraps,megabytes,overlaps,misplaced,ms");
+  out.Row(STRESS_FRAMES, stress.allocations, stress.failed, stress.wraps, stress.bytes / (1024.0f * 1024.0f),
+          stress.overlaps, stress.misplaced, stress.ms);
+
+  return failures == 0 && stress.overlaps == 0 && stress.misplaced == 0 && stress.wraps > 0;
+}
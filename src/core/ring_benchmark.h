@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+// Checks the ring allocator behind the streaming buffer on scripted cases (wrapping at the end of the ring, running
+// full, out of order submits, alignment), then streams random allocations through a small ring for many frames with
+// the fences released a few frames late, checking that no two allocations in flight overlap. Needs no GL context.
+bool RunRingBenchmark(int seed, const std::string &path);
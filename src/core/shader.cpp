@@ -1,105 +1,270 @@
 #include "shader.h"
 #include "SDL3/SDL_log.h"
+#include "gpu_profiler.h"
 
 #include <SDL3/SDL.h>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <memory>
 #include <optional>
-#include <sstream>
 
-enum ShaderType {
-  VERTEX,
-  FRAGMENT
-};
+static const char *CACHE_DIRECTORY = "cache/shaders";
 
 static std::optional<std::string> loadFile(const std::string &path) {
-  std::ifstream in(path);
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
   if (!in) {
     SDL_Log("Failed to load file: %s", path.c_str());
     return std::nullopt;
   }
 
-  std::string contents(static_cast<std::stringstream const &>(std::stringstream() << in.rdbuf()).str());
+  std::string contents(static_cast<size_t>(in.tellg()), '\0');
+  in.seekg(0);
+  in.read(contents.data(), contents.size());
   return contents;
 }
 
-static std::optional<GLuint> compileShader(const std::string &path, ShaderType type) {
-  const auto source = loadFile(path);
-  if (!source) {
-    return std::nullopt;
-  }
-
-  GLint shader = -1;
-  switch (type) {
-    case VERTEX:
-      shader = glCreateShader(GL_VERTEX_SHADER);
-      break;
-    case FRAGMENT:
-      shader = glCreateShader(GL_FRAGMENT_SHADER);
-      break;
+static uint64_t hashString(uint64_t hash, const std::string &value) {
+  for (unsigned char c : value) {
+    hash = (hash ^ c) * 1099511628211ull;
   }
 
-  if (shader < 0) {
-    return std::nullopt;
-  }
+  // Separate consecutive strings so "ab" + "c" and "a" + "bc" don't collide
+  return (hash ^ 0xff) * 1099511628211ull;
+}
 
-  const char *cSource = source->c_str();
+static GLuint startCompile(const std::string &source, GLenum type) {
+  GLuint shader = glCreateShader(type);
+  const char *cSource = source.c_str();
   glShaderSource(shader, 1, &cSource, nullptr);
   glCompileShader(shader);
+  return shader;
+}
 
+static bool checkCompile(GLuint shader, const std::string &path) {
   GLint success;
   glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
   if (!success) {
     int length;
     glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
-    std::string str;
-    str.reserve(length);
+    std::string str(length, '\0');
     glGetShaderInfoLog(shader, length, nullptr, str.data());
     SDL_Log("Failed to compile shader (%s) : %s", path.c_str(), str.c_str());
-    return std::nullopt;
+    return false;
   }
 
-  return shader;
+  return true;
 }
 
 std::unique_ptr<Shader> Shader::Load(const std::string &vertexPath, const std::string &fragmentPath) {
-  auto vertex = compileShader(vertexPath, ShaderType::VERTEX);
-  auto fragment = compileShader(fragmentPath, ShaderType::FRAGMENT);
+  ShaderCompiler compiler(true);
+  compiler.Add(vertexPath, fragmentPath);
+  return std::move(compiler.Build().front());
+}
 
-  if (!vertex || !fragment) {
-    if (vertex) {
-      glDeleteShader(*vertex);
-    }
+ShaderCompiler::ShaderCompiler(bool useCache) : mUseCache(useCache), mCached(0) {
+  if (mUseCache) {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    mUseCache = formats > 0;
+  }
+}
 
-    if (fragment) {
-      glDeleteShader(*fragment);
-    }
+size_t ShaderCompiler::Add(const std::string &vertexPath, const std::string &fragmentPath) {
+  mPrograms.push_back({
+      .stages = {{GL_VERTEX_SHADER, vertexPath, {}, 0}, {GL_FRAGMENT_SHADER, fragmentPath, {}, 0}},
+      .hash = 0,
+      .program = 0,
+      .cached = false,
+      .failed = false,
+  });
+  return mPrograms.size() - 1;
+}
 
-    return nullptr;
+size_t ShaderCompiler::AddCompute(const std::string &computePath) {
+  mPrograms.push_back({
+      .stages = {{GL_COMPUTE_SHADER, computePath, {}, 0}},
+      .hash = 0,
+      .program = 0,
+      .cached = false,
+      .failed = false,
+  });
+  return mPrograms.size() - 1;
+}
+
+std::string ShaderCompiler::CachePath(const Program &program) const {
+  char name[32];
+  SDL_snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(program.hash));
+  return std::string(CACHE_DIRECTORY) + "/" + name;
+}
+
+bool ShaderCompiler::LoadCached(Program &program) const {
+  auto data = loadFile(CachePath(program));
+  if (!data || data->size() <= sizeof(GLenum)) {
+    return false;
   }
 
-  GLuint program = glCreateProgram();
-  glAttachShader(program, *vertex);
-  glAttachShader(program, *fragment);
-  glLinkProgram(program);
+  GLenum format;
+  std::memcpy(&format, data->data(), sizeof(format));
 
-  glDeleteShader(*vertex);
-  glDeleteShader(*fragment);
+  program.program = glCreateProgram();
+  glProgramBinary(program.program, format, data->data() + sizeof(format), data->size() - sizeof(format));
 
+  // A driver update can reject old binaries even with a matching hash, just compile in that case
   GLint success;
-  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  glGetProgramiv(program.program, GL_LINK_STATUS, &success);
   if (!success) {
-    int length;
-    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
-    std::string str;
-    str.reserve(length);
-    glGetProgramInfoLog(program, length, nullptr, str.data());
-    SDL_Log("Failed to link shader program (%s, %s) : %s", vertexPath.c_str(), fragmentPath.c_str(), str.c_str());
-    return nullptr;
+    glDeleteProgram(program.program);
+    program.program = 0;
+    return false;
   }
 
-  auto shader = std::make_unique<Shader>(program);
-  return shader;
+  return true;
+}
+
+void ShaderCompiler::SaveCached(const Program &program) const {
+  GLint length = 0;
+  glGetProgramiv(program.program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+
+  std::string data(sizeof(GLenum) + length, '\0');
+  GLenum format;
+  GLsizei written = 0;
+  glGetProgramBinary(program.program, length, &written, &format, data.data() + sizeof(GLenum));
+  if (written <= 0) {
+    return;
+  }
+  data.resize(sizeof(GLenum) + written);
+  std::memcpy(data.data(), &format, sizeof(format));
+
+  // Written next to the cache file and renamed over it once complete, so a partial binary is never loaded
+  std::string path = CachePath(program);
+  std::string temporary = path + ".tmp";
+  std::error_code error;
+  std::filesystem::create_directories(CACHE_DIRECTORY, error);
+  std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+  out.write(data.data(), data.size());
+  out.close();
+  // Covers the write as well as the close, which flushes what is left
+  bool ok = !out.fail();
+
+  if (ok) {
+    std::filesystem::rename(temporary, path, error);
+  }
+  if (!ok || error) {
+    SDL_Log("Failed to write shader cache %s: %s", path.c_str(), error ? error.message().c_str() : "write");
+    std::filesystem::remove(temporary, error);
+  }
+}
+
+std::vector<std::unique_ptr<Shader>> ShaderCompiler::Build() {
+  Start();
+  return Finish();
+}
+
+void ShaderCompiler::Start() {
+  mProfiler.Start();
+
+  if (GLEW_KHR_parallel_shader_compile) {
+    // Let the driver use as many threads as it wants
+    glMaxShaderCompilerThreadsKHR(0xffffffff);
+  }
+
+  // The driver identity is part of the key, binaries are only valid for the exact driver that produced them
+  uint64_t driverHash = 14695981039346656037ull;
+  for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    driverHash = hashString(driverHash, reinterpret_cast<const char *>(glGetString(name)));
+  }
+
+  for (auto &program : mPrograms) {
+    program.hash = driverHash;
+    for (auto &stage : program.stages) {
+      auto source = loadFile(stage.path);
+      if (!source) {
+        program.failed = true;
+        break;
+      }
+
+      stage.source = *source;
+      program.hash = hashString(program.hash, stage.source);
+    }
+
+    if (!program.failed) {
+      program.cached = mUseCache && LoadCached(program);
+      mCached += program.cached;
+    }
+  }
+
+  // Kick off every compile first, then every link, and only then start asking for results
+  for (auto &program : mPrograms) {
+    if (program.failed || program.cached) {
+      continue;
+    }
+
+    for (auto &stage : program.stages) {
+      stage.shader = startCompile(stage.source, stage.type);
+    }
+  }
+
+  for (auto &program : mPrograms) {
+    if (program.failed || program.cached) {
+      continue;
+    }
+
+    program.program = glCreateProgram();
+    if (mUseCache) {
+      glProgramParameteri(program.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    for (const auto &stage : program.stages) {
+      glAttachShader(program.program, stage.shader);
+    }
+    glLinkProgram(program.program);
+  }
+}
+
+std::vector<std::unique_ptr<Shader>> ShaderCompiler::Finish() {
+  std::vector<std::unique_ptr<Shader>> result;
+  for (auto &program : mPrograms) {
+    if (program.failed) {
+      result.push_back(nullptr);
+      continue;
+    }
+
+    if (!program.cached) {
+      bool compiled = true;
+      std::string paths;
+      for (const auto &stage : program.stages) {
+        compiled = checkCompile(stage.shader, stage.path) && compiled;
+        glDeleteShader(stage.shader);
+        paths += (paths.empty() ? "" : ", ") + stage.path;
+      }
+
+      GLint success;
+      glGetProgramiv(program.program, GL_LINK_STATUS, &success);
+      if (!compiled || !success) {
+        int length;
+        glGetProgramiv(program.program, GL_INFO_LOG_LENGTH, &length);
+        std::string str(length, '\0');
+        glGetProgramInfoLog(program.program, length, nullptr, str.data());
+        SDL_Log("Failed to link shader program (%s) : %s", paths.c_str(), str.c_str());
+        glDeleteProgram(program.program);
+        result.push_back(nullptr);
+        continue;
+      }
+
+      if (mUseCache) {
+        SaveCached(program);
+      }
+    }
+
+    result.push_back(std::make_unique<Shader>(program.program));
+  }
+
+  SDL_Log("Shaders: %zu programs, %d from cache", mPrograms.size(), mCached);
+  mProfiler.LogEnd("Shaders loaded");
+  return result;
 }
 
 Shader::Shader(GLuint id) : mId(id) {
@@ -111,6 +276,7 @@ Shader::~Shader() {
 
 void Shader::Bind() const {
   glUseProgram(mId);
+  GpuProfiler::CountStateChange();
 }
 
 void Shader::Unbind() const {
@@ -127,6 +293,26 @@ void Shader::UniformMat4(const std::string &name, const glm::mat4 &value) const
   glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
 }
 
+void Shader::UniformInt(const std::string &name, int value) const {
+  auto location = glGetUniformLocation(mId, name.c_str());
+  if (location < 0) {
+    SDL_Log("Could not find uniform location %s", name.c_str());
+    return;
+  }
+
+  glUniform1i(location, value);
+}
+
+void Shader::UniformVec2(const std::string &name, const glm::vec2 &value) const {
+  auto location = glGetUniformLocation(mId, name.c_str());
+  if (location < 0) {
+    SDL_Log("Could not find uniform location %s", name.c_str());
+    return;
+  }
+
+  glUniform2fv(location, 1, &value[0]);
+}
+
 void Shader::UniformVec3(const std::string &name, const glm::vec3 &value) const {
   auto location = glGetUniformLocation(mId, name.c_str());
   if (location < 0) {
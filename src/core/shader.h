@@ -1,9 +1,13 @@
 #pragma once
 
 #include "glm/ext/matrix_float4x4.hpp"
+#include "glm/ext/vector_float2.hpp"
+#include "profiler.h"
 #include <GL/glew.h>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 class Shader {
 public:
@@ -15,9 +19,54 @@ public:
   void Bind() const;
   void Unbind() const;
 
+  void UniformInt(const std::string &name, int value) const;
+  void UniformVec2(const std::string &name, const glm::vec2 &value) const;
   void UniformVec3(const std::string &name, const glm::vec3 &value) const;
   void UniformMat4(const std::string &name, const glm::mat4 &value) const;
 
 private:
   GLuint mId;
 };
+
+// Builds several shader programs at once. All compiles and links are issued before any status is queried, so with
+// GL_KHR_parallel_shader_compile the driver works on them concurrently. Linked programs are stored in an on-disk
+// binary cache keyed by a hash of the sources and the driver, and later runs load the binary instead of compiling.
+class ShaderCompiler {
+public:
+  ShaderCompiler(bool useCache);
+
+  // Returns the index of the program in the result of Build()
+  size_t Add(const std::string &vertexPath, const std::string &fragmentPath);
+  size_t AddCompute(const std::string &computePath);
+
+  // Failed programs are returned as nullptr
+  std::vector<std::unique_ptr<Shader>> Build();
+
+  // Build() split in two, so other work can be done on the main thread while the driver compiles
+  void Start();
+  std::vector<std::unique_ptr<Shader>> Finish();
+
+private:
+  struct Stage {
+    GLenum type;
+    std::string path;
+    std::string source;
+    GLuint shader;
+  };
+
+  struct Program {
+    std::vector<Stage> stages;
+    uint64_t hash;
+    GLuint program;
+    bool cached, failed;
+  };
+
+  bool mUseCache;
+  std::vector<Program> mPrograms;
+  int mCached;
+  Profiler mProfiler;
+
+  std::string CachePath(const Program &program) const;
+  bool LoadCached(Program &program) const;
+  void SaveCached(const Program &program) const;
+};
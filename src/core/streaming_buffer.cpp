@@ -0,0 +1,135 @@
+#include "streaming_buffer.h"
+#include "SDL3/SDL_log.h"
+#include "memory_tracker.h"
+#include <algorithm>
+
+static const GLbitfield MAP_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+// Vertex data only needs to be aligned to its largest component
+static const size_t ALIGNMENT = 16;
+
+// Frames summed up in one upload report
+static const int REPORT_FRAMES = 300;
+
+StreamingBuffer::StreamingBuffer(size_t capacity)
+    : mRing(capacity), mShutdown(false), mFrameUploadedBytes(0),
+      mStats{.uploadedBytes = 0, .peakFrameBytes = 0, .stalls = 0}, mReportFrames(0), mReportBytes(0),
+      mReportPeakBytes(0) {
+  glCreateBuffers(1, &mBuffer);
+  glNamedBufferStorage(mBuffer, capacity, nullptr, MAP_FLAGS);
+  MemoryTracker::RegisterBuffer(mBuffer, GpuTag::Streaming, capacity);
+  mMapped = static_cast<char *>(glMapNamedBufferRange(mBuffer, 0, capacity, MAP_FLAGS));
+
+  mMutex = SDL_CreateMutex();
+  mSpaceAvailable = SDL_CreateCondition();
+}
+
+StreamingBuffer::~StreamingBuffer() {
+  for (auto &fence : mFences) {
+    glDeleteSync(fence.sync);
+  }
+
+  glUnmapNamedBuffer(mBuffer);
+  MemoryTracker::ReleaseBuffer(mBuffer);
+  glDeleteBuffers(1, &mBuffer);
+
+  SDL_DestroyCondition(mSpaceAvailable);
+  SDL_DestroyMutex(mMutex);
+}
+
+std::optional<RingAllocation> StreamingBuffer::Allocate(size_t size) {
+  if (size > mRing.Capacity()) {
+    return std::nullopt;
+  }
+
+  SDL_LockMutex(mMutex);
+  auto allocation = mRing.Allocate(size, ALIGNMENT);
+  if (!allocation && !mShutdown) {
+    mStats.stalls++;
+  }
+
+  while (!allocation && !mShutdown) {
+    SDL_WaitCondition(mSpaceAvailable, mMutex);
+    allocation = mRing.Allocate(size, ALIGNMENT);
+  }
+  SDL_UnlockMutex(mMutex);
+
+  return allocation;
+}
+
+void *StreamingBuffer::Pointer(const RingAllocation &allocation) const {
+  return mMapped + allocation.offset;
+}
+
+void StreamingBuffer::Copy(const RingAllocation &allocation, GLuint destination, GLintptr destinationOffset) {
+  glCopyNamedBufferSubData(mBuffer, destination, allocation.offset, destinationOffset, allocation.size);
+  mFrameUploadedBytes += allocation.size;
+
+  SDL_LockMutex(mMutex);
+  mRing.Submit(allocation);
+  SDL_UnlockMutex(mMutex);
+}
+
+void StreamingBuffer::Discard(const RingAllocation &allocation) {
+  SDL_LockMutex(mMutex);
+  mRing.Submit(allocation);
+  SDL_UnlockMutex(mMutex);
+}
+
+void StreamingBuffer::EndFrame() {
+  SDL_LockMutex(mMutex);
+  size_t position = mRing.Fence();
+  if (mFences.empty() ? position > 0 : position > mFences.back().position) {
+    mFences.push_back({.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), .position = position});
+  }
+
+  // Never wait on the GPU here, whatever isn't done yet is checked again next frame
+  bool released = false;
+  while (!mFences.empty()) {
+    GLenum result = glClientWaitSync(mFences.front().sync, 0, 0);
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+      break;
+    }
+
+    mRing.Release(mFences.front().position);
+    glDeleteSync(mFences.front().sync);
+    mFences.pop_front();
+    released = true;
+  }
+
+  if (released) {
+    SDL_BroadcastCondition(mSpaceAvailable);
+  }
+
+  mStats.uploadedBytes += mFrameUploadedBytes;
+  mStats.peakFrameBytes = std::max(mStats.peakFrameBytes, mFrameUploadedBytes);
+  mReportBytes += mFrameUploadedBytes;
+  mReportPeakBytes = std::max(mReportPeakBytes, mFrameUploadedBytes);
+  mFrameUploadedBytes = 0;
+
+  if (++mReportFrames == REPORT_FRAMES) {
+    if (mReportBytes > 0) {
+      SDL_Log("Mesh upload: %.2f MB in the last %d frames, at most %.2f MB in one, %zu MB in flight, %d stalls so far",
+              mReportBytes / (1024.0f * 1024.0f), REPORT_FRAMES, mReportPeakBytes / (1024.0f * 1024.0f),
+              mRing.Used() / (1024 * 1024), mStats.stalls);
+    }
+    mReportFrames = 0;
+    mReportBytes = 0;
+    mReportPeakBytes = 0;
+  }
+  SDL_UnlockMutex(mMutex);
+}
+
+void StreamingBuffer::Shutdown() {
+  SDL_LockMutex(mMutex);
+  mShutdown = true;
+  SDL_BroadcastCondition(mSpaceAvailable);
+  SDL_UnlockMutex(mMutex);
+}
+
+StreamingBuffer::Stats StreamingBuffer::GetStats() const {
+  SDL_LockMutex(mMutex);
+  Stats stats = mStats;
+  SDL_UnlockMutex(mMutex);
+  return stats;
+}
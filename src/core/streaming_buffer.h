@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ring_allocator.h"
+#include <GL/glew.h>
+#include <SDL3/SDL.h>
+#include <deque>
+#include <optional>
+
+// Persistently mapped staging buffer used to upload data to other GL buffers. Any thread can allocate space and write
+// into it, the main thread then issues GPU side copies out of it. Space is recycled once the fence placed after the
+// copies has been signaled.
+class StreamingBuffer {
+public:
+  struct Stats {
+    // Since the buffer was created
+    size_t uploadedBytes;
+    // Most bytes copied out of the buffer in one frame
+    size_t peakFrameBytes;
+    int stalls;
+  };
+
+  StreamingBuffer(size_t capacity);
+  ~StreamingBuffer();
+
+  // Blocks until there is enough space, returns nothing if the size can never fit or the buffer is shutting down
+  std::optional<RingAllocation> Allocate(size_t size);
+  void *Pointer(const RingAllocation &allocation) const;
+
+  // Main thread only
+  void Copy(const RingAllocation &allocation, GLuint destination, GLintptr destinationOffset);
+  void Discard(const RingAllocation &allocation);
+  void EndFrame();
+
+  // Wakes up every thread waiting for space, all further allocations fail
+  void Shutdown();
+
+  Stats GetStats() const;
+
+private:
+  struct PendingFence {
+    GLsync sync;
+    size_t position;
+  };
+
+  GLuint mBuffer;
+  char *mMapped;
+  RingAllocator mRing;
+  std::deque<PendingFence> mFences;
+  bool mShutdown;
+
+  SDL_Mutex *mMutex;
+  SDL_Condition *mSpaceAvailable;
+
+  size_t mFrameUploadedBytes;
+  Stats mStats;
+  // Uploads are logged as a summary every few frames
+  int mReportFrames;
+  size_t mReportBytes, mReportPeakBytes;
+};
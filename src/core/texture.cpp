@@ -1,32 +1,40 @@
 #include "texture.h"
-#include <SDL3_image/SDL_image.h>
+#include "baked_image.h"
+#include "memory_tracker.h"
+#include <SDL3/SDL.h>
 #include <memory>
 
 std::unordered_map<std::string, std::shared_ptr<Texture>> Texture::sTextures{};
 
 std::shared_ptr<Texture> Texture::Load(const std::string &path) {
-  GLuint texture;
-  SDL_Surface *image = IMG_Load("assets/textures/dirt.png");
+  if (sTextures.contains(path)) {
+    return sTextures[path];
+  }
+
+  auto image = BakedImage::Load(path, "texture", true, [](SDL_Surface *surface) {
+    return std::vector<SDL_Surface *>{surface};
+  });
   if (!image) {
     SDL_Log("Failed to load texture: %s", path.c_str());
     return nullptr;
   }
 
-  glm::ivec2 dimensions{image->w, image->h};
-
-  if (sTextures.contains(path)) {
-    return sTextures[path];
-  }
+  glm::ivec2 dimensions{image->Width(), image->Height()};
 
+  GLuint texture;
   glCreateTextures(GL_TEXTURE_2D, 1, &texture);
   glBindTexture(GL_TEXTURE_2D, texture);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->w, image->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image->pixels);
-  glGenerateMipmap(GL_TEXTURE_2D);
-  SDL_DestroySurface(image);
+  glTextureStorage2D(texture, image->Levels(), GL_RGBA8, image->Width(), image->Height());
+  MemoryTracker::RegisterTexture(texture, GpuTag::Textures,
+                                 MemoryTracker::TextureBytes(image->Width(), image->Height(), image->Levels(), 4));
+  for (int level = 0; level < image->Levels(); ++level) {
+    auto data = image->Level(0, level);
+    glTextureSubImage2D(texture, level, 0, 0, data.width, data.height, GL_RGBA, GL_UNSIGNED_BYTE, data.pixels);
+  }
 
   auto result = std::make_shared<Texture>(texture, dimensions);
   sTextures[path] = result;
@@ -41,6 +49,7 @@ Texture::Texture(GLuint id, const glm::ivec2 &dimensions) : mId(id), mDimensions
 }
 
 Texture::~Texture() {
+  MemoryTracker::ReleaseTexture(mId);
   glDeleteTextures(1, &mId);
 }
 
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free hand-off of the latest value from one writer thread to one reader thread. The writer fills its back slot
+// and publishes it, the reader picks up the most recent published slot; neither side ever waits for the other, and
+// values the reader was too slow to see are simply overwritten.
+template <typename T> class TripleBuffer {
+public:
+  // Writer only
+  T &Back() {
+    return mSlots[mBack];
+  }
+
+  void Publish() {
+    mBack = mShared.exchange(mBack | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // Reader only, returns true if a newer value was published since the last call
+  bool Acquire() {
+    if (!(mShared.load(std::memory_order_relaxed) & FRESH)) {
+      return false;
+    }
+
+    mFront = mShared.exchange(mFront, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  const T &Front() const {
+    return mSlots[mFront];
+  }
+
+private:
+  static const int INDEX = 3;
+  static const int FRESH = 4;
+
+  T mSlots[3];
+  int mBack = 0;
+  std::atomic<int> mShared = 1;
+  int mFront = 2;
+};
@@ -9,13 +9,28 @@
 #include "glm/ext/matrix_float4x4.hpp"
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
+#include <algorithm>
+#include <cstdlib>
 #include <memory>
+#include <optional>
+#include <string>
 
+#include "core/baked_image.h"
 #include "core/camera.h"
+#include "core/camera_path.h"
+#include "core/frame_benchmark.h"
+#include "core/gpu_profiler.h"
+#include "core/input_recording.h"
 #include "core/keyboard.h"
+#include "core/memory_tracker.h"
+#include "core/profiler.h"
 #include "core/shader.h"
 #include "core/texture.h"
+#include "world/flight_benchmark.h"
+#include "world/shadow_maps.h"
+#include "world/simulation.h"
 #include "world/sky.h"
+#include "world/slow_render_check.h"
 #include "world/world.h"
 
 #ifdef _WIN32
@@ -27,21 +42,125 @@ __declspec(dllexport) int AmdPowerXpressRequestHighPerformance = 1; // AMD
 }
 #endif
 
+// The camera and the world are advanced in fixed steps, so the same input always produces the same poses and the same
+// chunk requests no matter how fast frames are rendered
+static const uint32_t TICK_RATE = 60;
+
 struct GameState {
   SDL_Window *window;
   SDL_GLContext glContext;
   KeyboardState keyboard;
 
+  Profiler startup;
+  bool firstFrame;
+  bool fullyLoaded;
+
   std::unique_ptr<Shader> shader;
+  // The simulation moves camera, frames are drawn from renderCamera which trails it by up to one tick
   std::unique_ptr<Camera> camera;
+  std::unique_ptr<Camera> renderCamera;
   glm::vec3 sunPosition;
 
   glm::mat4 projection, model;
   std::unique_ptr<World> world;
+  // Declared after the world, it has to stop before the world goes away and its snapshots hold on to chunks
+  std::unique_ptr<Simulation> simulation;
+  // --slow-render delays every frame by this much, the simulation should keep its tick rate regardless. The check
+  // ends the run, and fails it if the simulation didn't keep up.
+  int slowRenderMs;
+  std::unique_ptr<SlowRenderCheck> slowRender;
 
   std::unique_ptr<Sky> sky;
+  // Null if the shadow shader failed to build, the world is then drawn without shadows
+  std::unique_ptr<ShadowMaps> shadows;
+
+  // Only set in --headless-bench mode
+  std::optional<CameraPath> benchPath;
+  std::unique_ptr<FrameBenchmark> benchmark;
+  std::string benchOutput;
+  // Only set in --headless-flight mode, writes to benchOutput too
+  std::unique_ptr<FlightBenchmark> flight;
+
+  // --record writes the live input to recordPath on exit, --replay plays a recording back one tick per frame
+  std::unique_ptr<InputRecording> recording;
+  std::string recordPath;
+  std::optional<InputRecording> replay;
+
+  // --memory-out writes the memory tracker's snapshot there on exit
+  std::string memoryPath;
+};
+
+struct Options {
+  std::string benchPath;
+  std::string benchOutput = "bench.csv";
+  int benchFrames = 600;
+  std::string recordPath;
+  std::string replayPath;
+  bool shaderCache = true;
+  bool bakedAssets = true;
+  bool gpuMeshing = false;
+  bool verifyCulling = false;
+  int slowRenderMs = 0;
+  std::string memoryOutput;
+  float flightSpeed = 0.0f;
+  bool prefetch = true;
+  bool shadowCache = true;
+};
+
+static Options ParseOptions(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--headless-bench" && i + 1 < argc) {
+      options.benchPath = argv[++i];
+    } else if (arg == "--headless-flight" && i + 1 < argc) {
+      options.flightSpeed = std::max(0.0f, static_cast<float>(std::atof(argv[++i])));
+    } else if (arg == "--no-prefetch") {
+      options.prefetch = false;
+    } else if (arg == "--no-shadow-cache") {
+      options.shadowCache = false;
+    } else if (arg == "--frames" && i + 1 < argc) {
+      options.benchFrames = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--bench-out" && i + 1 < argc) {
+      options.benchOutput = argv[++i];
+    } else if (arg == "--record" && i + 1 < argc) {
+      options.recordPath = argv[++i];
+    } else if (arg == "--replay" && i + 1 < argc) {
+      options.replayPath = argv[++i];
+    } else if (arg == "--no-shader-cache") {
+      options.shaderCache = false;
+    } else if (arg == "--no-baked-assets") {
+      options.bakedAssets = false;
+    } else if (arg == "--verify-culling") {
+      options.verifyCulling = true;
+    } else if (arg == "--gpu-meshing") {
+      options.gpuMeshing = true;
+    } else if (arg == "--memory-out" && i + 1 < argc) {
+      options.memoryOutput = argv[++i];
+    } else if (arg == "--slow-render" && i + 1 < argc) {
+      options.slowRenderMs = std::max(0, std::atoi(argv[++i]));
+    } else {
+      SDL_Log("Unknown argument: %s", arg.c_str());
+    }
+  }
+
+  return options;
+}
+
+// Everything the startup needs from disk which can be decoded without the GL context
+struct StartupAssets {
+  TextureAtlasBuilder atlas;
+  std::unique_ptr<BakedImage> skyFaces;
+  bool decoded;
 };
 
+static int DecodeStartupAssets(void *data) {
+  auto *assets = static_cast<StartupAssets *>(data);
+  assets->skyFaces = Sky::LoadFaces();
+  assets->decoded = assets->atlas.Decode() && assets->skyFaces;
+  return 0;
+}
+
 void GLAPIENTRY OpenGLOutputCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
                                      const GLchar *message, const void *userParam) {
   SDL_Log("GL CALLBACK: %s type = 0x%x, severity = 0x%x, message = %s\n",
@@ -49,6 +168,16 @@ void GLAPIENTRY OpenGLOutputCallback(GLenum source, GLenum type, GLuint id, GLen
 }
 
 SDL_AppResult SDL_AppInit(void **appstate, int argc, char **argv) {
+  auto startup = Profiler::Create();
+  auto options = ParseOptions(argc, argv);
+  bool headless = !options.benchPath.empty() || options.flightSpeed > 0.0f;
+  BakedImage::SetEnabled(options.bakedAssets);
+
+  // The offscreen driver renders through EGL pbuffers, which works without a display (e.g. on Mesa llvmpipe)
+  if (headless) {
+    SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+  }
+
   if (!SDL_Init(SDL_INIT_VIDEO)) {
     SDL_Log("Failed to initialize SDL: %s", SDL_GetError());
     return SDL_APP_FAILURE;
@@ -61,48 +190,180 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char **argv) {
   SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
   SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
 
-  SDL_Window *window =
-      SDL_CreateWindow("Voxel Game", 1024, 768, SDL_WINDOW_MAXIMIZED | SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL);
+  SDL_Window *window = nullptr;
+  if (headless) {
+    window = SDL_CreateWindow("Voxel Game", 1280, 720, SDL_WINDOW_HIDDEN | SDL_WINDOW_OPENGL);
+  } else {
+    window =
+        SDL_CreateWindow("Voxel Game", 1024, 768, SDL_WINDOW_MAXIMIZED | SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL);
+  }
 
   if (!window) {
     SDL_Log("Failed to create SDL window: %s", SDL_GetError());
     return SDL_APP_FAILURE;
   }
 
+  // The shaders are written against 4.5 with the draw parameter extensions, so drivers without 4.6 (e.g. Mesa
+  // llvmpipe) run every mode too
   auto glContext = SDL_GL_CreateContext(window);
+  if (!glContext) {
+    SDL_Log("Failed to create an OpenGL 4.6 context, falling back to 4.5: %s", SDL_GetError());
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
+    glContext = SDL_GL_CreateContext(window);
+  }
   if (!glContext) {
     SDL_Log("Failed to create OpenGL context: %s", SDL_GetError());
     return SDL_APP_FAILURE;
   }
 
   SDL_GL_MakeCurrent(window, glContext);
-  SDL_GL_SetSwapInterval(1);
+  SDL_GL_SetSwapInterval(headless ? 0 : 1);
 
-  SDL_SetWindowRelativeMouseMode(window, true);
+  if (!headless) {
+    SDL_SetWindowRelativeMouseMode(window, true);
+  }
 
   glewInit();
 
   glEnable(GL_DEBUG_OUTPUT);
   glDebugMessageCallback(OpenGLOutputCallback, 0);
   glEnable(GL_MULTISAMPLE);
+  startup.LogSnapshot("GL context created");
 
   GameState *state = new GameState();
   *appstate = state;
 
   state->window = window;
   state->glContext = glContext;
-  state->shader = Shader::Load("assets/shaders/basic.vert", "assets/shaders/basic.frag");
-  if (!state->shader) {
+  state->firstFrame = true;
+  state->fullyLoaded = false;
+
+  // Startup overlaps as much as it can: images are decoded on a worker while the driver compiles shaders, and chunk
+  // workers start generating terrain while the main thread uploads the sky and waits for the shaders
+  StartupAssets assets{.atlas = World::CreateAtlasBuilder(), .skyFaces = nullptr, .decoded = false};
+  SDL_Thread *decoder = SDL_CreateThread(DecodeStartupAssets, "DecodeStartupAssets", &assets);
+
+  ShaderCompiler compiler(options.shaderCache);
+  auto meshShader = compiler.AddCompute("assets/shaders/mesh.comp");
+  auto basicShader = compiler.Add("assets/shaders/basic.vert", "assets/shaders/basic.frag");
+  auto skyShader = compiler.Add("assets/shaders/skybox.vert", "assets/shaders/skybox.frag");
+  auto pyramidShader = compiler.AddCompute("assets/shaders/hiz.comp");
+  auto cullShader = compiler.AddCompute("assets/shaders/cull.comp");
+  auto shadowShader = compiler.Add("assets/shaders/shadow.vert", "assets/shaders/shadow.frag");
+  compiler.Start();
+  startup.LogSnapshot("Shader compiles issued");
+
+  SDL_WaitThread(decoder, nullptr);
+  if (!assets.decoded) {
     return SDL_APP_FAILURE;
   }
-
-  state->world = std::make_unique<World>(0, glm::ivec3{64, 64, 64});
+  startup.LogSnapshot("Assets decoded");
 
   state->model = glm::identity<glm::mat4>();
   state->camera = std::make_unique<Camera>(glm::vec3{0.0f, 100.0f, 100.0f});
+  state->renderCamera = std::make_unique<Camera>(state->camera->GetPosition());
   state->sunPosition = {20.0f, 200.0f, -20.0f};
 
-  state->sky = std::make_unique<Sky>();
+  auto atlas = assets.atlas.Upload();
+  if (!atlas) {
+    return SDL_APP_FAILURE;
+  }
+
+  state->world = std::make_unique<World>(0, std::move(atlas));
+  state->world->SetPrefetch(options.prefetch);
+  state->world->SetGpuMeshing(options.gpuMeshing);
+  state->world->Update(state->camera->GetPosition(), state->camera->GetFront());
+  startup.LogSnapshot("World generation started");
+
+  auto shaders = compiler.Finish();
+  if (!shaders[basicShader] || !shaders[skyShader]) {
+    return SDL_APP_FAILURE;
+  }
+
+  state->shader = std::move(shaders[basicShader]);
+  // Counted indirect draws are core in 4.6, a 4.5 context needs the extension
+  if (shaders[pyramidShader] && shaders[cullShader] && (GLEW_VERSION_4_6 || GLEW_ARB_indirect_parameters)) {
+    auto culler = std::make_unique<OcclusionCuller>(std::move(shaders[pyramidShader]), std::move(shaders[cullShader]));
+    culler->SetVerify(options.verifyCulling);
+    state->world->SetCuller(std::move(culler));
+  } else {
+    SDL_Log("Occlusion culling disabled, chunks are drawn from the CPU");
+  }
+  if (options.gpuMeshing && shaders[meshShader]) {
+    state->world->SetGpuMesher(std::move(shaders[meshShader]));
+  } else if (options.gpuMeshing) {
+    SDL_Log("GPU meshing disabled, chunks are meshed on the CPU");
+  }
+  state->sky = std::make_unique<Sky>(std::move(shaders[skyShader]), std::move(assets.skyFaces));
+  if (shaders[shadowShader]) {
+    state->shadows = std::make_unique<ShadowMaps>(std::move(shaders[shadowShader]), state->sunPosition);
+    state->shadows->SetCaching(options.shadowCache);
+  } else {
+    SDL_Log("Shadows disabled");
+  }
+  startup.LogSnapshot("Shaders and sky ready");
+  state->startup = startup;
+
+  state->simulation = std::make_unique<Simulation>(*state->world, *state->camera, TICK_RATE);
+  state->slowRenderMs = options.slowRenderMs;
+  state->memoryPath = options.memoryOutput;
+
+  if (!options.replayPath.empty()) {
+    state->replay = InputRecording::Load(options.replayPath);
+    if (!state->replay) {
+      return SDL_APP_FAILURE;
+    }
+
+    if (state->replay->TickRate() != TICK_RATE) {
+      SDL_Log("Input recording was made at %u ticks per second, expected %u", state->replay->TickRate(), TICK_RATE);
+      return SDL_APP_FAILURE;
+    }
+  } else if (!options.recordPath.empty()) {
+    state->recording = std::make_unique<InputRecording>(TICK_RATE);
+    state->recordPath = options.recordPath;
+    state->simulation->SetRecording(state->recording.get());
+  }
+
+  if (headless) {
+    // Flights go straight ahead from the spawn point, looking a little down at the terrain
+    CameraPose start{state->camera->GetPosition(), state->camera->GetYaw(), -15.0f};
+    if (!options.benchPath.empty()) {
+      state->benchPath = CameraPath::Load(options.benchPath);
+      if (!state->benchPath) {
+        return SDL_APP_FAILURE;
+      }
+      start = state->benchPath->Sample(0.0f);
+    }
+
+    // There are no resize events without a visible window
+    int width, height;
+    SDL_GetWindowSizeInPixels(window, &width, &height);
+    glViewport(0, 0, width, height);
+    state->projection = glm::perspectiveFov(glm::radians(45.0f), static_cast<float>(width),
+                                            static_cast<float>(height), 0.1f, 1000.0f);
+
+    // Start from a fully loaded world so every run measures the same thing
+    state->camera->SetPose(start.position, start.yaw, start.pitch);
+    do {
+      state->world->Update(state->camera->GetPosition(), state->camera->GetFront());
+      state->world->Upload(state->camera->GetPosition(), state->camera->GetFront(), state->world->Chunks());
+      SDL_Delay(1);
+    } while (!state->world->IsLoaded());
+
+    if (state->benchPath) {
+      state->benchmark = std::make_unique<FrameBenchmark>(options.benchFrames);
+    } else {
+      glm::vec3 front = state->camera->GetFront();
+      state->flight = std::make_unique<FlightBenchmark>(start.position, glm::vec3(front.x, 0.0f, front.z),
+                                                        options.flightSpeed, options.benchFrames, TICK_RATE);
+    }
+    state->benchOutput = options.benchOutput;
+  } else if (!state->replay) {
+    state->simulation->Start();
+    if (state->slowRenderMs > 0) {
+      state->slowRender = std::make_unique<SlowRenderCheck>(TICK_RATE);
+    }
+  }
 
   return SDL_APP_CONTINUE;
 }
@@ -153,14 +414,19 @@ SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event) {
           state->keyboard.pressed[static_cast<int>(Key::Jump)] = pressed;
           break;
         }
+        case SDLK_F: {
+          state->keyboard.pressed[static_cast<int>(Key::Sand)] = pressed;
+          break;
+        }
       }
 
       state->keyboard.pressed[static_cast<int>(Key::Crouch)] = pressed && (event->key.mod & SDL_KMOD_LCTRL);
+      state->simulation->SetKeyboard(state->keyboard);
 
       break;
     }
     case SDL_EVENT_MOUSE_MOTION: {
-      state->camera->HandleMouseEvent(glm::vec2(event->motion.xrel, event->motion.yrel));
+      state->simulation->AddMouse(glm::vec2(event->motion.xrel, event->motion.yrel));
       break;
     }
   }
@@ -171,12 +437,62 @@ SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event) {
 SDL_AppResult SDL_AppIterate(void *appstate) {
   GameState *state = static_cast<GameState *>(appstate);
 
-  state->camera->HandleKeyboardEvent(state->keyboard);
-  state->world->Update(state->camera->GetPosition());
+  std::vector<std::shared_ptr<Chunk>> chunks;
+  if (state->flight) {
+    state->renderCamera->SetPose(state->flight->Step(), state->camera->GetYaw(), state->camera->GetPitch());
+    state->world->Update(state->renderCamera->GetPosition(), state->renderCamera->GetFront());
+    chunks = state->world->Chunks();
+  } else if (state->benchmark) {
+    auto pose = state->benchPath->Sample(state->benchmark->Progress());
+    state->renderCamera->SetPose(pose.position, pose.yaw, pose.pitch);
+    state->benchmark->BeginFrame();
+    state->world->Update(state->renderCamera->GetPosition(), state->renderCamera->GetFront());
+    chunks = state->world->Chunks();
+  } else {
+    auto &simulation = *state->simulation;
+    if (state->replay) {
+      // Replays run exactly one tick per frame, however long the frame took
+      auto input = state->replay->Replay(simulation.TickCount());
+      if (!input) {
+        auto position = state->camera->GetPosition();
+        SDL_Log("Replay finished: %u ticks, final position (%.3f, %.3f, %.3f), pose hash %016llx",
+                simulation.TickCount(), position.x, position.y, position.z,
+                static_cast<unsigned long long>(simulation.PoseHash()));
+        return SDL_APP_SUCCESS;
+      }
+
+      simulation.Tick(*input);
+    }
+
+    if (!simulation.Acquire()) {
+      SDL_Delay(1);
+      return SDL_APP_CONTINUE;
+    }
+
+    auto now = SDL_GetPerformanceCounter();
+    auto pose = state->replay ? simulation.Latest().pose : simulation.Interpolate(now);
+    if (state->slowRender) {
+      state->slowRender->Record(simulation, now);
+    }
+    state->renderCamera->SetPose(pose.position, pose.yaw, pose.pitch);
+    chunks = simulation.Latest().chunks;
+  }
+
+  const Camera &camera = *state->renderCamera;
+  state->world->Upload(camera.GetPosition(), camera.GetFront(), chunks);
+
+  GpuProfiler::BeginFrame();
+
+  if (state->shadows) {
+    state->shadows->Update(*state->world, chunks, camera.GetPosition());
+  }
 
   glClearColor(0.05f, 0.05f, 0.1f, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  state->sky->Render(state->projection, state->camera->GetView());
+  {
+    GpuScope scope("sky");
+    state->sky->Render(state->projection, camera.GetView());
+  }
 
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_CULL_FACE);
@@ -185,21 +501,83 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
 
   state->shader->Bind();
   state->shader->UniformMat4("projection", state->projection);
-  state->shader->UniformMat4("view", state->camera->GetView());
+  state->shader->UniformMat4("view", camera.GetView());
   state->shader->UniformVec3("sunPosition", state->sunPosition);
-  state->shader->UniformVec3("eye", state->camera->GetPosition());
-  state->world->Render(*state->shader);
+  state->shader->UniformVec3("eye", camera.GetPosition());
+  // Unit 1 is taken by the occlusion culler
+  if (state->shadows) {
+    state->shadows->Bind(*state->shader, 2);
+  } else {
+    state->shader->UniformInt("shadows", 0);
+  }
+  {
+    GpuScope scope("chunks");
+    state->world->Render(*state->shader, state->projection * camera.GetView(), camera.GetPosition(), chunks);
+  }
   state->shader->Unbind();
 
-  SDL_GL_SwapWindow(state->window);
+  {
+    // Includes resolving the multisampled back buffer
+    GpuScope scope("swap");
+    SDL_GL_SwapWindow(state->window);
+  }
+
+  GpuProfiler::EndFrame();
+
+  if (state->slowRenderMs > 0) {
+    SDL_Delay(state->slowRenderMs);
+  }
+
+  if (state->slowRender && state->slowRender->Done()) {
+    return state->slowRender->Passed(*state->simulation) ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+  }
+
+  if (state->firstFrame) {
+    state->startup.LogEnd("Time to first frame");
+    state->firstFrame = false;
+  }
+
+  if (!state->fullyLoaded && state->world->IsLoaded()) {
+    state->startup.LogEnd("Time to full load");
+    state->fullyLoaded = true;
+  }
+
+  if (state->flight) {
+    state->flight->Record(state->world->GetViewCoverage(camera.GetPosition(), camera.GetFront()));
+    if (state->flight->Done()) {
+      return state->flight->Write(state->benchOutput, state->world->GetPrefetchStats()) ? SDL_APP_SUCCESS
+                                                                                        : SDL_APP_FAILURE;
+    }
+  }
+
+  if (state->benchmark) {
+    state->benchmark->EndFrame();
+    if (state->benchmark->Done()) {
+      bool written = state->benchmark->Write(state->benchOutput);
+      written = GpuProfiler::WriteJson(state->benchOutput + ".passes.json") && written;
+      written = MemoryTracker::WriteJson(state->benchOutput + ".memory.json") && written;
+      return written ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+    }
+  }
 
   return SDL_APP_CONTINUE;
 }
 
 void SDL_AppQuit(void *appstate, SDL_AppResult result) {
   Texture::Cleanup();
+  GpuProfiler::Cleanup();
   if (appstate) {
     GameState *state = static_cast<GameState *>(appstate);
+    if (state->simulation) {
+      state->simulation->Stop();
+    }
+    if (state->recording) {
+      state->recording->Save(state->recordPath);
+    }
+    if (!state->memoryPath.empty()) {
+      MemoryTracker::WriteJson(state->memoryPath);
+    }
+
     delete state;
   }
 }
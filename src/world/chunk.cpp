@@ -1,117 +1,575 @@
 #include "chunk.h"
-#include "SDL3/SDL_log.h"
-#include <FastNoiseLite.h>
+#include "core/gpu_profiler.h"
+#include "core/memory_tracker.h"
+#include "chunk_store.h"
+#include "gpu_mesher.h"
+#include "mesher.h"
+#include "occlusion.h"
+#include "terrain.h"
 #include <SDL3_image/SDL_image.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+
+// Light reaches this far into the neighbouring chunks
+static const int TERRAIN_MARGIN = LightVolume::MAX_LIGHT + 1;
+
+// Bounds of the vertices, the whole chunk if there are none
+static void MeshBounds(const std::vector<Vertex> &vertices, glm::vec3 &min, glm::vec3 &max) {
+  if (vertices.empty()) {
+    min = glm::vec3(-0.5f);
+    max = glm::vec3(VoxelGrid::SIZE - 0.5f);
+    return;
+  }
 
-Chunk::Chunk(const TextureAtlas &atlas, const glm::ivec3 &position, const glm::ivec3 &dimensions, int seed)
-    : mReady(false), mPosition(position), mDimensions(dimensions), mSeed(seed), mTextureAtlas(atlas) {
+  min = max = vertices.front().position;
+  for (const auto &vertex : vertices) {
+    min = glm::min(min, vertex.position);
+    max = glm::max(max, vertex.position);
+  }
 }
 
-void Chunk::GenerateVertices() {
-  VoxelGrid grid;
+// Grows the bounds by the corners of the face
+static void AddFaceBounds(CubeFace face, const glm::ivec3 &voxel, glm::vec3 &min, glm::vec3 &max) {
+  for (int corner : FACE_CORNERS[static_cast<int>(face)]) {
+    glm::vec3 position = glm::vec3(voxel) + glm::vec3(CornerSide(corner)) * 0.5f;
+    min = glm::min(min, position);
+    max = glm::max(max, position);
+  }
+}
 
-  FastNoiseLite noise;
-  noise.SetSeed(mSeed);
-  noise.SetNoiseType(FastNoiseLite::NoiseType_Cellular);
-  noise.SetFrequency(0.005);
-  noise.SetFractalType(FastNoiseLite::FractalType_FBm);
+// Meshes shared through the cache are joined by whoever meshed them first, the direction of each vertex is found from
+// its normal. AddCubeFace() gives front faces a -z normal and back faces a +z one.
+static void CountFaces(const std::vector<Vertex> &vertices, uint32_t (&counts)[CUBE_FACES]) {
+  std::fill(std::begin(counts), std::end(counts), 0);
+  for (const auto &vertex : vertices) {
+    const glm::vec3 &normal = vertex.normal;
+    CubeFace face = normal.x > 0.5f    ? CubeFace::Right
+                    : normal.x < -0.5f ? CubeFace::Left
+                    : normal.y > 0.5f  ? CubeFace::Top
+                    : normal.y < -0.5f ? CubeFace::Bottom
+                    : normal.z < -0.5f ? CubeFace::Front
+                                       : CubeFace::Back;
+    counts[static_cast<int>(face)]++;
+  }
+}
 
-  for (int z = 0; z < VoxelGrid::SIZE; ++z) {
-    for (int x = 0; x < VoxelGrid::SIZE; ++x) {
-      float nX = static_cast<float>(mPosition.x) * VoxelGrid::SIZE + static_cast<float>(x);
-      float nY = static_cast<float>(mPosition.y) * VoxelGrid::SIZE;
-      float nZ = static_cast<float>(mPosition.z) * VoxelGrid::SIZE + static_cast<float>(z);
-      float value = noise.GetNoise(nX, nY, nZ);
-      // Normalize the noise value between 0.0f, and 1.0f
-      value = (value + 1.0f / 2.0f);
+// A baked face: the voxel's x, y and z in 6 bits each, the light level in 4 and the ambient occlusion of each corner in
+// 2. The direction is given by the bucket the face is in.
+static_assert(VoxelGrid::SIZE <= 64 && LightVolume::MAX_LIGHT < 16 && MAX_OCCLUSION < 4, "A baked face is one word");
 
-      int height = std::floor(value * VoxelGrid::SIZE);
-      u64 column = (static_cast<u64>(1) << height) - 1;
-      grid.columns[x * VoxelGrid::SIZE + z] = column;
+static uint32_t PackFace(const glm::ivec3 &voxel, int light, const std::array<int, 4> &occlusion) {
+  uint32_t word = voxel.x | voxel.y << 6 | voxel.z << 12 | light << 18;
+  for (int i = 0; i < 4; ++i) {
+    word |= occlusion[i] << (22 + 2 * i);
+  }
+  return word;
+}
+
+static void UnpackFace(uint32_t word, glm::ivec3 &voxel, int &light, std::array<int, 4> &occlusion) {
+  voxel = glm::ivec3(word & 63, word >> 6 & 63, word >> 12 & 63);
+  light = word >> 18 & 15;
+  for (int i = 0; i < 4; ++i) {
+    occlusion[i] = word >> (22 + 2 * i) & 3;
+  }
+}
+
+Chunk::Chunk(const TextureAtlas &atlas, ChunkCache &cache, MeshPool *pool, ChunkStore &store,
+             const glm::ivec3 &position, int seed)
+    : mReady(false), mCancelled(false), mDirty(false), mRequestedAt(0), mGenerated(false),
+      mContent(ChunkContent::Mixed), mPosition(position), mSeed(seed), mBoundsMin(0.0f), mBoundsMax(0.0f),
+      mFaceCounts{}, mGpuMeshing(false), mOcclusion(true), mTextureAtlas(atlas), mCache(cache), mPool(pool),
+      mStore(store), mVao(0), mVbo(0) {
+  MemoryTracker::Allocate(MemoryTag::Chunks, sizeof(Chunk));
+}
+
+void Chunk::GenerateVertices(StreamingBuffer *staging) {
+  // A chunk baked by the pregeneration tool brings its faces, lit and occluded the way meshing its voxels would, so
+  // neither the terrain nor the light is needed
+  auto saved = mStore.Load(mPosition);
+  if (saved && saved->mesh && mOcclusion && !mSand) {
+    mContent = saved->content;
+    if (mContent == ChunkContent::Mixed) {
+      mGrid = mCache.Intern(*saved->grid);
+    }
+    mGenerated = true;
+    if (!mCancelled) {
+      ExpandBakedMesh(*saved->mesh, staging);
+    }
+    return;
+  }
+
+  // The chunk and the ring of neighbour columns its light can reach are generated in one go, so the noise lattice is
+  // shared between them
+  const int size = VoxelGrid::SIZE;
+  const int area = size + 2 * TERRAIN_MARGIN;
+  auto grid = std::make_unique<VoxelGrid>();
+  std::vector<u64> region(area * area);
+  MemoryScope scratch(MemoryTag::Scratch, sizeof(VoxelGrid) + region.size() * sizeof(u64));
+
+  Terrain terrain(mSeed);
+  terrain.Region(mPosition.x * size - TERRAIN_MARGIN, mPosition.y, mPosition.z * size - TERRAIN_MARGIN, area, area,
+                 region.data());
+  // A saved chunk replaces what the terrain generates. The columns around it still come from the terrain, even where
+  // a neighbour was saved.
+  if (saved) {
+    for (int x = 0; x < size; ++x) {
+      for (int z = 0; z < size; ++z) {
+        u64 column = saved->content == ChunkContent::Solid ? ~static_cast<u64>(0) : 0;
+        if (saved->content == ChunkContent::Mixed) {
+          column = saved->grid->columns[x * size + z];
+        }
+        region[(x + TERRAIN_MARGIN) * area + z + TERRAIN_MARGIN] = column;
+      }
+    }
+  }
+  if (mSand) {
+    for (int x = 0; x < size; ++x) {
+      for (int z = 0; z < size; ++z) {
+        region[(x + TERRAIN_MARGIN) * area + z + TERRAIN_MARGIN] |= mSand->columns[x * size + z];
+      }
     }
   }
+  auto columns = [&](int x, int z) {
+    if (x < -TERRAIN_MARGIN || z < -TERRAIN_MARGIN || x >= size + TERRAIN_MARGIN || z >= size + TERRAIN_MARGIN) {
+      return terrain.Column(mPosition.x * size + x, mPosition.y, mPosition.z * size + z);
+    }
+    return region[(x + TERRAIN_MARGIN) * area + z + TERRAIN_MARGIN];
+  };
+
+  u64 anySolid = 0;
+  u64 allSolid = ~static_cast<u64>(0);
+  for (int z = 0; z < size; ++z) {
+    for (int x = 0; x < size; ++x) {
+      u64 column = columns(x, z);
+      grid->columns[x * size + z] = column;
+      anySolid |= column;
+      allSolid &= column;
+    }
+  }
+
+  if (anySolid == 0) {
+    mContent = ChunkContent::Air;
+  } else if (allSolid == ~static_cast<u64>(0)) {
+    mContent = ChunkContent::Solid;
+  } else {
+    mGrid = mCache.Intern(*grid);
+  }
+  mGenerated = true;
 
-  mGrid = grid;
+  if (mCancelled || mContent == ChunkContent::Air) {
+    return;
+  }
+
+  // Columns outside the chunk come straight from the terrain, so light crosses chunk borders without waiting for the
+  // neighbours to load
+  LightVolume light;
+  light.Compute(columns, {});
+  mLight = mCache.Intern(std::move(light));
+
+  if (mCancelled) {
+    return;
+  }
+
+  if (mGpuMeshing && mContent == ChunkContent::Mixed && !mSand) {
+    mMeshInput = GpuMesher::Prepare(*mGrid, *mLight, mFaceCounts, mBoundsMin, mBoundsMax);
+    MemoryTracker::Allocate(MemoryTag::Meshes, mMeshInput.size() * sizeof(uint32_t));
+    if (staging) {
+      mStaging = staging->Allocate(mMeshInput.size() * sizeof(uint32_t));
+      if (mStaging) {
+        std::memcpy(staging->Pointer(*mStaging), mMeshInput.data(), mStaging->size);
+      }
+    }
+    return;
+  }
+
+  MeshOnCpu(staging);
+}
+
+template <typename Emit> bool Chunk::ForEachFace(Emit &&emit) {
+  if (mContent == ChunkContent::Mixed) {
+    return MeshGrid(*mGrid, emit, [&] { return mCancelled.load(); });
+  }
+
+  // A solid chunk can only be seen through its border: the top is always open, a side face is only visible where the
+  // neighbouring column is air, and nothing is below the world
+  const int size = VoxelGrid::SIZE;
+  for (int i = 0; i < size; ++i) {
+    for (int j = 0; j < size; ++j) {
+      emit(CubeFace::Top, i, size - 1, j);
+    }
+
+    std::pair<CubeFace, glm::ivec2> sides[] = {{CubeFace::Left, {0, i}},
+                                               {CubeFace::Right, {size - 1, i}},
+                                               {CubeFace::Back, {i, 0}},
+                                               {CubeFace::Front, {i, size - 1}}};
+    for (const auto &[face, voxel] : sides) {
+      auto direction = FaceDirection(face);
+      for (u64 open = ~Column(voxel.x + direction.x, voxel.y + direction.z); open != 0; open &= open - 1) {
+        emit(face, voxel.x, std::countr_zero(open), voxel.y);
+      }
+    }
+  }
+  return !mCancelled;
+}
+
+void Chunk::MeshOnCpu(StreamingBuffer *staging) {
+  // Mixed meshes go through the cache, staged or not. The cache only holds weak references, so the chunk keeps its mesh
+  // for the next chunk with the same contents to find. It doesn't know which voxels are sand, so those meshes aren't
+  // shared.
+  bool cached = mContent == ChunkContent::Mixed && !mSand;
+  auto shared = cached ? mCache.FindMesh(mGrid.get(), mLight.get()) : nullptr;
+  if (shared) {
+    MeshBounds(*shared, mBoundsMin, mBoundsMax);
+    CountFaces(*shared, mFaceCounts);
+    mVertices = std::move(shared);
+    StageVertices(staging);
+    return;
+  }
+
+  // The faces are counted first, so the mesh can be written in place one direction after the other. Mapped memory
+  // can't be read back, so the bounds are found here too.
+  uint32_t faces[CUBE_FACES] = {};
+  glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+  bool counted = ForEachFace([&](CubeFace face, int x, int y, int z) {
+    faces[static_cast<int>(face)]++;
+    AddFaceBounds(face, glm::ivec3(x, y, z), min, max);
+  });
+  if (!counted) {
+    return;
+  }
+
+  size_t vertices = 0;
+  for (int i = 0; i < CUBE_FACES; ++i) {
+    mFaceCounts[i] = faces[i] * 6;
+    vertices += mFaceCounts[i];
+  }
+  if (vertices == 0) {
+    MeshBounds({}, mBoundsMin, mBoundsMax);
+    return;
+  }
+  mBoundsMin = min;
+  mBoundsMax = max;
+
+  // Meshes which aren't shared are written straight into the streaming buffer
+  Vertex *mesh = nullptr;
+  std::vector<Vertex> kept;
+  mStaging = staging && !cached ? staging->Allocate(sizeof(Vertex) * vertices) : std::nullopt;
+  if (mStaging) {
+    mesh = static_cast<Vertex *>(staging->Pointer(*mStaging));
+  } else {
+    kept.resize(vertices);
+    mesh = kept.data();
+  }
+
+  Vertex *next[CUBE_FACES];
+  for (int i = 0; i < CUBE_FACES; ++i) {
+    next[i] = mesh;
+    mesh += mFaceCounts[i];
+  }
 
   // TODO: As a next step:
   // - implement Greedy Meshing algorithm
   // - currently there are duplicated vertices, we should use indexing to reduce the number of vertices
-  for (int z = 0; z < mDimensions.z; z++) {
-    for (int y = 0; y < mDimensions.y; y++) {
-      for (int x = 0; x < mDimensions.x; x++) {
-        // TODO: hardcode the tile to dirt for now. I need to separate the vertex information from the texture
-        // information
-        const auto tile = Tile::Dirt;
-        if (!grid(x, y, z)) {
-          continue;
-        }
+  // TODO: hardcode the tile to dirt for now. I need to separate the vertex information from the texture information
+  // Sand is the exception, the chunk knows where it is. Until the atlas has a sand tile it is drawn as dirt too.
+  const auto tile = Tile::Dirt;
+  const auto sandTile = mTextureAtlas.GetTexture(TextureType::Sand) ? Tile::Sand : tile;
+  bool meshed = ForEachFace([&](CubeFace face, int x, int y, int z) {
+    bool sand = mSand && (*mSand)(x, y, z);
+    AddCubeFace(next[static_cast<int>(face)], sand ? sandTile : tile, face, x, y, z);
+  });
+  // A cancelled chunk keeps its staging, the world discards it
+  if (!meshed) {
+    return;
+  }
 
-        if (y == (mDimensions.y - 1) || !grid(x, y + 1, z)) {
-          AddCubeFace(tile, CubeFace::Top, x, y, z);
-        }
+  if (cached) {
+    mVertices = mCache.AddMesh(mGrid.get(), mLight.get(), std::move(kept));
+    StageVertices(staging);
+  } else if (!kept.empty()) {
+    size_t bytes = kept.capacity() * sizeof(Vertex);
+    mVertices = MakeTracked(MemoryTag::Meshes, bytes, new std::vector<Vertex>(std::move(kept)));
+  }
+}
 
-        if (y == 0 || !grid(x, y - 1, z)) {
-          AddCubeFace(tile, CubeFace::Bottom, x, y, z);
-        }
+std::shared_ptr<const BakedMesh> Chunk::BakeMesh() {
+  if (mSand) {
+    return nullptr;
+  }
 
-        if (x == 0 || !grid(x - 1, y, z)) {
-          AddCubeFace(tile, CubeFace::Left, x, y, z);
-        }
+  auto mesh = std::make_shared<BakedMesh>();
+  // Air chunks have neither faces nor the light to bake them with
+  if (mContent == ChunkContent::Air) {
+    return mesh;
+  }
 
-        if (x == mDimensions.x - 1 || !grid(x + 1, y, z)) {
-          AddCubeFace(tile, CubeFace::Right, x, y, z);
-        }
+  std::vector<uint32_t> faces[CUBE_FACES];
+  bool baked = ForEachFace([&](CubeFace face, int x, int y, int z) {
+    glm::ivec3 voxel(x, y, z);
+    faces[static_cast<int>(face)].push_back(PackFace(voxel, FaceLight(face, voxel), FaceCorners(face, voxel)));
+  });
+  if (!baked) {
+    return nullptr;
+  }
 
-        if (z == 0 || !grid(x, y, z - 1)) {
-          AddCubeFace(tile, CubeFace::Back, x, y, z);
-        }
+  for (int i = 0; i < CUBE_FACES; ++i) {
+    mesh->counts[i] = static_cast<uint32_t>(faces[i].size());
+    mesh->faces.insert(mesh->faces.end(), faces[i].begin(), faces[i].end());
+  }
+  return mesh;
+}
 
-        if (z == mDimensions.z - 1 || !grid(x, y, z + 1)) {
-          AddCubeFace(tile, CubeFace::Front, x, y, z);
-        }
-      }
+void Chunk::ExpandBakedMesh(const BakedMesh &mesh, StreamingBuffer *staging) {
+  size_t vertices = 0;
+  for (int i = 0; i < CUBE_FACES; ++i) {
+    mFaceCounts[i] = mesh.counts[i] * 6;
+    vertices += mFaceCounts[i];
+  }
+  if (vertices == 0) {
+    MeshBounds({}, mBoundsMin, mBoundsMax);
+    return;
+  }
+
+  // Like a solid chunk's mesh it is written in place, so the bounds are found on the way
+  Vertex *next = nullptr;
+  std::vector<Vertex> kept;
+  mStaging = staging ? staging->Allocate(sizeof(Vertex) * vertices) : std::nullopt;
+  if (mStaging) {
+    next = static_cast<Vertex *>(staging->Pointer(*mStaging));
+  } else {
+    kept.resize(vertices);
+    next = kept.data();
+  }
+
+  // Dirt, like MeshOnCpu()
+  const auto tile = Tile::Dirt;
+  glm::vec3 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+  const uint32_t *face = mesh.faces.data();
+  for (int i = 0; i < CUBE_FACES; ++i) {
+    auto direction = static_cast<CubeFace>(i);
+    for (uint32_t j = 0; j < mesh.counts[i]; ++j) {
+      glm::ivec3 voxel;
+      int light;
+      std::array<int, 4> occlusion;
+      UnpackFace(*face++, voxel, light, occlusion);
+      AddCubeFace(next, tile, direction, voxel, light, occlusion);
+      AddFaceBounds(direction, voxel, min, max);
     }
   }
+  mBoundsMin = min;
+  mBoundsMax = max;
 
-  SDL_Log("Chunk (%d, %d, %d): %zu vertices", mPosition.x, mPosition.y, mPosition.z, mVertices.size());
+  if (!kept.empty()) {
+    size_t bytes = kept.capacity() * sizeof(Vertex);
+    mVertices = MakeTracked(MemoryTag::Meshes, bytes, new std::vector<Vertex>(std::move(kept)));
+  }
+}
+
+void Chunk::StageVertices(StreamingBuffer *staging) {
+  if (!staging) {
+    return;
+  }
+  mStaging = staging->Allocate(sizeof(Vertex) * mVertices->size());
+  if (mStaging) {
+    std::memcpy(staging->Pointer(*mStaging), mVertices->data(), mStaging->size);
+  }
 }
 
-void Chunk::SetupVAO() {
+bool Chunk::Solid(int x, int y, int z) const {
+  switch (mContent) {
+    case ChunkContent::Air:
+      return false;
+    case ChunkContent::Solid:
+      return true;
+    default:
+      return (*mGrid)(x, y, z);
+  }
+}
+
+u64 Chunk::Column(int x, int z) const {
+  const int size = VoxelGrid::SIZE;
+  if (x < 0 || z < 0 || x >= size || z >= size) {
+    return mLight->Border(x, z);
+  }
+  return mContent == ChunkContent::Solid ? ~static_cast<u64>(0) : mGrid->columns[x * size + z];
+}
+
+void Chunk::SetupVAO(StreamingBuffer &buffer, GpuMesher *mesher) {
   if (mReady) {
     return;
   }
 
+  // No mesher to take the input, e.g. its shader failed to compile
+  if (!mMeshInput.empty() && !mesher) {
+    if (mStaging) {
+      buffer.Discard(*mStaging);
+      mStaging.reset();
+    }
+    ReleaseMeshInput();
+    MeshOnCpu(nullptr);
+  }
+
+  // Nothing to draw, e.g. an all air chunk
+  size_t vertices = VertexCount();
+  if (vertices == 0) {
+    mReady = true;
+    return;
+  }
+
+  size_t bytes = sizeof(Vertex) * vertices;
+  mPoolRange = mPool->Allocate(vertices);
+  if (mPoolRange) {
+    Upload(buffer, mesher, mPool->Buffer(), mPoolRange->offset);
+    mReady = true;
+    return;
+  }
+
   glCreateVertexArrays(1, &mVao);
   glCreateBuffers(1, &mVbo);
   glBindVertexArray(mVao);
   glBindBuffer(GL_ARRAY_BUFFER, mVbo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * mVertices.size(), mVertices.data(), GL_STATIC_DRAW);
+  // Uploads that were too big for the streaming buffer go through glNamedBufferSubData()
+  glNamedBufferStorage(mVbo, bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+  Upload(buffer, mesher, mVbo, 0);
+  MemoryTracker::RegisterBuffer(mVbo, GpuTag::ChunkBuffers, bytes);
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)(offsetof(Vertex, position)));
   glEnableVertexAttribArray(0);
   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)(offsetof(Vertex, textureCoords)));
   glEnableVertexAttribArray(1);
   glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)(offsetof(Vertex, normal)));
   glEnableVertexAttribArray(2);
+  glVertexAttribPointer(3, 1, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void *)(offsetof(Vertex, light)));
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(4, 1, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void *)(offsetof(Vertex, occlusion)));
+  glEnableVertexAttribArray(4);
   mReady = true;
 }
 
+void Chunk::Upload(StreamingBuffer &buffer, GpuMesher *mesher, GLuint target, size_t first) {
+  if (!mMeshInput.empty()) {
+    if (mStaging) {
+      buffer.Copy(*mStaging, mesher->InputBuffer(), 0);
+    } else {
+      glNamedBufferSubData(mesher->InputBuffer(), 0, mMeshInput.size() * sizeof(uint32_t), mMeshInput.data());
+    }
+    mesher->Mesh(target, first, mFaceCounts);
+    ReleaseMeshInput();
+  } else if (mStaging) {
+    buffer.Copy(*mStaging, target, first * sizeof(Vertex));
+  } else {
+    glNamedBufferSubData(target, first * sizeof(Vertex), sizeof(Vertex) * mVertices->size(), mVertices->data());
+  }
+  mStaging.reset();
+}
+
 Chunk::~Chunk() {
-  glDeleteVertexArrays(1, &mVao);
-  glDeleteBuffers(1, &mVbo);
+  if (mPoolRange) {
+    mPool->Free(*mPoolRange);
+  }
+  if (mVao != 0) {
+    glDeleteVertexArrays(1, &mVao);
+    MemoryTracker::ReleaseBuffer(mVbo);
+    glDeleteBuffers(1, &mVbo);
+  }
+  ReleaseMeshInput();
+  MemoryTracker::Free(MemoryTag::Chunks, sizeof(Chunk));
+}
+
+void Chunk::ReleaseMeshInput() {
+  if (mMeshInput.empty()) {
+    return;
+  }
+  MemoryTracker::Free(MemoryTag::Meshes, mMeshInput.size() * sizeof(uint32_t));
+  mMeshInput = {};
+}
+
+size_t Chunk::VertexCount() const {
+  size_t vertices = 0;
+  for (uint32_t count : mFaceCounts) {
+    vertices += count;
+  }
+  return vertices;
+}
+
+unsigned Chunk::VisibleFaces(const glm::vec3 &eye) const {
+  glm::vec3 origin = glm::vec3(mPosition * VoxelGrid::SIZE);
+  return FacesTowards(eye, origin + mBoundsMin, origin + mBoundsMax);
+}
+
+uint32_t Chunk::FaceVertices(unsigned faces) const {
+  uint32_t vertices = 0;
+  for (int i = 0; i < CUBE_FACES; ++i) {
+    vertices += faces & (1u << i) ? mFaceCounts[i] : 0;
+  }
+  return vertices;
 }
 
-void Chunk::Render() {
-  if (!mReady) {
+int Chunk::FaceRanges(unsigned faces, GLint base, GLint (&first)[CUBE_FACES], GLsizei (&count)[CUBE_FACES]) const {
+  int ranges = 0;
+  bool extend = false;
+  for (int i = 0; i < CUBE_FACES; ++i) {
+    if (!(faces & (1u << i)) || mFaceCounts[i] == 0) {
+      extend = extend && mFaceCounts[i] == 0;
+      base += mFaceCounts[i];
+      continue;
+    }
+
+    if (!extend) {
+      first[ranges] = base;
+      count[ranges++] = 0;
+    }
+    count[ranges - 1] += mFaceCounts[i];
+    base += mFaceCounts[i];
+    extend = true;
+  }
+  return ranges;
+}
+
+void Chunk::Render(unsigned faces) {
+  if (!mReady || mVao == 0) {
+    return;
+  }
+
+  GLint first[CUBE_FACES];
+  GLsizei count[CUBE_FACES];
+  int ranges = FaceRanges(faces, 0, first, count);
+  uint32_t drawn = FaceVertices(faces);
+  GpuProfiler::CountSkippedVertices(VertexCount() - drawn);
+  if (ranges == 0) {
     return;
   }
 
   // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
   glBindVertexArray(mVao);
-  glDrawArrays(GL_TRIANGLES, 0, mVertices.size());
+  glMultiDrawArrays(GL_TRIANGLES, first, count, ranges);
+  GpuProfiler::CountStateChange();
+  GpuProfiler::CountDraw(drawn / 3);
   glBindVertexArray(0);
 }
 
-void Chunk::AddCubeFace(Tile tile, CubeFace face, int x, int y, int z) {
+int Chunk::FaceLight(CubeFace face, const glm::ivec3 &voxel) const {
+  auto neighbor = voxel + FaceDirection(face);
+  return mLight->Level(neighbor.x, neighbor.y, neighbor.z);
+}
+
+std::array<int, 4> Chunk::FaceCorners(CubeFace face, const glm::ivec3 &voxel) const {
+  if (!mOcclusion) {
+    return {MAX_OCCLUSION, MAX_OCCLUSION, MAX_OCCLUSION, MAX_OCCLUSION};
+  }
+  return FaceOcclusion(face, voxel, [this](const glm::ivec3 &p) {
+    return p.y >= 0 && p.y < VoxelGrid::SIZE && (Column(p.x, p.z) >> p.y & 1);
+  });
+}
+
+void Chunk::AddCubeFace(Vertex *&vertices, Tile tile, CubeFace face, int x, int y, int z) {
+  glm::ivec3 voxel(x, y, z);
+  AddCubeFace(vertices, tile, face, voxel, FaceLight(face, voxel), FaceCorners(face, voxel));
+}
+
+void Chunk::AddCubeFace(Vertex *&vertices, Tile tile, CubeFace face, const glm::ivec3 &voxel, int light,
+                        const std::array<int, 4> &occlusion) {
   TextureType textureType;
   switch (tile) {
     case Tile::Dirt:
@@ -126,89 +584,18 @@ void Chunk::AddCubeFace(Tile tile, CubeFace face, int x, int y, int z) {
   }
 
   auto texture = *mTextureAtlas.GetTexture(textureType);
+  uint8_t lightByte = UnitByte(light, LightVolume::MAX_LIGHT);
 
-  glm::vec3 frontTopLeft = {x - 0.5f, y + 0.5f, z + 0.5f};
-  glm::vec3 frontTopRight = {x + 0.5f, y + 0.5f, z + 0.5f};
-  glm::vec3 frontBottomLeft = {x - 0.5f, y - 0.5f, z + 0.5f};
-  glm::vec3 frontBottomRight = {x + 0.5f, y - 0.5f, z + 0.5f};
-
-  glm::vec3 backTopLeft = {x - 0.5f, y + 0.5f, z - 0.5f};
-  glm::vec3 backTopRight = {x + 0.5f, y + 0.5f, z - 0.5f};
-  glm::vec3 backBottomLeft = {x - 0.5f, y - 0.5f, z - 0.5f};
-  glm::vec3 backBottomRight = {x + 0.5f, y - 0.5f, z - 0.5f};
-
-  glm::vec3 normalTop = {0.0, 1.0, 0.0};
-  glm::vec3 normalBottom = {0.0, -1.0, 0.0};
-  glm::vec3 normalLeft = {-1.0, 0.0, 0.0};
-  glm::vec3 normalRight = {1.0, 0.0, 0.0};
-  glm::vec3 normalFront = {0.0, 0.0, -1.0};
-  glm::vec3 normalBack = {0.0, 0.0, 1.0};
-
-  switch (face) {
-    case CubeFace::Front: {
-      mVertices.push_back(Vertex{frontBottomLeft, texture.BottomLeft(), normalFront});
-      mVertices.push_back(Vertex{frontBottomRight, texture.BottomRight(), normalFront});
-      mVertices.push_back(Vertex{frontTopLeft, texture.TopLeft(), normalFront});
-
-      mVertices.push_back(Vertex{frontBottomRight, texture.BottomRight(), normalFront});
-      mVertices.push_back(Vertex{frontTopRight, texture.TopRight(), normalFront});
-      mVertices.push_back(Vertex{frontTopLeft, texture.TopLeft(), normalFront});
-      break;
-    }
-    case CubeFace::Back: {
-      mVertices.push_back(Vertex{backBottomLeft, texture.BottomRight(), normalBack});
-      mVertices.push_back(Vertex{backTopLeft, texture.TopRight(), normalBack});
-      mVertices.push_back(Vertex{backTopRight, texture.TopLeft(), normalBack});
-
-      mVertices.push_back(Vertex{backTopRight, texture.TopLeft(), normalBack});
-      mVertices.push_back(Vertex{backBottomRight, texture.BottomLeft(), normalBack});
-      mVertices.push_back(Vertex{backBottomLeft, texture.BottomRight(), normalBack});
-      break;
-    }
-
-    case CubeFace::Left: {
-      mVertices.push_back(Vertex{backBottomLeft, texture.BottomLeft(), normalLeft});
-      mVertices.push_back(Vertex{frontBottomLeft, texture.BottomRight(), normalLeft});
-      mVertices.push_back(Vertex{backTopLeft, texture.TopLeft(), normalLeft});
-
-      mVertices.push_back(Vertex{frontBottomLeft, texture.BottomRight(), normalLeft});
-      mVertices.push_back(Vertex{frontTopLeft, texture.TopRight(), normalLeft});
-      mVertices.push_back(Vertex{backTopLeft, texture.TopLeft(), normalLeft});
-      break;
-    }
-
-    case CubeFace::Right: {
-      mVertices.push_back(Vertex{frontBottomRight, texture.BottomLeft(), normalRight});
-      mVertices.push_back(Vertex{backBottomRight, texture.BottomRight(), normalRight});
-      mVertices.push_back(Vertex{frontTopRight, texture.TopLeft(), normalRight});
-
-      mVertices.push_back(Vertex{frontTopRight, texture.TopLeft(), normalRight});
-      mVertices.push_back(Vertex{backBottomRight, texture.BottomRight(), normalRight});
-      mVertices.push_back(Vertex{backTopRight, texture.TopRight(), normalRight});
-      break;
-    }
-
-    case CubeFace::Top: {
-      mVertices.push_back(Vertex{frontTopLeft, texture.BottomLeft(), normalTop});
-      mVertices.push_back(Vertex{frontTopRight, texture.BottomRight(), normalTop});
-      mVertices.push_back(Vertex{backTopLeft, texture.TopLeft(), normalTop});
-
-      mVertices.push_back(Vertex{backTopLeft, texture.TopLeft(), normalTop});
-      mVertices.push_back(Vertex{frontTopRight, texture.BottomRight(), normalTop});
-      mVertices.push_back(Vertex{backTopRight, texture.TopRight(), normalTop});
-
-      break;
-    }
-
-    case CubeFace::Bottom: {
-      mVertices.push_back(Vertex{frontBottomLeft, texture.BottomRight(), normalBottom});
-      mVertices.push_back(Vertex{backBottomLeft, texture.TopRight(), normalBottom});
-      mVertices.push_back(Vertex{backBottomRight, texture.TopLeft(), normalBottom});
+  // Front faces get a -z normal and back faces a +z one, CountFaces() and mesh.comp expect that
+  glm::vec3 normal = FaceDirection(face);
+  if (face == CubeFace::Front || face == CubeFace::Back) {
+    normal.z = -normal.z;
+  }
 
-      mVertices.push_back(Vertex{backBottomRight, texture.TopLeft(), normalBottom});
-      mVertices.push_back(Vertex{frontBottomRight, texture.BottomLeft(), normalBottom});
-      mVertices.push_back(Vertex{frontBottomLeft, texture.BottomRight(), normalBottom});
-      break;
-    }
+  const glm::vec2 textureCoords[4] = {texture.BottomLeft(), texture.BottomRight(), texture.TopRight(),
+                                      texture.TopLeft()};
+  for (int i : QuadTriangles(FlipQuad(occlusion))) {
+    glm::vec3 position = glm::vec3(voxel) + glm::vec3(CornerSide(FACE_CORNERS[static_cast<int>(face)][i])) * 0.5f;
+    *vertices++ = Vertex{position, textureCoords[i], normal, lightByte, UnitByte(occlusion[i], MAX_OCCLUSION), {}};
   }
 }
@@ -1,48 +1,138 @@
 #pragma once
 
+#include "core/streaming_buffer.h"
 #include "core/texture.h"
+#include "chunk_cache.h"
 #include "cube.h"
+#include "light.h"
+#include "mesh_pool.h"
 #include "texture_atlas.h"
 #include "tile.h"
+#include "vertex.h"
+#include "voxel_grid.h"
 #include <GL/glew.h>
-#include <cstdint>
+#include <array>
+#include <atomic>
 #include <glm/glm.hpp>
+#include <memory>
 
-typedef uint64_t u64;
-
-struct VoxelGrid {
-  static const int SIZE = 64;
-  u64 columns[SIZE * SIZE];
-
-  bool operator()(int x, int y, int z) const {
-    return columns[x * SIZE + z] & (static_cast<u64>(1) << y);
-  }
+// Chunks made of a single voxel type don't store a grid, the tag says what they are filled with
+enum class ChunkContent {
+  Mixed,
+  Air,
+  Solid
 };
 
-struct Vertex {
-  glm::vec3 position;
-  glm::vec2 textureCoords;
-  glm::vec3 normal;
+// The faces of a chunk's mesh in mesh order, each packed into a word with its voxel, light and ambient occlusion.
+// Expanding it gives back the mesh without the terrain, the light or the occlusion lookups, at a fiftieth of the size.
+struct BakedMesh {
+  // Faces of each direction, the faces hold one direction after the other in CubeFace order
+  uint32_t counts[CUBE_FACES] = {};
+  std::vector<uint32_t> faces;
 };
 
+class ChunkStore;
+class GpuMesher;
+
 struct Chunk {
-  bool mReady;
-  VoxelGrid mGrid;
-  glm::ivec3 mPosition, mDimensions;
+  // Set by the render side once the mesh is uploaded. The simulation side reads it to swap in remeshed chunks.
+  std::atomic<bool> mReady;
+  // Set by the world when the chunk leaves the load radius, generation checks it and stops early
+  std::atomic<bool> mCancelled;
+  // Set by whatever edits the voxels, the world saves dirty chunks when they are unloaded
+  std::atomic<bool> mDirty;
+  unsigned long mRequestedAt;
+  // Set by the worker once mContent and mGrid hold the chunk's voxels, saved edits included. Other threads may read
+  // them from then on, e.g. collision on the simulation thread.
+  std::atomic<bool> mGenerated;
+  ChunkContent mContent;
+  // Only set for mixed chunks, shared with every other chunk of the same content
+  std::shared_ptr<const VoxelGrid> mGrid;
+  // Empty for air chunks, they have no faces to light
+  std::shared_ptr<const LightVolume> mLight;
+  glm::ivec3 mPosition;
   int mSeed;
-  std::vector<Vertex> mVertices;
+  std::shared_ptr<const std::vector<Vertex>> mVertices;
+  // Chunk local bounds of the mesh
+  glm::vec3 mBoundsMin, mBoundsMax;
+  // The mesh holds the faces of one direction after the other in CubeFace order, these are the vertices of each
+  uint32_t mFaceCounts[CUBE_FACES];
+  // Set by the world before the chunk is generated. Mixed chunks then leave mVertices empty and only prepare the
+  // input of the GPU mesher, which builds the mesh when the chunk is uploaded.
+  bool mGpuMeshing;
+  // Set before the chunk is generated, on by default. Without it the CPU mesher leaves every corner unoccluded, which
+  // the occlusion benchmark measures against. The mesh cache doesn't tell both apart, so such chunks need their own.
+  bool mOcclusion;
+  // Set by the world before the chunk is generated: sand voxels on top of the saved or generated ones. They are solid
+  // like any other voxel and meshed with the sand tile, so such chunks neither share their mesh nor use the GPU mesher
+  // or a baked mesh.
+  std::shared_ptr<const VoxelGrid> mSand;
+  std::vector<uint32_t> mMeshInput;
+  // Where the worker thread left the vertices (or the mesher input) in the streaming buffer, empty if they have to be
+  // uploaded directly
+  std::optional<RingAllocation> mStaging;
   const TextureAtlas &mTextureAtlas;
+  ChunkCache &mCache;
+  // Null for chunks which are never drawn, e.g. in the pregeneration tool
+  MeshPool *mPool;
+  // Saved chunks are loaded from here instead of being generated
+  ChunkStore &mStore;
 
+  // Where the mesh lives in the pool, if it didn't fit the chunk has a buffer and vertex array of its own
+  std::optional<RangeAllocation> mPoolRange;
   GLuint mVao, mVbo;
 
-  Chunk(const TextureAtlas &atlas, const glm::ivec3 &postion, const glm::ivec3 &dimensions, int seed);
+  // Only SetupVAO(), Render() and the destructor touch GL, so a chunk can be generated without a context
+  Chunk(const TextureAtlas &atlas, ChunkCache &cache, MeshPool *pool, ChunkStore &store, const glm::ivec3 &postion,
+        int seed);
   ~Chunk();
 
-  void GenerateVertices();
-  void SetupVAO();
+  // With a streaming buffer the mesh (or the mesher input) goes into it and mStaging says where. Solid chunks are
+  // written straight into it. Mixed chunks keep their mesh in mVertices too, shared through the cache with every chunk
+  // of the same contents, and stage a copy of it. Without a buffer, or if it has no room, the vertices are only kept
+  // in mVertices.
+  void GenerateVertices(StreamingBuffer *staging = nullptr);
+  bool Solid(int x, int y, int z) const;
+  // Packs the faces of a generated chunk for the store, null if it was cancelled. A baked face has no tile, so chunks
+  // with sand aren't baked either.
+  std::shared_ptr<const BakedMesh> BakeMesh();
+  // Without a mesher, chunks waiting for the GPU mesher are meshed on the CPU here
+  void SetupVAO(StreamingBuffer &buffer, GpuMesher *mesher);
+
+  // Vertices of the mesh, wherever it was built
+  size_t VertexCount() const;
+  // Face directions of the mesh which can face the eye, see FacesTowards()
+  unsigned VisibleFaces(const glm::vec3 &eye) const;
+  // Vertices of the given face directions
+  uint32_t FaceVertices(unsigned faces) const;
+  // Ranges of the mesh holding the given face directions, offset by base. Neighbouring directions are merged into one
+  // range. Returns the number of ranges.
+  int FaceRanges(unsigned faces, GLint base, GLint (&first)[CUBE_FACES], GLsizei (&count)[CUBE_FACES]) const;
 
-  void Render();
+  // Only draws chunks outside the mesh pool, the world draws the pooled ones. Face directions not in faces are skipped.
+  void Render(unsigned faces = ALL_FACES);
 
 private:
-  void AddCubeFace(Tile tile, CubeFace face, int x, int y, int z);
+  // Meshes the chunk from its grid and light, or takes a mixed chunk's mesh from the cache
+  void MeshOnCpu(StreamingBuffer *staging);
+  // Writes the mesh of a baked chunk, into the streaming buffer if it has room
+  void ExpandBakedMesh(const BakedMesh &mesh, StreamingBuffer *staging);
+  // Copies mVertices into the streaming buffer, if there is room
+  void StageVertices(StreamingBuffer *staging);
+  // Calls emit(face, x, y, z) for every face of the mesh, returns false if the chunk was cancelled meanwhile
+  template <typename Emit> bool ForEachFace(Emit &&emit);
+  // Writes the mesh to the buffer from vertex first on
+  void Upload(StreamingBuffer &buffer, GpuMesher *mesher, GLuint target, size_t first);
+  // Drops the GPU mesher input once it was uploaded or isn't needed anymore, the only place that frees its memory
+  void ReleaseMeshInput();
+  // Solid voxels of the column at chunk local (x, z), x and z go from -1 to SIZE. Needs the light, which keeps the ring
+  // around the chunk.
+  u64 Column(int x, int z) const;
+  // Light level in front of the face and the ambient occlusion of its corners
+  int FaceLight(CubeFace face, const glm::ivec3 &voxel) const;
+  std::array<int, 4> FaceCorners(CubeFace face, const glm::ivec3 &voxel) const;
+  // Writes the six vertices of the face and moves past them
+  void AddCubeFace(Vertex *&vertices, Tile tile, CubeFace face, int x, int y, int z);
+  void AddCubeFace(Vertex *&vertices, Tile tile, CubeFace face, const glm::ivec3 &voxel, int light,
+                   const std::array<int, 4> &occlusion);
 };
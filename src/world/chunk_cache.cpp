@@ -0,0 +1,147 @@
+#include "chunk_cache.h"
+#include "core/memory_tracker.h"
+#include <cstring>
+
+namespace {
+
+u64 HashGrid(const VoxelGrid &grid) {
+  u64 hash = 14695981039346656037ull;
+  for (u64 column : grid.columns) {
+    hash = (hash ^ column) * 1099511628211ull;
+  }
+  return hash;
+}
+
+template <typename T, typename Equal>
+std::shared_ptr<const T> Find(std::unordered_multimap<u64, std::weak_ptr<const T>> &map, u64 hash, Equal &&equal) {
+  auto [begin, end] = map.equal_range(hash);
+  for (auto it = begin; it != end;) {
+    auto existing = it->second.lock();
+    if (!existing) {
+      it = map.erase(it);
+      continue;
+    }
+
+    if (equal(*existing)) {
+      return existing;
+    }
+    ++it;
+  }
+
+  return nullptr;
+}
+
+template <typename Map>
+void EraseExpired(Map &map) {
+  for (auto it = map.begin(); it != map.end();) {
+    it = it->second.expired() ? map.erase(it) : std::next(it);
+  }
+}
+
+} // namespace
+
+size_t ChunkCache::MeshKeyHash::operator()(const MeshKey &key) const {
+  return std::hash<const void *>()(key.grid) ^ (std::hash<const void *>()(key.light) << 1);
+}
+
+ChunkCache::ChunkCache() : mMutex(SDL_CreateMutex()), mInserts(0), mTrackedBytes(0) {
+}
+
+ChunkCache::~ChunkCache() {
+  if (mTrackedBytes > 0) {
+    MemoryTracker::Free(MemoryTag::Caches, mTrackedBytes);
+  }
+  SDL_DestroyMutex(mMutex);
+}
+
+std::shared_ptr<const VoxelGrid> ChunkCache::Intern(const VoxelGrid &grid) {
+  u64 hash = HashGrid(grid);
+
+  SDL_LockMutex(mMutex);
+  auto existing = Find(mGrids, hash, [&](const VoxelGrid &other) {
+    return std::memcmp(grid.columns, other.columns, sizeof(grid.columns)) == 0;
+  });
+  if (!existing) {
+    // Not make_shared, a weak reference would keep the voxels of a dead entry allocated
+    existing = MakeTracked(MemoryTag::Voxels, sizeof(VoxelGrid), new VoxelGrid(grid));
+    mGrids.emplace(hash, existing);
+    Prune();
+  }
+  SDL_UnlockMutex(mMutex);
+
+  return existing;
+}
+
+std::shared_ptr<const LightVolume> ChunkCache::Intern(LightVolume &&light) {
+  u64 hash = light.Hash();
+
+  SDL_LockMutex(mMutex);
+  auto existing = Find(mLights, hash, [&](const LightVolume &other) { return light == other; });
+  if (!existing) {
+    size_t bytes = light.Bytes();
+    existing = MakeTracked(MemoryTag::Light, bytes, new LightVolume(std::move(light)));
+    mLights.emplace(hash, existing);
+    Prune();
+  }
+  SDL_UnlockMutex(mMutex);
+
+  return existing;
+}
+
+std::shared_ptr<const std::vector<Vertex>> ChunkCache::FindMesh(const VoxelGrid *grid, const LightVolume *light) {
+  SDL_LockMutex(mMutex);
+  std::shared_ptr<const std::vector<Vertex>> mesh;
+  auto it = mMeshes.find({grid, light});
+  if (it != mMeshes.end()) {
+    mesh = it->second.lock();
+  }
+  SDL_UnlockMutex(mMutex);
+
+  return mesh;
+}
+
+std::shared_ptr<const std::vector<Vertex>> ChunkCache::AddMesh(const VoxelGrid *grid, const LightVolume *light,
+                                                               std::vector<Vertex> &&vertices) {
+  SDL_LockMutex(mMutex);
+  auto &entry = mMeshes[{grid, light}];
+  auto mesh = entry.lock();
+  if (!mesh) {
+    size_t bytes = vertices.capacity() * sizeof(Vertex);
+    mesh = MakeTracked(MemoryTag::Meshes, bytes, new std::vector<Vertex>(std::move(vertices)));
+    entry = mesh;
+    Prune();
+  }
+  SDL_UnlockMutex(mMutex);
+
+  return mesh;
+}
+
+void ChunkCache::Prune() {
+  if (++mInserts >= PRUNE_INTERVAL) {
+    mInserts = 0;
+    EraseExpired(mGrids);
+    EraseExpired(mLights);
+    EraseExpired(mMeshes);
+  }
+
+  Track();
+}
+
+void ChunkCache::Track() {
+  // Nodes plus bucket arrays, roughly what the standard library allocates for the maps
+  auto bytes = [](const auto &map) {
+    using Node = std::pair<typename std::decay_t<decltype(map)>::value_type, void *>;
+    return map.size() * sizeof(Node) + map.bucket_count() * sizeof(void *);
+  };
+
+  size_t total = bytes(mGrids) + bytes(mLights) + bytes(mMeshes);
+  if (total == mTrackedBytes) {
+    return;
+  }
+
+  if (mTrackedBytes > 0) {
+    MemoryTracker::Free(MemoryTag::Caches, mTrackedBytes);
+  }
+  MemoryTracker::Allocate(MemoryTag::Caches, total);
+  mTrackedBytes = total;
+}
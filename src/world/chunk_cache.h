@@ -0,0 +1,56 @@
+#pragma once
+
+#include "SDL3/SDL_mutex.h"
+#include "light.h"
+#include "vertex.h"
+#include "voxel_grid.h"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Lets chunks with identical contents share one copy of their voxels, light and mesh. Lookups go through a content
+// hash and a full compare; the cache only holds weak references, so an entry goes away with the last chunk using it.
+// Safe to use from the scheduler's worker threads.
+class ChunkCache {
+public:
+  ChunkCache();
+  ~ChunkCache();
+
+  ChunkCache(const ChunkCache &) = delete;
+  ChunkCache &operator=(const ChunkCache &) = delete;
+
+  std::shared_ptr<const VoxelGrid> Intern(const VoxelGrid &grid);
+  std::shared_ptr<const LightVolume> Intern(LightVolume &&light);
+
+  // A mesh only depends on the voxels and the light of the chunk, so interned pointers identify it exactly
+  std::shared_ptr<const std::vector<Vertex>> FindMesh(const VoxelGrid *grid, const LightVolume *light);
+  // Returns the mesh another thread added in the meantime, if any
+  std::shared_ptr<const std::vector<Vertex>> AddMesh(const VoxelGrid *grid, const LightVolume *light,
+                                                     std::vector<Vertex> &&vertices);
+
+private:
+  struct MeshKey {
+    const VoxelGrid *grid;
+    const LightVolume *light;
+
+    bool operator==(const MeshKey &other) const = default;
+  };
+
+  struct MeshKeyHash {
+    size_t operator()(const MeshKey &key) const;
+  };
+
+  // Expired entries are swept after this many inserts
+  static const int PRUNE_INTERVAL = 256;
+
+  SDL_Mutex *mMutex;
+  std::unordered_multimap<u64, std::weak_ptr<const VoxelGrid>> mGrids;
+  std::unordered_multimap<u64, std::weak_ptr<const LightVolume>> mLights;
+  std::unordered_map<MeshKey, std::weak_ptr<const std::vector<Vertex>>, MeshKeyHash> mMeshes;
+  int mInserts;
+  // What the maps themselves take, reported to the memory tracker
+  size_t mTrackedBytes;
+
+  void Prune();
+  void Track();
+};
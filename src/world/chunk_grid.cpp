@@ -0,0 +1,47 @@
+#include "chunk_grid.h"
+#include <bit>
+
+ChunkGrid::ChunkGrid(int diameter)
+    : mDiameter(static_cast<int>(std::bit_ceil(static_cast<unsigned>(diameter)))), mMask(mDiameter - 1),
+      mSlots(mDiameter * mDiameter) {
+}
+
+Chunk *ChunkGrid::Neighbor(const Chunk &chunk, const glm::ivec3 &offset) const {
+  return Get(chunk.mPosition + offset);
+}
+
+std::shared_ptr<Chunk> ChunkGrid::Insert(std::shared_ptr<Chunk> chunk) {
+  auto &slot = mSlots[Index(chunk->mPosition)];
+  slot.position = chunk->mPosition;
+  std::swap(slot.chunk, chunk);
+  return chunk;
+}
+
+std::shared_ptr<Chunk> ChunkGrid::Remove(const glm::ivec3 &position) {
+  auto &slot = mSlots[Index(position)];
+  if (!slot.chunk || slot.position != position) {
+    return nullptr;
+  }
+
+  return std::move(slot.chunk);
+}
+
+void ChunkGrid::Clear() {
+  for (auto &slot : mSlots) {
+    slot.chunk.reset();
+  }
+}
+
+std::vector<std::shared_ptr<Chunk>> ChunkGrid::All() const {
+  std::vector<std::shared_ptr<Chunk>> chunks;
+  for (const auto &slot : mSlots) {
+    if (slot.chunk) {
+      chunks.push_back(slot.chunk);
+    }
+  }
+  return chunks;
+}
+
+int ChunkGrid::Diameter() const {
+  return mDiameter;
+}
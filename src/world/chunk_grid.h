@@ -0,0 +1,57 @@
+#pragma once
+
+#include "chunk.h"
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+// Fixed size ring-buffer of chunks around the player. A chunk at (x, z) always lives in slot (x mod diameter,
+// z mod diameter), so as long as every loaded chunk fits in a diameter x diameter window, lookups are a single index
+// and moving the window only overwrites the slots that fell off the far edge.
+class ChunkGrid {
+public:
+  // The diameter is rounded up to a power of two, so the slot is found with a mask instead of a division
+  ChunkGrid(int diameter);
+
+  // Called for every position of the load square each update, so it stays inline and never touches the chunk
+  Chunk *Get(const glm::ivec3 &position) const {
+    const auto &slot = mSlots[Index(position)];
+    return slot.chunk && slot.position == position ? slot.chunk.get() : nullptr;
+  }
+  Chunk *Neighbor(const Chunk &chunk, const glm::ivec3 &offset) const;
+
+  // Stores the chunk in its slot and hands back whatever was there before
+  std::shared_ptr<Chunk> Insert(std::shared_ptr<Chunk> chunk);
+  std::shared_ptr<Chunk> Remove(const glm::ivec3 &position);
+  void Clear();
+
+  // Slots are visited in memory order, empty slots are skipped
+  template <typename F> void ForEach(F &&callback) const {
+    for (auto &slot : mSlots) {
+      if (slot.chunk) {
+        callback(*slot.chunk);
+      }
+    }
+  }
+
+  // Every loaded chunk, holding a reference keeps a chunk alive after it has been evicted
+  std::vector<std::shared_ptr<Chunk>> All() const;
+
+  int Diameter() const;
+
+private:
+  // The position is kept next to the chunk, a lookup doesn't have to load the chunk to check it
+  struct Slot {
+    glm::ivec3 position;
+    std::shared_ptr<Chunk> chunk;
+  };
+
+  int mDiameter;
+  int mMask;
+  std::vector<Slot> mSlots;
+
+  // The mask wraps negative coordinates too, unlike the C++ % which keeps the sign of the dividend
+  int Index(const glm::ivec3 &position) const {
+    return (position.z & mMask) * mDiameter + (position.x & mMask);
+  }
+};
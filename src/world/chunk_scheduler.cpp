@@ -0,0 +1,148 @@
+#include "chunk_scheduler.h"
+#include <algorithm>
+
+// How many chunks of distance a chunk straight ahead is worth compared to one right behind the player
+static const float VIEW_BIAS = 2.0f;
+
+bool ChunkScheduler::Job::operator<(const Job &other) const {
+  // std::push_heap keeps the largest element on top, we want the lowest priority value there
+  return priority > other.priority;
+}
+
+ChunkScheduler::ChunkScheduler(int workerCount, StreamingBuffer *streaming)
+    : mStreaming(streaming), mQuit(false), mActive(0), mEye(0.0f), mDirection(0.0f, 0.0f, -1.0f) {
+  mMutex = SDL_CreateMutex();
+  mCondition = SDL_CreateCondition();
+
+  for (int i = 0; i < workerCount; ++i) {
+    mWorkers.push_back(SDL_CreateThread(WorkerMain, "ChunkWorker", this));
+  }
+}
+
+ChunkScheduler::~ChunkScheduler() {
+  SDL_LockMutex(mMutex);
+  mQuit = true;
+  SDL_BroadcastCondition(mCondition);
+  SDL_UnlockMutex(mMutex);
+
+  for (auto *worker : mWorkers) {
+    SDL_WaitThread(worker, nullptr);
+  }
+
+  SDL_DestroyCondition(mCondition);
+  SDL_DestroyMutex(mMutex);
+}
+
+float ChunkScheduler::Priority(const Chunk &chunk) const {
+  glm::vec3 center = (glm::vec3(chunk.mPosition) + 0.5f) * static_cast<float>(VoxelGrid::SIZE);
+  glm::vec3 toChunk = center - mEye;
+  toChunk.y = 0.0f;
+
+  float distance = glm::length(toChunk) / VoxelGrid::SIZE;
+  if (distance < 0.001f) {
+    return 0.0f;
+  }
+
+  glm::vec3 direction{mDirection.x, 0.0f, mDirection.z};
+  if (glm::length(direction) < 0.001f) {
+    return distance;
+  }
+
+  float facing = glm::dot(glm::normalize(toChunk), glm::normalize(direction));
+  return distance - VIEW_BIAS * facing;
+}
+
+void ChunkScheduler::Enqueue(std::shared_ptr<Chunk> chunk) {
+  SDL_LockMutex(mMutex);
+  float priority = Priority(*chunk);
+  mPending.push_back({std::move(chunk), priority});
+  std::push_heap(mPending.begin(), mPending.end());
+  SDL_SignalCondition(mCondition);
+  SDL_UnlockMutex(mMutex);
+}
+
+void ChunkScheduler::Reprioritize(const glm::vec3 &eye, const glm::vec3 &direction) {
+  SDL_LockMutex(mMutex);
+  mEye = eye;
+  mDirection = direction;
+
+  for (auto &job : mPending) {
+    job.priority = Priority(*job.chunk);
+  }
+  std::make_heap(mPending.begin(), mPending.end());
+  SDL_UnlockMutex(mMutex);
+}
+
+std::vector<std::shared_ptr<Chunk>> ChunkScheduler::CollectFinished() {
+  std::vector<std::shared_ptr<Chunk>> finished;
+  SDL_LockMutex(mMutex);
+  finished.swap(mFinished);
+  SDL_UnlockMutex(mMutex);
+  return finished;
+}
+
+size_t ChunkScheduler::PendingCount() {
+  SDL_LockMutex(mMutex);
+  size_t count = mPending.size();
+  SDL_UnlockMutex(mMutex);
+  return count;
+}
+
+bool ChunkScheduler::Idle() {
+  SDL_LockMutex(mMutex);
+  bool idle = mPending.empty() && mActive == 0 && mFinished.empty();
+  SDL_UnlockMutex(mMutex);
+  return idle;
+}
+
+ChunkScheduler::Stats ChunkScheduler::TakeStats() {
+  SDL_LockMutex(mMutex);
+  Stats stats = mStats;
+  mStats = {};
+  SDL_UnlockMutex(mMutex);
+  return stats;
+}
+
+int ChunkScheduler::WorkerMain(void *data) {
+  static_cast<ChunkScheduler *>(data)->Work();
+  return 0;
+}
+
+void ChunkScheduler::Work() {
+  while (true) {
+    SDL_LockMutex(mMutex);
+    while (mPending.empty() && !mQuit) {
+      SDL_WaitCondition(mCondition, mMutex);
+    }
+
+    if (mQuit) {
+      SDL_UnlockMutex(mMutex);
+      return;
+    }
+
+    std::pop_heap(mPending.begin(), mPending.end());
+    auto chunk = std::move(mPending.back().chunk);
+    mPending.pop_back();
+    mActive++;
+    SDL_UnlockMutex(mMutex);
+
+    // Chunks that left the load radius while queued are handed straight back, GenerateVertices also checks the flag
+    // so a job that is already running bails out early
+    float ms = -1.0f;
+    if (!chunk->mCancelled) {
+      auto start = SDL_GetPerformanceCounter();
+      chunk->GenerateVertices(mStreaming);
+      ms = static_cast<float>(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency() * 1000.0f;
+    }
+
+    SDL_LockMutex(mMutex);
+    if (ms >= 0.0f) {
+      mStats.chunks++;
+      mStats.totalMs += ms;
+      mStats.maxMs = std::max(mStats.maxMs, ms);
+    }
+    mFinished.push_back(std::move(chunk));
+    mActive--;
+    SDL_UnlockMutex(mMutex);
+  }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "chunk.h"
+#include "core/streaming_buffer.h"
+#include <SDL3/SDL.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+// Runs chunk generation on a fixed pool of worker threads. Pending jobs are kept in a heap ordered by distance to the
+// player and by how close they are to the view direction, so the chunks in front of the camera are built first.
+class ChunkScheduler {
+public:
+  // Chunks the workers generated, cancelled ones that were skipped don't count
+  struct Stats {
+    int chunks = 0;
+    float totalMs = 0.0f;
+    float maxMs = 0.0f;
+  };
+
+  // Finished meshes are staged in the streaming buffer. Without one they stay on the CPU, e.g. in the scheduler
+  // benchmark which has no GL context.
+  ChunkScheduler(int workerCount, StreamingBuffer *streaming);
+  ~ChunkScheduler();
+
+  void Enqueue(std::shared_ptr<Chunk> chunk);
+
+  // Recomputes the priority of all pending jobs. Call it when the player moves to another chunk or turns around.
+  void Reprioritize(const glm::vec3 &eye, const glm::vec3 &direction);
+
+  // Returns the chunks the workers are done with, including cancelled ones which were skipped or aborted.
+  std::vector<std::shared_ptr<Chunk>> CollectFinished();
+
+  size_t PendingCount();
+  // True when nothing is queued, being generated or waiting to be collected
+  bool Idle();
+  // Summed since the last call
+  Stats TakeStats();
+
+private:
+  struct Job {
+    std::shared_ptr<Chunk> chunk;
+    float priority;
+
+    bool operator<(const Job &other) const;
+  };
+
+  StreamingBuffer *mStreaming;
+  std::vector<SDL_Thread *> mWorkers;
+  SDL_Mutex *mMutex;
+  SDL_Condition *mCondition;
+  bool mQuit;
+  int mActive;
+
+  std::vector<Job> mPending;
+  std::vector<std::shared_ptr<Chunk>> mFinished;
+  Stats mStats;
+  glm::vec3 mEye, mDirection;
+
+  float Priority(const Chunk &chunk) const;
+
+  static int WorkerMain(void *data);
+  void Work();
+};
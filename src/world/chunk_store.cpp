@@ -0,0 +1,506 @@
+#include "chunk_store.h"
+#include "SDL3/SDL_log.h"
+#include "core/memory_tracker.h"
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char STORAGE_MAGIC[4] = {'V', 'X', 'S', 'T'};
+static const char JOURNAL_MAGIC[4] = {'V', 'X', 'J', 'N'};
+static const char RECORD_MAGIC[4] = {'V', 'X', 'C', 'K'};
+// Version 2 added baked meshes, version 1 records read the same
+static const uint32_t VERSION = 2;
+static const std::streamoff HEADER_SIZE = sizeof(STORAGE_MAGIC) + sizeof(VERSION);
+
+template <typename T> static void AppendValue(std::string &record, const T &value) {
+  record.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T> static bool ReadValue(std::istream &in, T &value) {
+  return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+// Puts the file's data on the disk. Flushing the stream only hands it to the OS, which loses it if the machine goes
+// down before writing it back.
+static bool SyncFile(const std::string &path) {
+#ifdef _WIN32
+  int fd = _open(path.c_str(), _O_WRONLY | _O_BINARY);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = _commit(fd) == 0;
+  _close(fd);
+#else
+  int fd = open(path.c_str(), O_WRONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = fsync(fd) == 0;
+  close(fd);
+#endif
+  return ok;
+}
+
+// Makes files created or renamed in the directory survive a crash, NTFS journals its metadata by itself
+static void SyncDirectory(const std::string &path) {
+#ifndef _WIN32
+  int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+#endif
+}
+
+// FNV-1a over everything after the record magic
+static u64 Checksum(const char *data, size_t size) {
+  u64 hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+  }
+
+  return hash;
+}
+
+// magic, x, y, z, content, payload size, payload, checksum. The payload is the grid of a mixed chunk, followed by the
+// face counts and faces of a baked mesh.
+static std::string EncodeRecord(const glm::ivec3 &position, const ChunkStore::SavedChunk &chunk) {
+  uint32_t gridSize = chunk.content == ChunkContent::Mixed ? sizeof(VoxelGrid) : 0;
+  uint32_t meshSize = chunk.mesh ? sizeof(chunk.mesh->counts) + chunk.mesh->faces.size() * sizeof(uint32_t) : 0;
+  uint32_t size = gridSize + meshSize;
+  std::string record;
+  record.reserve(sizeof(RECORD_MAGIC) + 5 * sizeof(uint32_t) + size + sizeof(u64));
+  record.append(RECORD_MAGIC, sizeof(RECORD_MAGIC));
+  AppendValue(record, position.x);
+  AppendValue(record, position.y);
+  AppendValue(record, position.z);
+  AppendValue(record, static_cast<uint32_t>(chunk.content));
+  AppendValue(record, size);
+  if (gridSize != 0) {
+    record.append(reinterpret_cast<const char *>(chunk.grid->columns), gridSize);
+  }
+  if (chunk.mesh) {
+    AppendValue(record, chunk.mesh->counts);
+    const auto &faces = chunk.mesh->faces;
+    record.append(reinterpret_cast<const char *>(faces.data()), faces.size() * sizeof(uint32_t));
+  }
+  AppendValue(record, Checksum(record.data() + sizeof(RECORD_MAGIC), record.size() - sizeof(RECORD_MAGIC)));
+  return record;
+}
+
+// Reads the record at the stream position, false if it is cut short or damaged
+static bool DecodeRecord(std::istream &in, glm::ivec3 &position, ChunkStore::SavedChunk &chunk) {
+  std::string record(sizeof(RECORD_MAGIC) + 5 * sizeof(uint32_t), '\0');
+  if (!in.read(record.data(), record.size()) || std::memcmp(record.data(), RECORD_MAGIC, sizeof(RECORD_MAGIC)) != 0) {
+    return false;
+  }
+
+  uint32_t content, size;
+  std::memcpy(&position.x, record.data() + 4, sizeof(int));
+  std::memcpy(&position.y, record.data() + 8, sizeof(int));
+  std::memcpy(&position.z, record.data() + 12, sizeof(int));
+  std::memcpy(&content, record.data() + 16, sizeof(uint32_t));
+  std::memcpy(&size, record.data() + 20, sizeof(uint32_t));
+  if (content > static_cast<uint32_t>(ChunkContent::Solid)) {
+    return false;
+  }
+  uint32_t gridSize = content == static_cast<uint32_t>(ChunkContent::Mixed) ? sizeof(VoxelGrid) : 0;
+  uint32_t meshSize = size - gridSize;
+  const uint32_t countsSize = sizeof(BakedMesh::counts);
+  if (size < gridSize || (meshSize != 0 && meshSize < countsSize)) {
+    return false;
+  }
+
+  size_t header = record.size();
+  record.resize(header + size);
+  u64 checksum;
+  if (!in.read(record.data() + header, size) || !ReadValue(in, checksum) ||
+      checksum != Checksum(record.data() + sizeof(RECORD_MAGIC), record.size() - sizeof(RECORD_MAGIC))) {
+    return false;
+  }
+
+  chunk.content = static_cast<ChunkContent>(content);
+  chunk.grid.reset();
+  if (gridSize != 0) {
+    auto *grid = new VoxelGrid;
+    std::memcpy(grid->columns, record.data() + header, gridSize);
+    chunk.grid = MakeTracked(MemoryTag::Scratch, sizeof(VoxelGrid), grid);
+  }
+  chunk.mesh.reset();
+  if (meshSize != 0) {
+    auto mesh = std::make_unique<BakedMesh>();
+    const char *payload = record.data() + header + gridSize;
+    std::memcpy(mesh->counts, payload, countsSize);
+    size_t faces = 0;
+    for (uint32_t count : mesh->counts) {
+      faces += count;
+    }
+    if (faces * sizeof(uint32_t) != meshSize - countsSize) {
+      return false;
+    }
+    mesh->faces.resize(faces);
+    std::memcpy(mesh->faces.data(), payload + countsSize, faces * sizeof(uint32_t));
+    chunk.mesh = MakeTracked(MemoryTag::Scratch, sizeof(BakedMesh) + meshSize, mesh.release());
+  }
+  return true;
+}
+
+static bool WriteHeader(std::ofstream &out, const char (&magic)[4]) {
+  out.write(magic, sizeof(magic));
+  out.write(reinterpret_cast<const char *>(&VERSION), sizeof(VERSION));
+  return static_cast<bool>(out.flush());
+}
+
+ChunkStore::ChunkStore(const std::string &directory)
+    : mDirectory(directory), mThread(nullptr), mMutex(SDL_CreateMutex()), mWake(SDL_CreateCondition()),
+      mIdle(SDL_CreateCondition()), mFileMutex(SDL_CreateMutex()), mJournalSize(0), mCompactRequested(false),
+      mCompacting(false), mQuit(false) {
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  if (error) {
+    SDL_Log("Failed to create chunk store directory %s: %s", directory.c_str(), error.message().c_str());
+  }
+  // Left over by a compaction that didn't finish, storage itself is still intact
+  std::filesystem::remove(StoragePath() + ".tmp", error);
+
+  Replay(StoragePath(), false);
+  std::streamoff end = Replay(JournalPath(), true);
+  auto size = static_cast<std::streamoff>(std::filesystem::file_size(JournalPath(), error));
+  if (!error && end < size) {
+    SDL_Log("Chunk store: dropped %lld bytes of an unfinished journal write", static_cast<long long>(size - end));
+    std::filesystem::resize_file(JournalPath(), end, error);
+  }
+
+  if (end == 0) {
+    OpenJournal(true);
+  } else {
+    OpenJournal(false);
+    mJournalSize = end;
+  }
+  OpenReaders();
+
+  // Whatever the last run left in the journal goes into storage first
+  mCompactRequested = mJournalSize > HEADER_SIZE;
+  SDL_Log("Chunk store %s: %zu chunks", directory.c_str(), mIndex.size());
+  mThread = SDL_CreateThread(Run, "ChunkStore", this);
+}
+
+ChunkStore::~ChunkStore() {
+  SDL_LockMutex(mMutex);
+  mQuit = true;
+  mCompactRequested = true;
+  SDL_SignalCondition(mWake);
+  SDL_UnlockMutex(mMutex);
+
+  SDL_WaitThread(mThread, nullptr);
+  SDL_DestroyCondition(mWake);
+  SDL_DestroyCondition(mIdle);
+  SDL_DestroyMutex(mMutex);
+  SDL_DestroyMutex(mFileMutex);
+}
+
+std::string ChunkStore::StoragePath() const {
+  return mDirectory + "/chunks.dat";
+}
+
+std::string ChunkStore::JournalPath() const {
+  return mDirectory + "/chunks.journal";
+}
+
+u64 ChunkStore::Key(const glm::ivec3 &position) {
+  const u64 mask = (static_cast<u64>(1) << 21) - 1;
+  return (static_cast<u64>(position.x) & mask) | ((static_cast<u64>(position.y) & mask) << 21) |
+         ((static_cast<u64>(position.z) & mask) << 42);
+}
+
+void ChunkStore::Save(const glm::ivec3 &position, ChunkContent content, std::shared_ptr<const VoxelGrid> grid) {
+  Save(position, {.content = content, .grid = std::move(grid)});
+}
+
+void ChunkStore::Save(const glm::ivec3 &position, SavedChunk chunk) {
+  SDL_LockMutex(mMutex);
+  mPending[Key(position)] = {position, std::move(chunk)};
+  mStats.queued++;
+  SDL_SignalCondition(mWake);
+  SDL_UnlockMutex(mMutex);
+}
+
+std::optional<ChunkStore::SavedChunk> ChunkStore::Load(const glm::ivec3 &position) {
+  u64 key = Key(position);
+  SDL_LockMutex(mMutex);
+  for (auto *queue : {&mPending, &mWriting}) {
+    auto it = queue->find(key);
+    if (it != queue->end()) {
+      SavedChunk chunk = it->second.chunk;
+      SDL_UnlockMutex(mMutex);
+      return chunk;
+    }
+  }
+  SDL_UnlockMutex(mMutex);
+
+  // The file lock comes first so a compaction can't move the record between the lookup and the read
+  SDL_LockMutex(mFileMutex);
+  SDL_LockMutex(mMutex);
+  auto it = mIndex.find(key);
+  std::optional<Location> location;
+  if (it != mIndex.end()) {
+    location = it->second;
+  }
+  SDL_UnlockMutex(mMutex);
+
+  std::optional<SavedChunk> chunk;
+  if (location) {
+    chunk = ReadRecord(location->journal, location->offset);
+  }
+  SDL_UnlockMutex(mFileMutex);
+  return chunk;
+}
+
+void ChunkStore::Flush() {
+  SDL_LockMutex(mMutex);
+  while (!mPending.empty() || !mWriting.empty()) {
+    SDL_WaitCondition(mIdle, mMutex);
+  }
+  SDL_UnlockMutex(mMutex);
+}
+
+void ChunkStore::Compact() {
+  SDL_LockMutex(mMutex);
+  mCompactRequested = true;
+  SDL_SignalCondition(mWake);
+  while (mCompactRequested || mCompacting) {
+    SDL_WaitCondition(mIdle, mMutex);
+  }
+  SDL_UnlockMutex(mMutex);
+}
+
+ChunkStore::Stats ChunkStore::GetStats() const {
+  SDL_LockMutex(mMutex);
+  Stats stats = mStats;
+  SDL_UnlockMutex(mMutex);
+  return stats;
+}
+
+size_t ChunkStore::Size() const {
+  SDL_LockMutex(mMutex);
+  size_t size = mIndex.size();
+  SDL_UnlockMutex(mMutex);
+  return size;
+}
+
+int ChunkStore::Run(void *data) {
+  static_cast<ChunkStore *>(data)->Loop();
+  return 0;
+}
+
+void ChunkStore::Loop() {
+  SDL_LockMutex(mMutex);
+  while (true) {
+    while (!mQuit && mPending.empty() && !mCompactRequested) {
+      SDL_WaitCondition(mWake, mMutex);
+    }
+
+    if (!mPending.empty()) {
+      mWriting.swap(mPending);
+      SDL_UnlockMutex(mMutex);
+      auto written = WriteBatch(mWriting);
+      SDL_LockMutex(mMutex);
+
+      for (auto &[key, location] : written) {
+        mIndex[key] = location;
+      }
+      mWriting.clear();
+      mCompactRequested = mCompactRequested || mJournalSize > static_cast<std::streamoff>(COMPACT_THRESHOLD);
+    }
+
+    if (mCompactRequested) {
+      mCompactRequested = false;
+      mCompacting = true;
+      SDL_UnlockMutex(mMutex);
+      MergeJournal();
+      SDL_LockMutex(mMutex);
+      mCompacting = false;
+    }
+
+    SDL_BroadcastCondition(mIdle);
+    if (mQuit && mPending.empty() && !mCompactRequested) {
+      break;
+    }
+  }
+  SDL_UnlockMutex(mMutex);
+}
+
+std::vector<std::pair<u64, ChunkStore::Location>>
+ChunkStore::WriteBatch(const std::unordered_map<u64, Pending> &batch) {
+  std::vector<std::pair<u64, Location>> written;
+  written.reserve(batch.size());
+  size_t bytes = 0;
+
+  // Serialized here rather than in Save(), so the caller only pays for the queue
+  SDL_LockMutex(mFileMutex);
+  for (auto &[key, pending] : batch) {
+    std::string record = EncodeRecord(pending.position, pending.chunk);
+    mJournal.write(record.data(), record.size());
+    written.emplace_back(key, Location{true, mJournalSize});
+    mJournalSize += record.size();
+    bytes += record.size();
+  }
+  // The records only count as written, and replace what storage has in the index, once they are on the disk
+  bool synced = mJournal.flush() && SyncFile(JournalPath());
+  SDL_UnlockMutex(mFileMutex);
+
+  if (!synced) {
+    SDL_Log("Failed to write %zu chunks to %s", batch.size(), JournalPath().c_str());
+    written.clear();
+    return written;
+  }
+
+  SDL_LockMutex(mMutex);
+  mStats.written += static_cast<int>(written.size());
+  mStats.bytesWritten += bytes;
+  SDL_UnlockMutex(mMutex);
+  return written;
+}
+
+void ChunkStore::MergeJournal() {
+  SDL_LockMutex(mFileMutex);
+  if (mJournalSize <= HEADER_SIZE) {
+    SDL_UnlockMutex(mFileMutex);
+    return;
+  }
+
+  // Only this thread changes the index, so the copy stays current
+  SDL_LockMutex(mMutex);
+  auto index = mIndex;
+  SDL_UnlockMutex(mMutex);
+
+  // The new storage is written next to the old one and renamed over it once it is complete
+  std::string path = StoragePath() + ".tmp";
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  bool ok = WriteHeader(out, STORAGE_MAGIC);
+  std::unordered_map<u64, Location> merged;
+  merged.reserve(index.size());
+  std::streamoff offset = HEADER_SIZE;
+  for (auto &[key, location] : index) {
+    auto &reader = location.journal ? mJournalReader : mStorageReader;
+    reader.clear();
+    reader.seekg(location.offset);
+    glm::ivec3 position;
+    SavedChunk chunk;
+    if (!DecodeRecord(reader, position, chunk)) {
+      SDL_Log("Chunk store: record at %lld of %s is unreadable, skipped", static_cast<long long>(location.offset),
+              location.journal ? JournalPath().c_str() : StoragePath().c_str());
+      continue;
+    }
+
+    std::string record = EncodeRecord(position, chunk);
+    out.write(record.data(), record.size());
+    merged[key] = {false, offset};
+    offset += record.size();
+  }
+  ok = ok && static_cast<bool>(out.flush());
+  out.close();
+  ok = ok && SyncFile(path);
+
+  std::error_code error;
+  if (ok) {
+    mStorageReader.close();
+    std::filesystem::rename(path, StoragePath(), error);
+  }
+  // Storage has to be on the disk under its name before the journal that still holds its records is emptied
+  if (ok && !error) {
+    SyncDirectory(mDirectory);
+  }
+  if (!ok || error) {
+    SDL_Log("Failed to compact chunk store %s: %s", mDirectory.c_str(), error ? error.message().c_str() : "write");
+    std::filesystem::remove(path, error);
+    OpenReaders();
+    SDL_UnlockMutex(mFileMutex);
+    return;
+  }
+
+  // A crash before the journal is emptied just replays records storage already has
+  OpenJournal(true);
+  OpenReaders();
+
+  SDL_LockMutex(mMutex);
+  mIndex = std::move(merged);
+  mStats.compactions++;
+  SDL_UnlockMutex(mMutex);
+  SDL_UnlockMutex(mFileMutex);
+}
+
+std::streamoff ChunkStore::Replay(const std::string &path, bool journal) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[4];
+  uint32_t version;
+  if (!in || !ReadValue(in, magic) || std::memcmp(magic, journal ? JOURNAL_MAGIC : STORAGE_MAGIC, sizeof(magic)) != 0 ||
+      !ReadValue(in, version) || version == 0 || version > VERSION) {
+    return 0;
+  }
+
+  std::streamoff end = HEADER_SIZE;
+  int records = 0;
+  glm::ivec3 position;
+  SavedChunk chunk;
+  while (DecodeRecord(in, position, chunk)) {
+    // Later records of a chunk replace earlier ones, and the journal is replayed after storage
+    mIndex[Key(position)] = {journal, end};
+    end = in.tellg();
+    records++;
+  }
+
+  if (journal && records > 0) {
+    SDL_Log("Chunk store: recovered %d journal records", records);
+  }
+  return end;
+}
+
+std::optional<ChunkStore::SavedChunk> ChunkStore::ReadRecord(bool journal, std::streamoff offset) {
+  auto &reader = journal ? mJournalReader : mStorageReader;
+  reader.clear();
+  reader.seekg(offset);
+  glm::ivec3 position;
+  SavedChunk chunk;
+  if (!DecodeRecord(reader, position, chunk)) {
+    SDL_Log("Chunk store: record at %lld of %s is unreadable", static_cast<long long>(offset),
+            journal ? JournalPath().c_str() : StoragePath().c_str());
+    return std::nullopt;
+  }
+
+  return chunk;
+}
+
+bool ChunkStore::OpenJournal(bool truncate) {
+  mJournal.close();
+  mJournal.clear();
+  mJournal.open(JournalPath(), std::ios::binary | (truncate ? std::ios::trunc : std::ios::app));
+  if (truncate) {
+    WriteHeader(mJournal, JOURNAL_MAGIC);
+    mJournalSize = HEADER_SIZE;
+    SyncFile(JournalPath());
+    SyncDirectory(mDirectory);
+  }
+  if (!mJournal) {
+    SDL_Log("Failed to open chunk journal %s", JournalPath().c_str());
+    return false;
+  }
+
+  return true;
+}
+
+void ChunkStore::OpenReaders() {
+  mStorageReader.close();
+  mStorageReader.clear();
+  mStorageReader.open(StoragePath(), std::ios::binary);
+  mJournalReader.close();
+  mJournalReader.clear();
+  mJournalReader.open(JournalPath(), std::ios::binary);
+}
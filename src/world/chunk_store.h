@@ -0,0 +1,118 @@
+#pragma once
+
+#include "SDL3/SDL_mutex.h"
+#include "SDL3/SDL_thread.h"
+#include "chunk.h"
+#include "voxel_grid.h"
+#include <fstream>
+#include <glm/glm.hpp>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Chunks the player changed, saved to disk without stalling the caller. Save() only queues the chunk, a background
+// thread appends it to a journal and now and then merges the journal into the main storage file.
+//
+// Every record carries a checksum. When the store is opened the journal is replayed up to the first record which is
+// cut short or doesn't match its checksum, anything after it is what was being written when the process died.
+// Storage is only ever replaced by renaming a complete file over it, so it is never torn.
+//
+// A batch of records counts as written once the journal was synced to the disk, so chunks the stats report as written
+// survive the machine going down as well, not just the process.
+class ChunkStore {
+public:
+  struct SavedChunk {
+    ChunkContent content;
+    // Only set for mixed chunks
+    std::shared_ptr<const VoxelGrid> grid;
+    // Set by the pregeneration tool, the game expands it instead of meshing the chunk. Saving a chunk again drops it.
+    std::shared_ptr<const BakedMesh> mesh;
+  };
+
+  struct Stats {
+    // Chunks queued by Save(), a chunk saved again before it was written counts once per call
+    int queued = 0;
+    int written = 0;
+    size_t bytesWritten = 0;
+    int compactions = 0;
+  };
+
+  // Creates the directory if needed and recovers whatever the journal of an earlier run holds
+  explicit ChunkStore(const std::string &directory);
+  // Writes everything still queued and merges the journal into storage
+  ~ChunkStore();
+
+  ChunkStore(const ChunkStore &) = delete;
+  ChunkStore &operator=(const ChunkStore &) = delete;
+
+  // Safe to call from any thread, the newest save of a chunk wins
+  void Save(const glm::ivec3 &position, ChunkContent content, std::shared_ptr<const VoxelGrid> grid);
+  void Save(const glm::ivec3 &position, SavedChunk chunk);
+  // The last saved contents of the chunk, including saves that haven't reached the disk yet. Safe to call from any
+  // thread; blocks while the journal is being compacted.
+  std::optional<SavedChunk> Load(const glm::ivec3 &position);
+  // Waits until nothing is queued anymore, everything saved before the call is then in the journal
+  void Flush();
+  // Waits for the I/O thread to merge the journal into storage
+  void Compact();
+
+  Stats GetStats() const;
+  // Chunks on disk, queued saves not included
+  size_t Size() const;
+
+  std::string StoragePath() const;
+  std::string JournalPath() const;
+
+private:
+  // Where the newest record of a chunk is
+  struct Location {
+    bool journal;
+    std::streamoff offset;
+  };
+
+  struct Pending {
+    glm::ivec3 position;
+    SavedChunk chunk;
+  };
+
+  // The journal is merged into storage once it grows past this
+  static const size_t COMPACT_THRESHOLD = 64 * 1024 * 1024;
+
+  std::string mDirectory;
+  SDL_Thread *mThread;
+  // Guards everything below except the files
+  SDL_Mutex *mMutex;
+  SDL_Condition *mWake;
+  SDL_Condition *mIdle;
+  // Held while a file is read, written or replaced
+  SDL_Mutex *mFileMutex;
+  std::ofstream mJournal;
+  std::ifstream mStorageReader;
+  std::ifstream mJournalReader;
+
+  // Keyed like the index. Saves move to mWriting while the thread writes them, so Load() never misses one.
+  std::unordered_map<u64, Pending> mPending;
+  std::unordered_map<u64, Pending> mWriting;
+  std::unordered_map<u64, Location> mIndex;
+  // Only touched by the I/O thread once it runs
+  std::streamoff mJournalSize;
+  bool mCompactRequested;
+  bool mCompacting;
+  bool mQuit;
+  Stats mStats;
+
+  static u64 Key(const glm::ivec3 &position);
+  static int Run(void *data);
+  void Loop();
+  // Appends the batch to the journal, returns where each chunk ended up
+  std::vector<std::pair<u64, Location>> WriteBatch(const std::unordered_map<u64, Pending> &batch);
+  void MergeJournal();
+  // Indexes the records of a file, returns the offset after the last intact one
+  std::streamoff Replay(const std::string &path, bool journal);
+  std::optional<SavedChunk> ReadRecord(bool journal, std::streamoff offset);
+  bool OpenJournal(bool truncate);
+  void OpenReaders();
+};
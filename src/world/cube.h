@@ -1,5 +1,7 @@
 #pragma once
 
+#include <glm/glm.hpp>
+
 enum class CubeFace {
   Front,
   Back,
@@ -8,3 +10,52 @@ enum class CubeFace {
   Top,
   Bottom
 };
+
+const int CUBE_FACES = 6;
+// Bit i is set for CubeFace i
+const unsigned ALL_FACES = (1u << CUBE_FACES) - 1;
+
+// The neighbour a face looks at, its light is the light the face receives
+inline glm::ivec3 FaceDirection(CubeFace face) {
+  switch (face) {
+    case CubeFace::Front:
+      return {0, 0, 1};
+    case CubeFace::Back:
+      return {0, 0, -1};
+    case CubeFace::Left:
+      return {-1, 0, 0};
+    case CubeFace::Right:
+      return {1, 0, 0};
+    case CubeFace::Top:
+      return {0, 1, 0};
+    case CubeFace::Bottom:
+      return {0, -1, 0};
+  }
+
+  return {0, 0, 0};
+}
+
+// The corners of each face's quad in order around it. A corner has bit 0 set on the +x side of the voxel, bit 1 on the
+// top and bit 2 on the front (+z). The texture corners go bottom left, bottom right, top right, top left in the same
+// order. Mirrored by mesh.comp.
+const int FACE_CORNERS[CUBE_FACES][4] = {{4, 5, 7, 6}, {1, 0, 2, 3}, {0, 4, 6, 2},
+                                         {5, 1, 3, 7}, {6, 7, 3, 2}, {5, 4, 0, 1}};
+
+// Offset of a corner from the center of its voxel, each component is -1 or 1
+inline glm::ivec3 CornerSide(int corner) {
+  return {corner & 1 ? 1 : -1, corner & 2 ? 1 : -1, corner & 4 ? 1 : -1};
+}
+
+// The face directions of a mesh within [min, max] which can face the eye. A face is only seen from in front of its
+// plane, so when the eye is behind the bounds in one direction, every face of that direction faces away from it.
+// Mirrored by cull.comp.
+inline unsigned FacesTowards(const glm::vec3 &eye, const glm::vec3 &min, const glm::vec3 &max) {
+  unsigned faces = 0;
+  faces |= eye.z > min.z ? 1u << static_cast<int>(CubeFace::Front) : 0;
+  faces |= eye.z < max.z ? 1u << static_cast<int>(CubeFace::Back) : 0;
+  faces |= eye.x < max.x ? 1u << static_cast<int>(CubeFace::Left) : 0;
+  faces |= eye.x > min.x ? 1u << static_cast<int>(CubeFace::Right) : 0;
+  faces |= eye.y > min.y ? 1u << static_cast<int>(CubeFace::Top) : 0;
+  faces |= eye.y < max.y ? 1u << static_cast<int>(CubeFace::Bottom) : 0;
+  return faces;
+}
@@ -0,0 +1,61 @@
+#include "flight_benchmark.h"
+#include "SDL3/SDL_log.h"
+#include "SDL3/SDL_timer.h"
+#include "core/benchmark.h"
+#include <algorithm>
+
+FlightBenchmark::FlightBenchmark(const glm::vec3 &start, const glm::vec3 &direction, float speed, int frames,
+                                 int tickRate)
+    : mStart(start), mDirection(glm::normalize(direction)), mSpeed(speed), mFrames(frames), mFrame(0),
+      mPeriod(SDL_GetPerformanceFrequency() / tickRate), mNextTick(0) {
+  mCoverage.reserve(frames);
+}
+
+glm::vec3 FlightBenchmark::Step() {
+  auto now = SDL_GetPerformanceCounter();
+  if (mNextTick == 0) {
+    mNextTick = now;
+  }
+  if (now < mNextTick) {
+    SDL_DelayNS((mNextTick - now) * 1000000000ull / SDL_GetPerformanceFrequency());
+  }
+  mNextTick += mPeriod;
+
+  return mStart + mDirection * (mSpeed * mFrame);
+}
+
+void FlightBenchmark::Record(const World::ViewCoverage &coverage) {
+  mCoverage.push_back(coverage);
+  mFrame++;
+}
+
+bool FlightBenchmark::Done() const {
+  return mFrame >= mFrames;
+}
+
+bool FlightBenchmark::Write(const std::string &path, const World::PrefetchStats &prefetch) const {
+  BenchmarkCsv out(path);
+  if (!out.Ok()) {
+    return false;
+  }
+
+  int framesWithHoles = 0;
+  float totalMissing = 0.0f, maxMissing = 0.0f;
+  out.Table("frame,distance,in_view,missing,missing_percent");
+  for (size_t i = 0; i < mCoverage.size(); ++i) {
+    const auto &coverage = mCoverage[i];
+    float missing = coverage.inView > 0 ? 100.0f * coverage.missing / coverage.inView : 0.0f;
+    out.Row(i, mSpeed * i, coverage.inView, coverage.missing, missing);
+    framesWithHoles += coverage.missing > 0;
+    totalMissing += missing;
+    maxMissing = std::max(maxMissing, missing);
+  }
+
+  int resolved = prefetch.used + prefetch.discarded;
+  float hitRate = resolved > 0 ? 100.0f * prefetch.used / resolved : 0.0f;
+  SDL_Log("Flight at %.2f voxels per tick: %d of %zu frames with missing chunks in view, avg %.2f%%, max %.2f%%; "
+          "prefetch %d issued, %d used, %d discarded, hit rate %.1f%%",
+          mSpeed, framesWithHoles, mCoverage.size(), totalMissing / std::max<size_t>(mCoverage.size(), 1), maxMissing,
+          prefetch.issued, prefetch.used, prefetch.discarded, hitRate);
+  return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "world.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Flies the camera in a straight line at a fixed speed, one tick per frame and frames paced to the tick rate like the
+// simulation, and records for every frame how many of the chunks in view had nothing to draw yet
+class FlightBenchmark {
+public:
+  // speed is in voxels per tick
+  FlightBenchmark(const glm::vec3 &start, const glm::vec3 &direction, float speed, int frames, int tickRate);
+
+  // Waits until the next tick is due and returns where the camera is then
+  glm::vec3 Step();
+  void Record(const World::ViewCoverage &coverage);
+  bool Done() const;
+
+  bool Write(const std::string &path, const World::PrefetchStats &prefetch) const;
+
+private:
+  glm::vec3 mStart, mDirection;
+  float mSpeed;
+  int mFrames;
+  int mFrame;
+  unsigned long mPeriod;
+  unsigned long mNextTick;
+  std::vector<World::ViewCoverage> mCoverage;
+};
@@ -0,0 +1,169 @@
+#include "gpu_mesh_benchmark.h"
+#include "SDL3/SDL_log.h"
+#include "chunk.h"
+#include "chunk_store.h"
+#include "core/benchmark.h"
+#include "gpu_mesher.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+// Chunks per side of the patch
+const int CHUNKS = 8;
+// The meshes are written this many vertices into the buffer, so the shader's unaligned start is covered too
+const size_t FIRST = 1;
+
+bool Close(float a, float b) {
+  return std::abs(a - b) <= 1e-6f;
+}
+
+// Texture coordinates are computed differently on both sides, everything else is exact
+bool SameVertex(const Vertex &a, const Vertex &b) {
+  return a.position == b.position && a.normal == b.normal && a.light == b.light && a.occlusion == b.occlusion &&
+         Close(a.textureCoords.x, b.textureCoords.x) && Close(a.textureCoords.y, b.textureCoords.y);
+}
+
+// The GPU mesher doesn't keep the order of the faces within a direction, every voxel has at most one face in it
+void SortFaces(Vertex *vertices, size_t count) {
+  std::vector<std::vector<Vertex>> faces;
+  for (size_t i = 0; i < count; i += 6) {
+    faces.emplace_back(vertices + i, vertices + i + 6);
+  }
+  std::sort(faces.begin(), faces.end(), [](const auto &a, const auto &b) {
+    return std::tie(a[0].position.x, a[0].position.y, a[0].position.z) <
+           std::tie(b[0].position.x, b[0].position.y, b[0].position.z);
+  });
+  for (size_t i = 0; i < faces.size(); ++i) {
+    std::copy(faces[i].begin(), faces[i].end(), vertices + i * 6);
+  }
+}
+
+// Empty if both meshes are the same
+std::string Compare(const Chunk &cpu, const Chunk &gpu, std::vector<Vertex> &meshed) {
+  for (int i = 0; i < CUBE_FACES; ++i) {
+    if (cpu.mFaceCounts[i] != gpu.mFaceCounts[i]) {
+      return "vertex count of direction " + std::to_string(i);
+    }
+  }
+  if (cpu.mBoundsMin != gpu.mBoundsMin || cpu.mBoundsMax != gpu.mBoundsMax) {
+    return "bounds";
+  }
+
+  std::vector<Vertex> expected = *cpu.mVertices;
+  size_t first = 0;
+  for (int i = 0; i < CUBE_FACES; ++i) {
+    SortFaces(expected.data() + first, cpu.mFaceCounts[i]);
+    SortFaces(meshed.data() + first, cpu.mFaceCounts[i]);
+    first += cpu.mFaceCounts[i];
+  }
+  for (size_t i = 0; i < expected.size(); ++i) {
+    if (!SameVertex(expected[i], meshed[i])) {
+      return "vertex " + std::to_string(i);
+    }
+  }
+  return "";
+}
+
+struct Result {
+  const char *mode;
+  int chunks = 0;
+  size_t vertices = 0;
+  float workerMs = 0.0f;
+  float gpuMs = 0.0f;
+  size_t uploadBytes = 0;
+};
+
+} // namespace
+
+bool RunGpuMeshBenchmark(int seed, const std::string &path, std::unique_ptr<Shader> shader, const TextureAtlas &atlas) {
+  std::string directory = path + ".store";
+  std::error_code error;
+  std::filesystem::remove_all(directory, error);
+
+  GpuMesher mesher(std::move(shader), atlas);
+  Result cpu{.mode = "cpu"}, gpu{.mode = "gpu"};
+  int mismatches = 0;
+  {
+    // Separate caches, so the CPU meshes aren't found for the GPU chunks and the other way round
+    ChunkCache cpuCache, gpuCache;
+    ChunkStore store(directory);
+    for (int cx = 0; cx < CHUNKS; ++cx) {
+      for (int cz = 0; cz < CHUNKS; ++cz) {
+        Chunk cpuChunk(atlas, cpuCache, nullptr, store, {cx, 0, cz}, seed);
+        auto start = SDL_GetPerformanceCounter();
+        cpuChunk.GenerateVertices();
+        float cpuMs = ElapsedMs(start);
+
+        Chunk gpuChunk(atlas, gpuCache, nullptr, store, {cx, 0, cz}, seed);
+        gpuChunk.mGpuMeshing = true;
+        start = SDL_GetPerformanceCounter();
+        gpuChunk.GenerateVertices();
+        float gpuMs = ElapsedMs(start);
+        if (gpuChunk.mMeshInput.empty()) {
+          continue;
+        }
+
+        size_t vertices = gpuChunk.VertexCount();
+        size_t bytes = vertices * sizeof(Vertex);
+        GLuint buffer;
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, (FIRST + vertices) * sizeof(Vertex), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        // Faces the shader doesn't write stay zero and fail the comparison
+        glClearNamedBufferData(buffer, GL_R32F, GL_RED, GL_FLOAT, nullptr);
+        // Drivers may run the dispatch whenever they like, so the GPU time is measured up to glFinish()
+        glFinish();
+        start = SDL_GetPerformanceCounter();
+        glNamedBufferSubData(mesher.InputBuffer(), 0, gpuChunk.mMeshInput.size() * sizeof(uint32_t),
+                             gpuChunk.mMeshInput.data());
+        mesher.Mesh(buffer, FIRST, gpuChunk.mFaceCounts);
+        glFinish();
+        float meshMs = ElapsedMs(start);
+
+        std::vector<Vertex> meshed(vertices);
+        glGetNamedBufferSubData(buffer, FIRST * sizeof(Vertex), bytes, meshed.data());
+        glDeleteBuffers(1, &buffer);
+
+        std::string mismatch = cpuChunk.mVertices ? Compare(cpuChunk, gpuChunk, meshed) : "no CPU mesh";
+        if (!mismatch.empty()) {
+          if (mismatches < 10) {
+            SDL_Log("GPU mesh of chunk (%d, %d) differs: %s", cx, cz, mismatch.c_str());
+          }
+          mismatches++;
+        }
+
+        cpu.chunks++;
+        cpu.vertices += vertices;
+        cpu.workerMs += cpuMs;
+        cpu.uploadBytes += bytes;
+        gpu.chunks++;
+        gpu.vertices += vertices;
+        gpu.workerMs += gpuMs;
+        gpu.gpuMs += meshMs;
+        gpu.uploadBytes += GpuMesher::INPUT_BYTES;
+      }
+    }
+  }
+  std::filesystem::remove_all(directory, error);
+  SDL_Log("GPU mesh verification: %d mixed chunks, %d differ from the CPU mesher", gpu.chunks, mismatches);
+
+  BenchmarkCsv out(path);
+  if (!out.Ok()) {
+    return false;
+  }
+
+  out.Table("mode,chunks,vertices,worker_ms_per_chunk,gpu_ms_per_chunk,upload_bytes_per_chunk");
+  for (const auto &result : {cpu, gpu}) {
+    int chunks = std::max(result.chunks, 1);
+    out.Row(result.mode, result.chunks, result.vertices, result.workerMs / chunks, result.gpuMs / chunks,
+            result.uploadBytes / chunks);
+    SDL_Log("Meshing on the %s: %.3f ms per chunk on the worker, %.3f ms on the GPU, %zu bytes uploaded per chunk",
+            result.mode, result.workerMs / chunks, result.gpuMs / chunks, result.uploadBytes / chunks);
+  }
+
+  return mismatches == 0 && gpu.chunks > 0;
+}
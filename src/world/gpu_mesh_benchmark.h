@@ -0,0 +1,11 @@
+#pragma once
+
+#include "core/shader.h"
+#include "texture_atlas.h"
+#include <memory>
+#include <string>
+
+// Generates a patch of terrain chunks twice, once meshed on the CPU and once prepared for the GPU mesher, and compares
+// the faces mesh.comp writes with the CPU mesher's, direction by direction. Reports the worker time per chunk of both
+// paths, the time the GPU takes to mesh a chunk and the bytes each path uploads. Needs a GL context but no window.
+bool RunGpuMeshBenchmark(int seed, const std::string &path, std::unique_ptr<Shader> shader, const TextureAtlas &atlas);
@@ -0,0 +1,151 @@
+#include "gpu_mesher.h"
+#include "SDL3/SDL_log.h"
+#include "core/gpu_profiler.h"
+#include "core/memory_tracker.h"
+#include "vertex.h"
+#include <algorithm>
+#include <bit>
+#include <string>
+
+namespace {
+
+const int SIZE = VoxelGrid::SIZE;
+// Columns and light are stored for x and z from -1 to SIZE
+const int STRIDE = SIZE + 2;
+
+static_assert(sizeof(Vertex) == 9 * sizeof(uint32_t), "mesh.comp writes vertices as WORDS 32 bit words");
+
+} // namespace
+
+GpuMesher::GpuMesher(std::unique_ptr<Shader> shader, const TextureAtlas &atlas)
+    : mShader(std::move(shader)), mTexture(*atlas.GetTexture(TextureType::Dirt)), mAlignment(1) {
+  glCreateBuffers(1, &mInput);
+  glNamedBufferStorage(mInput, INPUT_BYTES, nullptr, GL_DYNAMIC_STORAGE_BIT);
+  glCreateBuffers(1, &mCounters);
+  glNamedBufferStorage(mCounters, CUBE_FACES * sizeof(uint32_t), nullptr, GL_DYNAMIC_STORAGE_BIT);
+  MemoryTracker::RegisterBuffer(mInput, GpuTag::Meshing, INPUT_BYTES);
+  MemoryTracker::RegisterBuffer(mCounters, GpuTag::Meshing, CUBE_FACES * sizeof(uint32_t));
+  glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &mAlignment);
+}
+
+GpuMesher::~GpuMesher() {
+  MemoryTracker::ReleaseBuffer(mInput);
+  MemoryTracker::ReleaseBuffer(mCounters);
+  glDeleteBuffers(1, &mInput);
+  glDeleteBuffers(1, &mCounters);
+}
+
+std::vector<uint32_t> GpuMesher::Prepare(const VoxelGrid &grid, const LightVolume &light,
+                                         uint32_t (&counts)[CUBE_FACES], glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+  std::vector<uint32_t> input(COLUMN_WORDS + LIGHT_WORDS);
+  uint32_t *nibbles = input.data() + COLUMN_WORDS;
+  for (int x = -1; x <= SIZE; ++x) {
+    for (int z = -1; z <= SIZE; ++z) {
+      bool inside = x >= 0 && z >= 0 && x < SIZE && z < SIZE;
+      u64 column = inside ? grid.columns[x * SIZE + z] : light.Border(x, z);
+      int i = (x + 1) * STRIDE + z + 1;
+      input[2 * i] = static_cast<uint32_t>(column);
+      input[2 * i + 1] = static_cast<uint32_t>(column >> 32);
+
+      for (int y = 0; y < SIZE; ++y) {
+        uint32_t level = std::max(light.Sky(x, y, z), light.Block(x, y, z));
+        int index = ((x + 1) * STRIDE + z + 1) * SIZE + y;
+        nibbles[index / 8] |= level << (index % 8 * 4);
+      }
+    }
+  }
+
+  // The faces MeshGrid() finds, the vertices of a face lie on its side of the voxel
+  std::fill(std::begin(counts), std::end(counts), 0);
+  glm::vec3 low(1e9f), high(-1e9f);
+  for (int x = 0; x < SIZE; ++x) {
+    for (int z = 0; z < SIZE; ++z) {
+      u64 column = grid.columns[x * SIZE + z];
+      if (column == 0) {
+        continue;
+      }
+
+      u64 left = x > 0 ? grid.columns[(x - 1) * SIZE + z] : 0;
+      u64 right = x < SIZE - 1 ? grid.columns[(x + 1) * SIZE + z] : 0;
+      u64 back = z > 0 ? grid.columns[x * SIZE + z - 1] : 0;
+      u64 front = z < SIZE - 1 ? grid.columns[x * SIZE + z + 1] : 0;
+      u64 faces[CUBE_FACES] = {column & ~front, column & ~back, column & ~left,
+                               column & ~right, column & ~(column >> 1), column & ~(column << 1)};
+
+      for (int i = 0; i < CUBE_FACES; ++i) {
+        if (faces[i] == 0) {
+          continue;
+        }
+
+        counts[i] += std::popcount(faces[i]) * 6;
+        auto face = static_cast<CubeFace>(i);
+        glm::vec3 min(x - 0.5f, std::countr_zero(faces[i]) - 0.5f, z - 0.5f);
+        glm::vec3 max(x + 0.5f, SIZE - std::countl_zero(faces[i]) - 0.5f, z + 0.5f);
+        min.x = face == CubeFace::Right ? max.x : min.x;
+        max.x = face == CubeFace::Left ? min.x : max.x;
+        min.y = face == CubeFace::Top ? min.y + 1.0f : min.y;
+        max.y = face == CubeFace::Bottom ? max.y - 1.0f : max.y;
+        min.z = face == CubeFace::Front ? max.z : min.z;
+        max.z = face == CubeFace::Back ? min.z : max.z;
+        low = glm::min(low, min);
+        high = glm::max(high, max);
+      }
+    }
+  }
+
+  boundsMin = low;
+  boundsMax = high;
+  if (low.x > high.x) {
+    boundsMin = glm::vec3(-0.5f);
+    boundsMax = glm::vec3(SIZE - 0.5f);
+  }
+  return input;
+}
+
+GLuint GpuMesher::InputBuffer() const {
+  return mInput;
+}
+
+void GpuMesher::Mesh(GLuint vertices, size_t first, const uint32_t (&counts)[CUBE_FACES]) {
+  size_t total = 0;
+  for (uint32_t count : counts) {
+    total += count;
+  }
+  if (total == 0) {
+    return;
+  }
+
+  // SSBO ranges have to start on an aligned offset, the shader skips the words in between
+  GLintptr offset = first * sizeof(Vertex);
+  GLintptr aligned = offset / mAlignment * mAlignment;
+  uint32_t zero[CUBE_FACES] = {};
+  glNamedBufferSubData(mCounters, 0, sizeof(zero), zero);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mInput);
+  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, vertices, aligned, offset - aligned + total * sizeof(Vertex));
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mCounters);
+
+  mShader->Bind();
+  mShader->UniformInt("base", static_cast<int>((offset - aligned) / sizeof(uint32_t)));
+  int start = 0;
+  for (int i = 0; i < CUBE_FACES; ++i) {
+    mShader->UniformInt("starts[" + std::to_string(i) + "]", start);
+    start += counts[i];
+  }
+  mShader->UniformVec2("uvStart", mTexture.start);
+  mShader->UniformVec2("uvEnd", mTexture.end);
+  // One invocation per column
+  glDispatchCompute(SIZE * SIZE / 64, 1, 1);
+  glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+  mShader->Unbind();
+  GpuProfiler::CountStateChange();
+
+  mStats.chunks++;
+  mStats.vertices += total;
+  mStats.inputBytes += INPUT_BYTES;
+}
+
+GpuMesher::Stats GpuMesher::TakeStats() {
+  Stats stats = mStats;
+  mStats = {};
+  return stats;
+}
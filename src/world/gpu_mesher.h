@@ -0,0 +1,60 @@
+#pragma once
+
+#include "core/shader.h"
+#include "cube.h"
+#include "light.h"
+#include "texture_atlas.h"
+#include "voxel_grid.h"
+#include <GL/glew.h>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+// Builds chunk meshes with a compute shader (mesh.comp). The worker only packs the grid's columns and the light the
+// faces sample into an input of INPUT_BYTES, and counts the faces of each direction with a popcount per column so the
+// mesh can be given its exact place in the mesh pool. On the GPU every column finds its visible faces with the same
+// bit operations as MeshGrid(), reserves room for them in its face direction's bucket with an atomic add, and writes
+// the vertices AddCubeFace() would, ambient occlusion included. Faces keep the CPU mesher's direction buckets but not
+// its order within a bucket.
+class GpuMesher {
+public:
+  // The columns of the chunk and the ring around it as pairs of 32 bit words, then 4 bits of light for every voxel in
+  // the same area
+  static const size_t COLUMN_WORDS = (VoxelGrid::SIZE + 2) * (VoxelGrid::SIZE + 2) * 2;
+  static const size_t LIGHT_WORDS = (VoxelGrid::SIZE + 2) * (VoxelGrid::SIZE + 2) * VoxelGrid::SIZE / 8;
+  static const size_t INPUT_BYTES = (COLUMN_WORDS + LIGHT_WORDS) * sizeof(uint32_t);
+
+  struct Stats {
+    int chunks = 0;
+    size_t vertices = 0;
+    size_t inputBytes = 0;
+  };
+
+  GpuMesher(std::unique_ptr<Shader> shader, const TextureAtlas &atlas);
+  ~GpuMesher();
+
+  GpuMesher(const GpuMesher &) = delete;
+  GpuMesher &operator=(const GpuMesher &) = delete;
+
+  // Any thread. Packs the input, counts the vertices of each face direction and computes the bounds of the mesh, the
+  // same ones the CPU mesher's vertices have.
+  static std::vector<uint32_t> Prepare(const VoxelGrid &grid, const LightVolume &light, uint32_t (&counts)[CUBE_FACES],
+                                       glm::vec3 &boundsMin, glm::vec3 &boundsMax);
+
+  // Main thread. Upload a chunk's input here, to offset 0, before meshing it.
+  GLuint InputBuffer() const;
+  // Writes the mesh of the input to vertices from vertex first on. The buffer has to be ready for the vertex fetch
+  // once this returns, so it ends with a barrier.
+  void Mesh(GLuint vertices, size_t first, const uint32_t (&counts)[CUBE_FACES]);
+
+  // Summed since the last call
+  Stats TakeStats();
+
+private:
+  std::unique_ptr<Shader> mShader;
+  TextureAtlasEntry mTexture;
+  GLuint mInput, mCounters;
+  GLint mAlignment;
+  Stats mStats;
+};
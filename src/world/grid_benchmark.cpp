@@ -0,0 +1,247 @@
+#include "grid_benchmark.h"
+#include "SDL3/SDL_log.h"
+#include "chunk_grid.h"
+#include "chunk_store.h"
+#include "core/benchmark.h"
+#include "world.h"
+#include <filesystem>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#define GLM_ENABLE_EXPERIMENTAL
+#include "glm/gtx/hash.hpp"
+
+namespace {
+
+const int LOAD_RADIUS = World::LOAD_RADIUS;
+const int RUNS = 5;
+// Updates of the lookup, iteration and neighbour workloads
+const int UPDATES = 2000;
+// Chunks the center moves in the insert and evict workload
+const int STEPS = 2000;
+
+// The world's chunk map before ChunkGrid, behind the same interface
+class ChunkMap {
+public:
+  Chunk *Get(const glm::ivec3 &position) const {
+    auto it = mChunks.find(position);
+    return it != mChunks.end() ? it->second.get() : nullptr;
+  }
+
+  void Insert(std::shared_ptr<Chunk> chunk) {
+    glm::ivec3 position = chunk->mPosition;
+    mChunks[position] = std::move(chunk);
+  }
+
+  std::shared_ptr<Chunk> Remove(const glm::ivec3 &position) {
+    auto it = mChunks.find(position);
+    if (it == mChunks.end()) {
+      return nullptr;
+    }
+    auto chunk = std::move(it->second);
+    mChunks.erase(it);
+    return chunk;
+  }
+
+  template <typename F> void ForEach(F &&callback) const {
+    for (const auto &[position, chunk] : mChunks) {
+      callback(*chunk);
+    }
+  }
+
+private:
+  std::unordered_map<glm::ivec3, std::shared_ptr<Chunk>> mChunks;
+};
+
+// Every chunk the walk ever loads, created up front so the workloads don't time the chunks' constructors
+class ChunkSource {
+public:
+  ChunkSource(const TextureAtlas &atlas, ChunkCache &cache, ChunkStore &store)
+      : mAtlas(atlas), mCache(cache), mStore(store) {
+  }
+
+  const std::shared_ptr<Chunk> &Get(const glm::ivec3 &position) {
+    auto &chunk = mChunks[position];
+    if (!chunk) {
+      chunk = std::make_shared<Chunk>(mAtlas, mCache, nullptr, mStore, position, 0);
+      chunk->mFaceCounts[0] = static_cast<uint32_t>(mChunks.size());
+    }
+    return chunk;
+  }
+
+private:
+  const TextureAtlas &mAtlas;
+  ChunkCache &mCache;
+  ChunkStore &mStore;
+  std::unordered_map<glm::ivec3, std::shared_ptr<Chunk>> mChunks;
+};
+
+// A walk that mostly keeps going straight and sometimes turns, one chunk per step
+std::vector<glm::ivec3> Walk(int seed) {
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<int> turn(0, 7);
+  const glm::ivec3 directions[] = {{1, 0, 0}, {0, 0, 1}, {-1, 0, 0}, {0, 0, -1}};
+  std::vector<glm::ivec3> centers = {glm::ivec3(0)};
+  int direction = 0;
+  for (int i = 0; i < STEPS; ++i) {
+    int roll = turn(random);
+    direction = (direction + (roll == 0 ? 1 : roll == 1 ? 3 : 0)) % 4;
+    centers.push_back(centers.back() + directions[direction]);
+  }
+  return centers;
+}
+
+// The same as World::EvictChunks() followed by World::Update() requesting the load square
+template <typename Chunks> void Move(Chunks &chunks, ChunkSource &source, const glm::ivec3 &center) {
+  std::vector<glm::ivec3> evicted;
+  chunks.ForEach([&](Chunk &chunk) {
+    glm::ivec3 offset = chunk.mPosition - center;
+    if (offset.x < -LOAD_RADIUS - 1 || offset.x > LOAD_RADIUS || offset.z < -LOAD_RADIUS - 1 ||
+        offset.z > LOAD_RADIUS) {
+      evicted.push_back(chunk.mPosition);
+    }
+  });
+  for (const auto &position : evicted) {
+    chunks.Remove(position);
+  }
+
+  for (int x = -LOAD_RADIUS; x < LOAD_RADIUS; ++x) {
+    for (int z = -LOAD_RADIUS; z < LOAD_RADIUS; ++z) {
+      glm::ivec3 position = center + glm::ivec3(x, 0, z);
+      if (!chunks.Get(position)) {
+        chunks.Insert(source.Get(position));
+      }
+    }
+  }
+}
+
+struct Result {
+  const char *structure;
+  float lookupMs = 0.0f;
+  float iterateMs = 0.0f;
+  float neighborMs = 0.0f;
+  float moveMs = 0.0f;
+  long chunks = 0;
+  // Summed up by the workloads, so they can't be optimized away and both structures can be compared
+  long found = 0;
+  long visited = 0;
+};
+
+// make() returns an empty structure
+template <typename Make>
+Result Measure(const char *structure, Make &&make, ChunkSource &source, const std::vector<glm::ivec3> &walk) {
+  Result result{.structure = structure};
+  auto chunks = make();
+  Move(*chunks, source, walk.front());
+  chunks->ForEach([&](Chunk &) { result.chunks++; });
+
+  result.lookupMs = BestOfRuns(RUNS, [&] {
+    result.found = 0;
+    for (int update = 0; update < UPDATES; ++update) {
+      for (int x = -LOAD_RADIUS; x < LOAD_RADIUS; ++x) {
+        for (int z = -LOAD_RADIUS; z < LOAD_RADIUS; ++z) {
+          result.found += chunks->Get(walk.front() + glm::ivec3(x, 0, z)) != nullptr;
+        }
+      }
+    }
+  });
+
+  result.iterateMs = BestOfRuns(RUNS, [&] {
+    result.visited = 0;
+    for (int update = 0; update < UPDATES; ++update) {
+      chunks->ForEach([&](Chunk &chunk) { result.visited += chunk.mFaceCounts[0]; });
+    }
+  });
+
+  long neighbors = 0;
+  const glm::ivec3 sides[] = {{1, 0, 0}, {-1, 0, 0}, {0, 0, 1}, {0, 0, -1}};
+  result.neighborMs = BestOfRuns(RUNS, [&] {
+    neighbors = 0;
+    for (int update = 0; update < UPDATES; ++update) {
+      chunks->ForEach([&](Chunk &chunk) {
+        for (const auto &side : sides) {
+          neighbors += chunks->Get(chunk.mPosition + side) != nullptr;
+        }
+      });
+    }
+  });
+  result.found += neighbors;
+
+  result.moveMs = BestOfRuns(RUNS, [&] {
+    chunks = make();
+    Move(*chunks, source, walk.front());
+    for (size_t i = 1; i < walk.size(); ++i) {
+      Move(*chunks, source, walk[i]);
+    }
+  });
+  chunks->ForEach([&](Chunk &chunk) { result.visited += chunk.mFaceCounts[0]; });
+  return result;
+}
+
+} // namespace
+
+bool RunGridBenchmark(int seed, const std::string &path) {
+  std::string directory = path + ".store";
+  std::error_code error;
+  std::filesystem::remove_all(directory, error);
+
+  std::vector<Result> results;
+  {
+    TextureAtlas atlas(0, {{TextureType::Dirt, {0.0f, 0.5f}, {0.25f, 0.75f}}});
+    ChunkCache cache;
+    ChunkStore store(directory);
+    ChunkSource source(atlas, cache, store);
+    auto walk = Walk(seed);
+    // Creates every chunk of the walk before anything is timed
+    for (const auto &center : walk) {
+      for (int x = -LOAD_RADIUS; x < LOAD_RADIUS; ++x) {
+        for (int z = -LOAD_RADIUS; z < LOAD_RADIUS; ++z) {
+          source.Get(center + glm::ivec3(x, 0, z));
+        }
+      }
+    }
+
+    // The world's grid has room for the extra ring chunks are kept in
+    auto grid = [] { return std::make_unique<ChunkGrid>(2 * LOAD_RADIUS + 2); };
+    auto map = [] { return std::make_unique<ChunkMap>(); };
+    results = {Measure("grid", grid, source, walk), Measure("unordered_map", map, source, walk)};
+  }
+  std::filesystem::remove_all(directory, error);
+
+  const auto &grid = results[0], &map = results[1];
+  bool same = grid.chunks == map.chunks && grid.found == map.found && grid.visited == map.visited;
+  if (!same) {
+    SDL_Log("Chunk grid and map disagree: %ld and %ld chunks, %ld and %ld found", grid.chunks, map.chunks, grid.found,
+            map.found);
+  }
+
+  BenchmarkCsv out(path);
+  if (!out.Ok()) {
+    return false;
+  }
+
+  long square = 4 * LOAD_RADIUS * LOAD_RADIUS;
+  out.Table("structure,operation,operations,ms,ns_per_operation");
+  for (const auto &result : results) {
+    struct {
+      const char *name;
+      long operations;
+      float ms;
+    } operations[] = {
+        {"lookup", UPDATES * square, result.lookupMs},
+        {"iterate", UPDATES * result.chunks, result.iterateMs},
+        {"neighbors", 4 * UPDATES * result.chunks, result.neighborMs},
+        {"move", STEPS, result.moveMs},
+    };
+    for (const auto &operation : operations) {
+      out.Row(result.structure, operation.name, operation.operations, operation.ms,
+              operation.ms * 1e6f / operation.operations);
+    }
+    SDL_Log("Chunks in a %s: lookup %.2f ns, iteration %.2f ns per chunk, neighbours %.2f ns, %.2f us per move",
+            result.structure, result.lookupMs * 1e6f / (UPDATES * square),
+            result.iterateMs * 1e6f / (UPDATES * result.chunks),
+            result.neighborMs * 1e6f / (4 * UPDATES * result.chunks), result.moveMs * 1e3f / STEPS);
+  }
+
+  return same;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+// Compares the world's ChunkGrid with the unordered_map it replaced, both holding the load square: looking up every
+// position of the square, iterating the chunks, looking up their four neighbours, and evicting and inserting chunks
+// while the center walks a random path. Checks that both end up with the same chunks. Needs no GL context.
+bool RunGridBenchmark(int seed, const std::string &path);
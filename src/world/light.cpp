@@ -0,0 +1,223 @@
+#include "light.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace {
+
+const int BORDER = 1;
+const int STRIDE = LightVolume::SIZE + 2 * BORDER;
+
+const glm::ivec3 DIRECTIONS[] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+
+// Scratch volume the flood fill runs in, covering the relit box plus the distance light can travel into it
+struct Workspace {
+  glm::ivec3 min, size;
+  std::vector<u64> columns;
+  std::vector<uint8_t> sky, block;
+  std::vector<int> queue;
+
+  Workspace(const LightVolume::ColumnSource &source, const glm::ivec3 &min, const glm::ivec3 &max)
+      : min(min), size(max - min + 1) {
+    columns.resize(size.x * size.z);
+    for (int x = 0; x < size.x; ++x) {
+      for (int z = 0; z < size.z; ++z) {
+        columns[x * size.z + z] = source(min.x + x, min.z + z);
+      }
+    }
+
+    sky.assign(size.x * size.y * size.z, 0);
+    block.assign(size.x * size.y * size.z, 0);
+  }
+
+  bool Contains(const glm::ivec3 &p) const {
+    return p.x >= 0 && p.y >= 0 && p.z >= 0 && p.x < size.x && p.y < size.y && p.z < size.z;
+  }
+
+  int Index(const glm::ivec3 &p) const {
+    return (p.x * size.z + p.z) * size.y + p.y;
+  }
+
+  glm::ivec3 Position(int index) const {
+    return {index / size.y / size.z, index % size.y, index / size.y % size.z};
+  }
+
+  bool Solid(const glm::ivec3 &p) const {
+    return columns[p.x * size.z + p.z] & (static_cast<u64>(1) << (p.y + min.y));
+  }
+
+  // Breadth first flood fill from everything in the queue, one level lost per step
+  void Flood(std::vector<uint8_t> &light) {
+    for (size_t head = 0; head < queue.size(); ++head) {
+      auto position = Position(queue[head]);
+      uint8_t level = light[queue[head]];
+      if (level <= 1) {
+        continue;
+      }
+
+      for (const auto &direction : DIRECTIONS) {
+        auto next = position + direction;
+        if (!Contains(next) || Solid(next)) {
+          continue;
+        }
+
+        int index = Index(next);
+        if (light[index] < level - 1) {
+          light[index] = level - 1;
+          queue.push_back(index);
+        }
+      }
+    }
+    queue.clear();
+  }
+};
+
+// Voxels open to the sky: everything above the highest solid voxel of the column
+u64 SkyMask(u64 column) {
+  int top = LightVolume::SIZE - std::countl_zero(column);
+  return top == LightVolume::SIZE ? 0 : ~static_cast<u64>(0) << top;
+}
+
+} // namespace
+
+LightVolume::LightVolume() : mLight(STRIDE * SIZE * STRIDE, 0), mBorder(4 * STRIDE - 4, 0) {
+}
+
+void LightVolume::Compute(const ColumnSource &columns, const std::vector<LightSource> &sources) {
+  Relight(columns, sources, {-BORDER, 0, -BORDER}, {SIZE - 1 + BORDER, SIZE - 1, SIZE - 1 + BORDER});
+}
+
+void LightVolume::Relight(const ColumnSource &columns, const std::vector<LightSource> &sources, const glm::ivec3 &min,
+                          const glm::ivec3 &max) {
+  // An edit changes the light up to MAX_LIGHT voxels away from it, and down the whole column when it opens or closes
+  // the sky, so all of that is written back. Chunks are a single voxel layer high, so y never grows past the chunk.
+  // Above it is open sky, below it is dark.
+  glm::ivec3 margin = {MAX_LIGHT, 0, MAX_LIGHT};
+  glm::ivec3 from = glm::max(min - margin, glm::ivec3(-BORDER, 0, -BORDER));
+  glm::ivec3 to = glm::min(max + margin, glm::ivec3(SIZE - 1 + BORDER, SIZE - 1, SIZE - 1 + BORDER));
+  from.y = 0;
+  to.y = SIZE - 1;
+  // The light written back comes from up to MAX_LIGHT voxels further out
+  glm::ivec3 low = from - margin;
+  glm::ivec3 high = to + margin;
+  Workspace work(columns, low, high);
+
+  // Sky light: the highest set bit of each column tells which voxels see the sky, those are fully lit. Only the ones
+  // next to an unlit air voxel can spread further, found a whole column at a time by masking against the neighbours.
+  for (int x = 0; x < work.size.x; ++x) {
+    for (int z = 0; z < work.size.z; ++z) {
+      u64 column = work.columns[x * work.size.z + z];
+      u64 sky = SkyMask(column);
+      if (sky == 0) {
+        continue;
+      }
+
+      u64 spreads = 0;
+      for (const auto &direction : DIRECTIONS) {
+        int nx = x + direction.x;
+        int nz = z + direction.z;
+        if (direction.y != 0 || nx < 0 || nz < 0 || nx >= work.size.x || nz >= work.size.z) {
+          continue;
+        }
+
+        u64 neighbor = work.columns[nx * work.size.z + nz];
+        spreads |= ~neighbor & ~SkyMask(neighbor);
+      }
+      spreads &= sky;
+
+      for (u64 bits = sky; bits != 0; bits &= bits - 1) {
+        int y = std::countr_zero(bits);
+        int index = work.Index({x, y, z});
+        work.sky[index] = MAX_LIGHT;
+        if (spreads & (static_cast<u64>(1) << y)) {
+          work.queue.push_back(index);
+        }
+      }
+    }
+  }
+  work.Flood(work.sky);
+
+  for (const auto &source : sources) {
+    auto position = source.position - low;
+    if (!work.Contains(position)) {
+      continue;
+    }
+
+    int index = work.Index(position);
+    uint8_t level = std::min<uint8_t>(source.level, MAX_LIGHT);
+    if (work.block[index] < level) {
+      work.block[index] = level;
+      work.queue.push_back(index);
+    }
+  }
+  work.Flood(work.block);
+
+  for (int x = from.x; x <= to.x; ++x) {
+    for (int z = from.z; z <= to.z; ++z) {
+      for (int y = from.y; y <= to.y; ++y) {
+        int index = work.Index(glm::ivec3(x, y, z) - low);
+        mLight[Index(x, y, z)] = work.sky[index] << 4 | work.block[index];
+      }
+      if (x < 0 || z < 0 || x >= SIZE || z >= SIZE) {
+        mBorder[BorderIndex(x, z)] = work.columns[(x - low.x) * work.size.z + z - low.z];
+      }
+    }
+  }
+}
+
+uint8_t LightVolume::Sky(int x, int y, int z) const {
+  if (y >= SIZE) {
+    return MAX_LIGHT;
+  }
+
+  if (y < 0) {
+    return 0;
+  }
+
+  return mLight[Index(x, y, z)] >> 4;
+}
+
+uint8_t LightVolume::Block(int x, int y, int z) const {
+  if (y < 0 || y >= SIZE) {
+    return 0;
+  }
+
+  return mLight[Index(x, y, z)] & 0x0f;
+}
+
+uint8_t LightVolume::Level(int x, int y, int z) const {
+  return std::max(Sky(x, y, z), Block(x, y, z));
+}
+
+u64 LightVolume::Border(int x, int z) const {
+  return mBorder[BorderIndex(x, z)];
+}
+
+u64 LightVolume::Hash() const {
+  u64 hash = 14695981039346656037ull;
+  for (size_t i = 0; i + sizeof(u64) <= mLight.size(); i += sizeof(u64)) {
+    u64 word;
+    std::memcpy(&word, mLight.data() + i, sizeof(word));
+    hash = (hash ^ word) * 1099511628211ull;
+  }
+  for (u64 column : mBorder) {
+    hash = (hash ^ column) * 1099511628211ull;
+  }
+  return hash;
+}
+
+size_t LightVolume::Bytes() const {
+  return mLight.size() + mBorder.size() * sizeof(u64);
+}
+
+int LightVolume::Index(int x, int y, int z) {
+  return ((x + BORDER) * STRIDE + (z + BORDER)) * SIZE + y;
+}
+
+// The rows at z = -1 and z = SIZE first, then the columns at x = -1 and x = SIZE between them
+int LightVolume::BorderIndex(int x, int z) {
+  if (z < 0 || z >= SIZE) {
+    return (z < 0 ? 0 : STRIDE) + x + BORDER;
+  }
+  return 2 * STRIDE + (x < 0 ? 0 : SIZE) + z;
+}
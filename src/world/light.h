@@ -0,0 +1,51 @@
+#pragma once
+
+#include "voxel_grid.h"
+#include <functional>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct LightSource {
+  glm::ivec3 position;
+  uint8_t level;
+};
+
+// Sky and block light for one chunk plus a one voxel ring around it in x and z, so faces on the chunk border can be
+// lit from the neighbour's side. Light values go from 0 to MAX_LIGHT and lose one level per voxel travelled. The solid
+// voxels of the ring are kept too, the mesher's ambient occlusion looks across the border.
+class LightVolume {
+public:
+  static const int MAX_LIGHT = 15;
+  static const int SIZE = VoxelGrid::SIZE;
+
+  // Solid voxels of the column at chunk local (x, z), called with coordinates outside the chunk too
+  using ColumnSource = std::function<u64(int x, int z)>;
+
+  LightVolume();
+
+  // Recompute the light of the whole chunk
+  void Compute(const ColumnSource &columns, const std::vector<LightSource> &sources);
+  // Recompute the light after the voxels or sources inside [min, max] changed. Light can't travel further than
+  // MAX_LIGHT voxels, so only the columns within that distance of the box are relit, over their full height.
+  void Relight(const ColumnSource &columns, const std::vector<LightSource> &sources, const glm::ivec3 &min,
+               const glm::ivec3 &max);
+
+  uint8_t Sky(int x, int y, int z) const;
+  uint8_t Block(int x, int y, int z) const;
+  // Brightest of the two channels
+  uint8_t Level(int x, int y, int z) const;
+  // Solid voxels of a ring column, x or z is -1 or SIZE
+  u64 Border(int x, int z) const;
+
+  u64 Hash() const;
+  size_t Bytes() const;
+  bool operator==(const LightVolume &other) const = default;
+
+private:
+  // Sky light in the high nibble, block light in the low one
+  std::vector<uint8_t> mLight;
+  std::vector<u64> mBorder;
+
+  static int Index(int x, int y, int z);
+  static int BorderIndex(int x, int z);
+};
@@ -0,0 +1,149 @@
+#include "light_benchmark.h"
+#include "SDL3/SDL_log.h"
+#include "core/benchmark.h"
+#include "light.h"
+#include "terrain.h"
+#include <algorithm>
+#include <bit>
+#include <random>
+#include <vector>
+
+namespace {
+
+const int SIZE = LightVolume::SIZE;
+// Columns around the chunk the light can be computed from, as in Chunk
+const int MARGIN = LightVolume::MAX_LIGHT + 1;
+const int EDITS = 96;
+
+enum class EditKind { Dig, Build, Tunnel, Torch };
+const char *const EDIT_NAMES[] = {"dig", "build", "tunnel", "torch"};
+
+struct Edit {
+  EditKind kind;
+  glm::ivec3 voxel;
+  float relightMs;
+  float computeMs;
+  bool same;
+};
+
+// Terrain columns of the chunk plus everything its light can reach into
+struct Patch {
+  int area = SIZE + 2 * MARGIN;
+  std::vector<u64> columns;
+
+  Patch(int seed) : columns(area * area) {
+    Terrain(seed).Region(-MARGIN, 0, -MARGIN, area, area, columns.data());
+  }
+
+  u64 &Column(int x, int z) {
+    return columns[(x + MARGIN) * area + z + MARGIN];
+  }
+
+  u64 operator()(int x, int z) const {
+    return columns[(x + MARGIN) * area + z + MARGIN];
+  }
+};
+
+// First air voxel above the ground
+int Top(u64 column) {
+  return SIZE - std::countl_zero(column);
+}
+
+// Changes the patch at a random column of the chunk or its ring, false if the column doesn't allow this kind of edit
+bool Apply(EditKind kind, Patch &patch, std::vector<LightSource> &sources, std::mt19937 &random, glm::ivec3 &voxel) {
+  std::uniform_int_distribution<int> position(-1, SIZE);
+  voxel.x = position(random);
+  voxel.z = position(random);
+  u64 &column = patch.Column(voxel.x, voxel.z);
+  int top = Top(column);
+
+  switch (kind) {
+  case EditKind::Dig:
+    // Opens the sky for the whole column below
+    voxel.y = top - 1;
+    break;
+  case EditKind::Build:
+  case EditKind::Torch:
+    voxel.y = top;
+    break;
+  case EditKind::Tunnel:
+    voxel.y = top - 4;
+    break;
+  }
+  if (voxel.y < 0 || voxel.y >= SIZE) {
+    return false;
+  }
+
+  u64 bit = static_cast<u64>(1) << voxel.y;
+  if (kind == EditKind::Build) {
+    column |= bit;
+  } else if (kind == EditKind::Torch) {
+    sources.push_back({voxel, LightVolume::MAX_LIGHT});
+  } else {
+    column &= ~bit;
+  }
+  return true;
+}
+
+} // namespace
+
+bool RunLightBenchmark(int seed, const std::string &path) {
+  Patch patch(seed);
+  std::vector<LightSource> sources;
+  auto columns = [&](int x, int z) { return patch(x, z); };
+
+  LightVolume relit;
+  relit.Compute(columns, sources);
+
+  std::mt19937 random(seed);
+  std::vector<Edit> edits;
+  int mismatches = 0;
+  while (static_cast<int>(edits.size()) < EDITS) {
+    Edit edit{static_cast<EditKind>(edits.size() % 4), {}, 0.0f, 0.0f, false};
+    if (!Apply(edit.kind, patch, sources, random, edit.voxel)) {
+      continue;
+    }
+
+    // Edits pile up in the same volume, so light a relight got wrong would also show up in the later ones
+    auto start = SDL_GetPerformanceCounter();
+    relit.Relight(columns, sources, edit.voxel, edit.voxel);
+    edit.relightMs = ElapsedMs(start);
+
+    LightVolume full;
+    start = SDL_GetPerformanceCounter();
+    full.Compute(columns, sources);
+    edit.computeMs = ElapsedMs(start);
+
+    edit.same = relit == full;
+    if (!edit.same) {
+      if (mismatches < 10) {
+        SDL_Log("Relight after %s at (%d, %d, %d) differs from lighting the whole chunk",
+                EDIT_NAMES[static_cast<int>(edit.kind)], edit.voxel.x, edit.voxel.y, edit.voxel.z);
+      }
+      mismatches++;
+      relit = full;
+    }
+    edits.push_back(edit);
+  }
+
+  BenchmarkCsv out(path);
+  if (!out.Ok()) {
+    return false;
+  }
+
+  float relightMs = 0.0f, computeMs = 0.0f;
+  out.Table("edit,kind,x,y,z,relight_ms,compute_ms,same");
+  for (size_t i = 0; i < edits.size(); ++i) {
+    const auto &edit = edits[i];
+    out.Row(i, EDIT_NAMES[static_cast<int>(edit.kind)], edit.voxel.x, edit.voxel.y, edit.voxel.z, edit.relightMs,
+            edit.computeMs, edit.same);
+    relightMs += edit.relightMs;
+    computeMs += edit.computeMs;
+  }
+  SDL_Log("Relight benchmark: %zu edits, %d differ from lighting the whole chunk, %.3f ms per relight, %.3f ms per "
+          "full compute (%.1fx)",
+          edits.size(), mismatches, relightMs / edits.size(), computeMs / edits.size(),
+          computeMs / std::max(relightMs, 0.001f));
+
+  return mismatches == 0;
+}
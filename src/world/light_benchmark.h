@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+// Digs, builds and places torches in a terrain chunk and its ring one edit at a time, relighting only around each edit
+// and checking the result against lighting the whole chunk again. Reports the time of both per edit. Runs on the CPU
+// only.
+bool RunLightBenchmark(int seed, const std::string &path);
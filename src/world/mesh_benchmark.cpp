@@ -0,0 +1,104 @@
+#include "mesh_benchmark.h"
+#include "SDL3/SDL_log.h"
+#include "core/benchmark.h"
+#include "mesher.h"
+#include "terrain.h"
+#include "vertex.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// The patch meshed for every size, in voxels. The terrain is one 64 voxel column high.
+const int AREA = 256;
+const int HEIGHT = 64;
+const int RUNS = 5;
+
+struct Result {
+  int size = 0;
+  int chunks = 0;
+  int drawCalls = 0;
+  size_t vertices = 0;
+  size_t gridBytes = 0;
+  size_t vertexBytes = 0;
+  float ms = 0.0f;
+};
+
+template <int Size>
+Result Measure(const std::vector<u64> &columns) {
+  using Grid = BasicVoxelGrid<Size>;
+  using Column = typename Grid::Column;
+  constexpr int HORIZONTAL = AREA / Size;
+  constexpr int VERTICAL = HEIGHT / Size;
+
+  std::vector<std::unique_ptr<Grid>> grids;
+  for (int cx = 0; cx < HORIZONTAL; ++cx) {
+    for (int cz = 0; cz < HORIZONTAL; ++cz) {
+      for (int cy = 0; cy < VERTICAL; ++cy) {
+        auto grid = std::make_unique<Grid>();
+        for (int x = 0; x < Size; ++x) {
+          for (int z = 0; z < Size; ++z) {
+            u64 column = columns[(cx * Size + x) * AREA + cz * Size + z];
+            grid->columns[x * Size + z] = static_cast<Column>(column >> (cy * Size));
+          }
+        }
+        grids.push_back(std::move(grid));
+      }
+    }
+  }
+
+  Result result;
+  result.size = Size;
+  result.chunks = grids.size();
+  result.gridBytes = grids.size() * sizeof(Grid);
+
+  std::vector<Vertex> vertices;
+  result.ms = BestOfRuns(RUNS, [&] {
+    result.drawCalls = 0;
+    result.vertices = 0;
+    for (const auto &grid : grids) {
+      vertices.clear();
+      MeshGrid(
+          *grid,
+          [&](CubeFace face, int x, int y, int z) {
+            // Fully lit and unoccluded
+            Vertex vertex{glm::vec3(x, y, z), glm::vec2(0.0f), glm::vec3(FaceDirection(face)), 255, 255, {}};
+            for (int i = 0; i < 6; ++i) {
+              vertices.push_back(vertex);
+            }
+          },
+          [] { return false; });
+      result.vertices += vertices.size();
+      result.drawCalls += vertices.empty() ? 0 : 1;
+    }
+  });
+  result.vertexBytes = result.vertices * sizeof(Vertex);
+
+  return result;
+}
+
+} // namespace
+
+bool RunMeshBenchmark(int seed, const std::string &path) {
+  std::vector<u64> columns(AREA * AREA);
+  Terrain(seed).Region(0, 0, 0, AREA, AREA, columns.data());
+  Result results[] = {Measure<16>(columns), Measure<32>(columns), Measure<64>(columns)};
+
+  BenchmarkCsv out(path);
+  if (!out.Ok()) {
+    return false;
+  }
+
+  out.Table("size,chunks,draw_calls,vertices,grid_bytes,vertex_bytes,mesh_ms,voxels_per_ms");
+  for (const auto &result : results) {
+    float voxelsPerMs = static_cast<float>(AREA) * AREA * HEIGHT / std::max(result.ms, 0.001f);
+    out.Row(result.size, result.chunks, result.drawCalls, result.vertices, result.gridBytes, result.vertexBytes,
+            result.ms, voxelsPerMs);
+    SDL_Log("Mesh benchmark %d^3: %d chunks, %d draw calls, %.2f MB grids, %.2f MB vertices, %.2f ms (%.0f voxels/ms)",
+            result.size, result.chunks, result.drawCalls, result.gridBytes / (1024.0f * 1024.0f),
+            result.vertexBytes / (1024.0f * 1024.0f), result.ms, voxelsPerMs);
+  }
+
+  return true;
+}
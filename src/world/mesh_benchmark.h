@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// Meshes the same patch of terrain with 16, 32 and 64 voxel chunks and reports meshing throughput, memory and the
+// number of draw calls each size needs. Runs on the CPU only, so it doesn't need a window.
+bool RunMeshBenchmark(int seed, const std::string &path);
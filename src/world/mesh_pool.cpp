@@ -0,0 +1,50 @@
+#include "mesh_pool.h"
+#include "SDL3/SDL_log.h"
+#include "core/memory_tracker.h"
+#include <cstddef>
+
+MeshPool::MeshPool(size_t capacity) : mBuffer(0), mVao(0), mAllocator(capacity) {
+  glCreateBuffers(1, &mBuffer);
+  glNamedBufferStorage(mBuffer, capacity * sizeof(Vertex), nullptr, 0);
+  MemoryTracker::RegisterBuffer(mBuffer, GpuTag::MeshPool, capacity * sizeof(Vertex));
+
+  glCreateVertexArrays(1, &mVao);
+  glVertexArrayVertexBuffer(mVao, 0, mBuffer, 0, sizeof(Vertex));
+  glVertexArrayAttribFormat(mVao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+  glVertexArrayAttribFormat(mVao, 1, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, textureCoords));
+  glVertexArrayAttribFormat(mVao, 2, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+  glVertexArrayAttribFormat(mVao, 3, 1, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Vertex, light));
+  glVertexArrayAttribFormat(mVao, 4, 1, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Vertex, occlusion));
+  for (GLuint attribute = 0; attribute < 5; ++attribute) {
+    glVertexArrayAttribBinding(mVao, attribute, 0);
+    glEnableVertexArrayAttrib(mVao, attribute);
+  }
+
+  SDL_Log("Mesh pool: %.0f MB", capacity * sizeof(Vertex) / (1024.0f * 1024.0f));
+}
+
+MeshPool::~MeshPool() {
+  glDeleteVertexArrays(1, &mVao);
+  MemoryTracker::ReleaseBuffer(mBuffer);
+  glDeleteBuffers(1, &mBuffer);
+}
+
+std::optional<RangeAllocation> MeshPool::Allocate(size_t vertices) {
+  return mAllocator.Allocate(vertices);
+}
+
+void MeshPool::Free(const RangeAllocation &allocation) {
+  mAllocator.Free(allocation);
+}
+
+GLuint MeshPool::Buffer() const {
+  return mBuffer;
+}
+
+GLuint MeshPool::VertexArray() const {
+  return mVao;
+}
+
+size_t MeshPool::UsedBytes() const {
+  return mAllocator.Used() * sizeof(Vertex);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "core/range_allocator.h"
+#include "vertex.h"
+#include <GL/glew.h>
+#include <optional>
+
+// One vertex buffer and vertex array shared by every chunk mesh, so the whole world can be drawn with a single
+// indirect draw. Ranges are counted in vertices, an allocation's offset is the first vertex of its draw. Main thread
+// only.
+class MeshPool {
+public:
+  MeshPool(size_t capacity);
+  ~MeshPool();
+
+  MeshPool(const MeshPool &) = delete;
+  MeshPool &operator=(const MeshPool &) = delete;
+
+  // Returns nothing once the pool is full, the caller has to fall back to a buffer of its own
+  std::optional<RangeAllocation> Allocate(size_t vertices);
+  void Free(const RangeAllocation &allocation);
+
+  GLuint Buffer() const;
+  GLuint VertexArray() const;
+  size_t UsedBytes() const;
+
+private:
+  GLuint mBuffer, mVao;
+  RangeAllocator mAllocator;
+};
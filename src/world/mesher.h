@@ -0,0 +1,47 @@
+#pragma once
+
+#include "cube.h"
+#include "voxel_grid.h"
+#include <bit>
+
+// Calls emit(face, x, y, z) for every visible face of the grid. Faces are found a column at a time: a solid bit with
+// an empty bit above it is a top face, and so on. Faces on the chunk border are always emitted. stop() is checked once
+// per x slice, returns false if meshing was stopped early.
+template <int Size, typename Emit, typename Stop>
+bool MeshGrid(const BasicVoxelGrid<Size> &grid, Emit &&emit, Stop &&stop) {
+  using Column = typename BasicVoxelGrid<Size>::Column;
+
+  auto emitFaces = [&](CubeFace face, int x, int z, Column faces) {
+    while (faces != 0) {
+      emit(face, x, std::countr_zero(faces), z);
+      faces &= faces - 1;
+    }
+  };
+
+  for (int x = 0; x < Size; ++x) {
+    if (stop()) {
+      return false;
+    }
+
+    for (int z = 0; z < Size; ++z) {
+      Column column = grid.columns[x * Size + z];
+      if (column == 0) {
+        continue;
+      }
+
+      Column left = x > 0 ? grid.columns[(x - 1) * Size + z] : 0;
+      Column right = x < Size - 1 ? grid.columns[(x + 1) * Size + z] : 0;
+      Column back = z > 0 ? grid.columns[x * Size + z - 1] : 0;
+      Column front = z < Size - 1 ? grid.columns[x * Size + z + 1] : 0;
+
+      emitFaces(CubeFace::Top, x, z, column & ~static_cast<Column>(column >> 1));
+      emitFaces(CubeFace::Bottom, x, z, column & ~static_cast<Column>(column << 1));
+      emitFaces(CubeFace::Left, x, z, column & ~left);
+      emitFaces(CubeFace::Right, x, z, column & ~right);
+      emitFaces(CubeFace::Back, x, z, column & ~back);
+      emitFaces(CubeFace::Front, x, z, column & ~front);
+    }
+  }
+
+  return true;
+}
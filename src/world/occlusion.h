@@ -0,0 +1,52 @@
+#pragma once
+
+#include "cube.h"
+#include <array>
+#include <glm/glm.hpp>
+
+// Ambient occlusion baked into the mesh. Every corner of a face looks at the three voxels around it in the layer the
+// face looks into: the two beside it along the face's edges and the one diagonal to it.
+const int MAX_OCCLUSION = 3;
+
+// From 0, fully occluded, to MAX_OCCLUSION with nothing around the corner. Two solid sides hide the diagonal voxel, so
+// the corner is as dark as it gets whatever that one is.
+inline int CornerOcclusion(bool side1, bool side2, bool corner) {
+  if (side1 && side2) {
+    return 0;
+  }
+  return MAX_OCCLUSION - side1 - side2 - corner;
+}
+
+// Occlusion of the face's corners in FACE_CORNERS order. solid(voxel) is asked about voxels up to one outside the
+// chunk, so faces on the border need the neighbour's columns.
+template <typename Solid>
+std::array<int, 4> FaceOcclusion(CubeFace face, const glm::ivec3 &voxel, Solid &&solid) {
+  glm::ivec3 normal = FaceDirection(face);
+  glm::ivec3 layer = voxel + normal;
+  // The two axes along the face
+  glm::ivec3 tangent1 = normal.x != 0 ? glm::ivec3(0, 1, 0) : glm::ivec3(1, 0, 0);
+  glm::ivec3 tangent2 = normal.z != 0 ? glm::ivec3(0, 1, 0) : glm::ivec3(0, 0, 1);
+
+  std::array<int, 4> occlusion;
+  for (int i = 0; i < 4; ++i) {
+    glm::ivec3 side = CornerSide(FACE_CORNERS[static_cast<int>(face)][i]);
+    glm::ivec3 offset1 = tangent1 * side;
+    glm::ivec3 offset2 = tangent2 * side;
+    occlusion[i] = CornerOcclusion(solid(layer + offset1), solid(layer + offset2), solid(layer + offset1 + offset2));
+  }
+  return occlusion;
+}
+
+// Quads are split into two triangles along corners 1 and 3. Colors are interpolated across each triangle, so a corner
+// darker than the rest would stretch along the diagonal. The quad is split along corners 0 and 2 instead when they
+// are the brighter pair, which keeps the darkening symmetric.
+inline bool FlipQuad(const std::array<int, 4> &occlusion) {
+  return occlusion[0] + occlusion[2] > occlusion[1] + occlusion[3];
+}
+
+// Indices into the quad's corners for its two triangles, the winding is the same either way
+inline const std::array<int, 6> &QuadTriangles(bool flip) {
+  static const std::array<int, 6> normal = {0, 1, 3, 1, 2, 3};
+  static const std::array<int, 6> flipped = {0, 1, 2, 0, 2, 3};
+  return flip ? flipped : normal;
+}
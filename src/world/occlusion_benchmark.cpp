@@ -0,0 +1,267 @@
+#include "occlusion_benchmark.h"
+#include "SDL3/SDL_log.h"
+#include "chunk.h"
+#include "chunk_store.h"
+#include "core/benchmark.h"
+#include "occlusion.h"
+#include "terrain.h"
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const int SIZE = VoxelGrid::SIZE;
+// Chunks per side of the meshed patch
+const int CHUNKS = 4;
+const int RUNS = 5;
+// The test cases are saved as chunks along this row, far from the patch
+const int CASE_ROW = 1000;
+
+using Corners = std::array<int, 4>;
+
+struct Case {
+  const char *name;
+  CubeFace face;
+  // Solid besides the voxel in the middle of the chunk, whose face is checked. Everything else is air.
+  std::vector<glm::ivec3> solid;
+  Corners expected;
+  bool flip;
+};
+
+// Corners in FACE_CORNERS order
+std::vector<Case> Cases() {
+  return {
+      {"open top", CubeFace::Top, {}, {3, 3, 3, 3}, false},
+      {"one side", CubeFace::Top, {{1, 1, 0}}, {3, 2, 2, 3}, false},
+      {"diagonal only", CubeFace::Top, {{1, 1, 1}}, {3, 2, 3, 3}, true},
+      {"two sides hide the diagonal", CubeFace::Top, {{1, 1, 0}, {0, 1, 1}}, {2, 0, 2, 3}, true},
+      {"side and diagonal", CubeFace::Top, {{1, 1, 0}, {1, 1, 1}}, {3, 1, 2, 3}, true},
+      {"side face under an overhang", CubeFace::Right, {{1, 1, 0}}, {3, 3, 2, 2}, false},
+      {"voxels behind the face don't count", CubeFace::Front, {{1, 0, -1}, {0, 1, 0}}, {3, 3, 3, 3}, false},
+  };
+}
+
+// A face as the chunk meshed it
+struct MeshFace {
+  CubeFace face;
+  glm::ivec3 voxel;
+  Corners occlusion;
+  bool flip;
+};
+
+// Reads the faces back out of the chunk's mesh: six vertices each, one direction after the other. A flipped quad
+// repeats its third corner as the fifth vertex, see QuadTriangles().
+std::vector<MeshFace> Faces(const Chunk &chunk) {
+  std::vector<MeshFace> faces;
+  if (!chunk.mVertices) {
+    return faces;
+  }
+
+  const Vertex *vertex = chunk.mVertices->data();
+  for (int i = 0; i < CUBE_FACES; ++i) {
+    auto face = static_cast<CubeFace>(i);
+    glm::vec3 direction = FaceDirection(face);
+    for (uint32_t j = 0; j < chunk.mFaceCounts[i]; j += 6, vertex += 6) {
+      glm::vec3 min = vertex[0].position, max = vertex[0].position;
+      for (int k = 1; k < 6; ++k) {
+        min = glm::min(min, vertex[k].position);
+        max = glm::max(max, vertex[k].position);
+      }
+
+      glm::ivec3 voxel(glm::round((min + max) * 0.5f - direction * 0.5f));
+      MeshFace meshed{face, voxel, {}, vertex[2].position == vertex[4].position};
+      for (int k = 0; k < 6; ++k) {
+        for (int corner = 0; corner < 4; ++corner) {
+          glm::vec3 position = glm::vec3(meshed.voxel) + glm::vec3(CornerSide(FACE_CORNERS[i][corner])) * 0.5f;
+          if (position == vertex[k].position) {
+            meshed.occlusion[corner] = vertex[k].occlusion / UnitByte(1, MAX_OCCLUSION);
+          }
+        }
+      }
+      faces.push_back(meshed);
+    }
+  }
+  return faces;
+}
+
+int CheckCorners() {
+  int failures = 0;
+  // side1, side2, diagonal and the result
+  const int table[8][4] = {{0, 0, 0, 3}, {1, 0, 0, 2}, {0, 1, 0, 2}, {0, 0, 1, 2},
+                           {1, 0, 1, 1}, {0, 1, 1, 1}, {1, 1, 0, 0}, {1, 1, 1, 0}};
+  for (const auto &row : table) {
+    if (CornerOcclusion(row[0], row[1], row[2]) != row[3]) {
+      SDL_Log("Occlusion test: corner %d %d %d should be %d", row[0], row[1], row[2], row[3]);
+      failures++;
+    }
+  }
+  return failures;
+}
+
+// Every case is saved as a chunk of its own and meshed by the chunk, like a chunk the player built
+int CheckCases(ChunkStore &store, const TextureAtlas &atlas, int seed) {
+  int failures = 0;
+  const glm::ivec3 center(SIZE / 2);
+  auto cases = Cases();
+  for (size_t i = 0; i < cases.size(); ++i) {
+    const auto &test = cases[i];
+    auto grid = std::make_shared<VoxelGrid>();
+    grid->columns[center.x * SIZE + center.z] |= static_cast<u64>(1) << center.y;
+    for (const auto &offset : test.solid) {
+      glm::ivec3 voxel = center + offset;
+      grid->columns[voxel.x * SIZE + voxel.z] |= static_cast<u64>(1) << voxel.y;
+    }
+    glm::ivec3 position(static_cast<int>(i), 0, CASE_ROW);
+    store.Save(position, ChunkContent::Mixed, grid);
+
+    ChunkCache cache;
+    Chunk chunk(atlas, cache, nullptr, store, position, seed);
+    chunk.GenerateVertices();
+    auto faces = Faces(chunk);
+    auto meshed = std::find_if(faces.begin(), faces.end(), [&](const MeshFace &face) {
+      return face.face == test.face && face.voxel == center;
+    });
+    if (meshed == faces.end()) {
+      SDL_Log("Occlusion test '%s': the face wasn't meshed", test.name);
+      failures++;
+    } else if (meshed->occlusion != test.expected || meshed->flip != test.flip) {
+      const auto &occlusion = meshed->occlusion;
+      SDL_Log("Occlusion test '%s': got %d %d %d %d%s", test.name, occlusion[0], occlusion[1], occlusion[2],
+              occlusion[3], meshed->flip ? ", flipped" : "");
+      failures++;
+    }
+  }
+  return failures;
+}
+
+// Terrain columns of a square of chunks plus a one column ring, chunk (0, 0) at its corner
+struct Patch {
+  int area = CHUNKS * SIZE + 2;
+  std::vector<u64> columns;
+
+  Patch(int seed) : columns(area * area) {
+    Terrain(seed).Region(-1, 0, -1, area, area, columns.data());
+  }
+
+  u64 Column(int x, int z) const {
+    return columns[(x + 1) * area + z + 1];
+  }
+};
+
+// A patch meshed by the chunks, whose caches must not be shared between runs or the meshes would be found there
+struct Meshed {
+  ChunkCache cache;
+  std::vector<std::unique_ptr<Chunk>> chunks;
+};
+
+struct Result {
+  bool occlusion = false;
+  size_t vertices = 0;
+  long flipped = 0;
+  long histogram[MAX_OCCLUSION + 1] = {};
+  float ms = 0.0f;
+  // Faces whose occlusion differs from the terrain's, and how many of those checked lie on the chunk border
+  int failures = 0;
+  long borderFaces = 0;
+};
+
+// Generates the patch chunk by chunk, the same as the workers do, and keeps the fastest run. Terrain and light are
+// part of the time, both runs generate the same of them.
+Result Measure(ChunkStore &store, const TextureAtlas &atlas, const Patch &patch, int seed, bool occlusion) {
+  Result result{.occlusion = occlusion};
+  std::unique_ptr<Meshed> meshed;
+  result.ms = 1e9f;
+  for (int run = 0; run < RUNS; ++run) {
+    meshed = std::make_unique<Meshed>();
+    auto start = SDL_GetPerformanceCounter();
+    for (int cx = 0; cx < CHUNKS; ++cx) {
+      for (int cz = 0; cz < CHUNKS; ++cz) {
+        auto chunk = std::make_unique<Chunk>(atlas, meshed->cache, nullptr, store, glm::ivec3(cx, 0, cz), seed);
+        chunk->mOcclusion = occlusion;
+        chunk->GenerateVertices();
+        meshed->chunks.push_back(std::move(chunk));
+      }
+    }
+    result.ms = std::min(result.ms, ElapsedMs(start));
+  }
+
+  for (const auto &chunk : meshed->chunks) {
+    glm::ivec3 origin = chunk->mPosition * SIZE;
+    auto solid = [&](const glm::ivec3 &p) {
+      return p.y >= 0 && p.y < SIZE && (patch.Column(origin.x + p.x, origin.z + p.z) >> p.y & 1);
+    };
+
+    result.vertices += chunk->VertexCount();
+    for (const auto &face : Faces(*chunk)) {
+      result.flipped += face.flip;
+      for (int i : QuadTriangles(face.flip)) {
+        result.histogram[face.occlusion[i]]++;
+      }
+
+      // Checked against the terrain itself, so the ring the chunk keeps in its light volume is checked too
+      Corners expected = {MAX_OCCLUSION, MAX_OCCLUSION, MAX_OCCLUSION, MAX_OCCLUSION};
+      if (occlusion) {
+        expected = FaceOcclusion(face.face, face.voxel, solid);
+      }
+      if (face.occlusion != expected || face.flip != FlipQuad(expected)) {
+        if (result.failures < 10) {
+          SDL_Log("Occlusion of the %d face of voxel (%d, %d, %d) in chunk (%d, %d) differs from the terrain",
+                  static_cast<int>(face.face), face.voxel.x, face.voxel.y, face.voxel.z, chunk->mPosition.x,
+                  chunk->mPosition.z);
+        }
+        result.failures++;
+      }
+      bool border = face.voxel.x == 0 || face.voxel.z == 0 || face.voxel.x == SIZE - 1 || face.voxel.z == SIZE - 1;
+      result.borderFaces += border;
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+bool RunOcclusionBenchmark(int seed, const std::string &path) {
+  std::string directory = path + ".store";
+  std::error_code error;
+  std::filesystem::remove_all(directory, error);
+
+  // Only texture coordinates are needed, no GL texture
+  TextureAtlas atlas(0, {{TextureType::Dirt, {0.0f, 0.5f}, {0.25f, 0.75f}}});
+  Patch patch(seed);
+  int failures = CheckCorners();
+  std::vector<Result> results;
+  {
+    ChunkStore store(directory);
+    failures += CheckCases(store, atlas, seed);
+    results = {Measure(store, atlas, patch, seed, false), Measure(store, atlas, patch, seed, true)};
+  }
+  std::filesystem::remove_all(directory, error);
+
+  for (const auto &result : results) {
+    failures += result.failures;
+    if (result.borderFaces == 0) {
+      SDL_Log("Occlusion test: no faces on the chunk borders were checked");
+      failures++;
+    }
+  }
+  SDL_Log("Occlusion tests: %d failures", failures);
+
+  BenchmarkCsv out(path);
+  if (!out.Ok()) {
+    return false;
+  }
+
+  int chunks = CHUNKS * CHUNKS;
+  out.Table("occlusion,chunks,vertices,ms,ms_per_chunk,flipped_quads,corners_0,corners_1,corners_2,corners_3");
+  for (const auto &result : results) {
+    const auto &corners = result.histogram;
+    out.Row(result.occlusion, chunks, result.vertices, result.ms, result.ms / chunks, result.flipped, corners[0],
+            corners[1], corners[2], corners[3]);
+    SDL_Log("Generating chunks %s occlusion: %.3f ms per chunk, %zu vertices, %ld quads flipped",
+            result.occlusion ? "with" : "without", result.ms / chunks, result.vertices, result.flipped);
+  }
+
+  return failures == 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+// Checks the ambient occlusion the chunks bake into their meshes: known corner configurations saved as chunks of
+// their own, then every face of a patch of terrain chunks, border faces included, against the terrain around it.
+// Reports the time to generate the patch with and without occlusion. Runs on the CPU only.
+bool RunOcclusionBenchmark(int seed, const std::string &path);
@@ -0,0 +1,276 @@
+#include "occlusion_culler.h"
+#include "SDL3/SDL_log.h"
+#include "core/gpu_profiler.h"
+#include "core/memory_tracker.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+
+// The pyramid read back from the GPU, for the CPU reference of the culling test
+struct Pyramid {
+  std::vector<glm::ivec2> sizes;
+  std::vector<std::vector<float>> levels;
+
+  float Fetch(int level, int x, int y) const {
+    return levels[level][y * sizes[level].x + x];
+  }
+};
+
+glm::vec3 Corner(const ChunkRecord &chunk, int i) {
+  return {(i & 1) ? chunk.boundsMax.x : chunk.boundsMin.x, (i & 2) ? chunk.boundsMax.y : chunk.boundsMin.y,
+          (i & 4) ? chunk.boundsMax.z : chunk.boundsMin.z};
+}
+
+// The rest of this namespace mirrors cull.comp, keep them in sync
+bool InFrustum(const ChunkRecord &chunk, const glm::mat4 &viewProjection) {
+  int outside[6] = {};
+  for (int i = 0; i < 8; ++i) {
+    auto clip = viewProjection * glm::vec4(Corner(chunk, i), 1.0f);
+    outside[0] += clip.x < -clip.w;
+    outside[1] += clip.x > clip.w;
+    outside[2] += clip.y < -clip.w;
+    outside[3] += clip.y > clip.w;
+    outside[4] += clip.z < -clip.w;
+    outside[5] += clip.z > clip.w;
+  }
+
+  return std::none_of(std::begin(outside), std::end(outside), [](int count) { return count == 8; });
+}
+
+bool Occluded(const ChunkRecord &chunk, const glm::mat4 &viewProjection, const Pyramid &pyramid) {
+  glm::vec2 minUv(1.0f), maxUv(0.0f);
+  float nearest = 1.0f;
+  for (int i = 0; i < 8; ++i) {
+    auto clip = viewProjection * glm::vec4(Corner(chunk, i), 1.0f);
+    if (clip.w <= 0.0f) {
+      return false;
+    }
+
+    glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    glm::vec2 uv = glm::vec2(ndc) * 0.5f + 0.5f;
+    minUv = glm::min(minUv, uv);
+    maxUv = glm::max(maxUv, uv);
+    nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+  }
+
+  minUv = glm::clamp(minUv, 0.0f, 1.0f);
+  maxUv = glm::clamp(maxUv, 0.0f, 1.0f);
+  glm::vec2 extent = (maxUv - minUv) * glm::vec2(pyramid.sizes[0]);
+  int levels = pyramid.sizes.size();
+  int level = std::clamp(static_cast<int>(std::ceil(std::log2(std::max(std::max(extent.x, extent.y), 1.0f)))), 0,
+                         levels - 1);
+  glm::ivec2 size = pyramid.sizes[level];
+  glm::ivec2 low = glm::clamp(glm::ivec2(minUv * glm::vec2(size)), glm::ivec2(0), size - 1);
+  glm::ivec2 high = glm::clamp(glm::ivec2(maxUv * glm::vec2(size)), glm::ivec2(0), size - 1);
+
+  float farthest = 0.0f;
+  for (int y = low.y; y <= high.y; ++y) {
+    for (int x = low.x; x <= high.x; ++x) {
+      farthest = std::max(farthest, pyramid.Fetch(level, x, y));
+    }
+  }
+
+  return nearest > farthest;
+}
+
+// Vertices of the face directions which can face the eye
+uint32_t FacingVertices(const ChunkRecord &chunk, const glm::vec3 &eye) {
+  unsigned faces = FacesTowards(eye, glm::vec3(chunk.boundsMin), glm::vec3(chunk.boundsMax));
+  uint32_t vertices = 0;
+  for (int i = 0; i < CUBE_FACES; ++i) {
+    vertices += faces & (1u << i) ? chunk.faces[i] : 0;
+  }
+  return vertices;
+}
+
+} // namespace
+
+OcclusionCuller::OcclusionCuller(std::unique_ptr<Shader> pyramidShader, std::unique_ptr<Shader> cullShader)
+    : mPyramidShader(std::move(pyramidShader)), mCullShader(std::move(cullShader)), mDepthTexture(0),
+      mDepthFramebuffer(0), mPyramid(0), mPyramidSize(0), mPyramidLevels(0), mPyramidViewProjection(1.0f),
+      mVerify(false), mVerifiedFrames(0), mVerifiedChunks(0), mMismatches(0), mOccluded(0) {
+  glCreateBuffers(1, &mChunkBuffer);
+  glNamedBufferStorage(mChunkBuffer, MAX_CHUNKS * sizeof(ChunkRecord), nullptr, GL_DYNAMIC_STORAGE_BIT);
+  glCreateBuffers(1, &mCommandBuffer);
+  glNamedBufferStorage(mCommandBuffer, MAX_DRAWS * sizeof(DrawCommand), nullptr, 0);
+  glCreateBuffers(1, &mCountBuffer);
+  glNamedBufferStorage(mCountBuffer, sizeof(uint32_t), nullptr, GL_DYNAMIC_STORAGE_BIT);
+  MemoryTracker::RegisterBuffer(mChunkBuffer, GpuTag::Culling, MAX_CHUNKS * sizeof(ChunkRecord));
+  MemoryTracker::RegisterBuffer(mCommandBuffer, GpuTag::Culling, MAX_DRAWS * sizeof(DrawCommand));
+  MemoryTracker::RegisterBuffer(mCountBuffer, GpuTag::Culling, sizeof(uint32_t));
+}
+
+OcclusionCuller::~OcclusionCuller() {
+  DestroyPyramid();
+  MemoryTracker::ReleaseBuffer(mChunkBuffer);
+  MemoryTracker::ReleaseBuffer(mCommandBuffer);
+  MemoryTracker::ReleaseBuffer(mCountBuffer);
+  glDeleteBuffers(1, &mChunkBuffer);
+  glDeleteBuffers(1, &mCommandBuffer);
+  glDeleteBuffers(1, &mCountBuffer);
+
+  if (mVerify && mVerifiedFrames > 0) {
+    SDL_Log("Occlusion culling verified over %d frames: %ld chunks tested, %ld occluded, %ld mismatches",
+            mVerifiedFrames, mVerifiedChunks, mOccluded, mMismatches);
+  }
+}
+
+void OcclusionCuller::SetVerify(bool verify) {
+  mVerify = verify;
+}
+
+void OcclusionCuller::Draw(const Shader &shader, const MeshPool &pool, const std::vector<ChunkRecord> &chunks,
+                           const glm::mat4 &viewProjection, const glm::vec3 &eye) {
+  size_t count = std::min(chunks.size(), static_cast<size_t>(MAX_CHUNKS));
+  if (count == 0) {
+    return;
+  }
+
+  uint32_t zero = 0;
+  glNamedBufferSubData(mChunkBuffer, 0, count * sizeof(ChunkRecord), chunks.data());
+  glNamedBufferSubData(mCountBuffer, 0, sizeof(zero), &zero);
+
+  mCullShader->Bind();
+  mCullShader->UniformMat4("viewProjection", viewProjection);
+  mCullShader->UniformMat4("pyramidViewProjection", mPyramidViewProjection);
+  mCullShader->UniformInt("chunkCount", count);
+  mCullShader->UniformInt("hasPyramid", mPyramid != 0);
+  mCullShader->UniformVec3("eye", eye);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mChunkBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mCommandBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mCountBuffer);
+  glBindTextureUnit(1, mPyramid);
+  glDispatchCompute((count + 63) / 64, 1, 1);
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+  if (mVerify) {
+    Verify(chunks, count, viewProjection, eye);
+  }
+
+  // basic.vert reads the chunk origins from binding 0, indexed by the base instance of each draw
+  shader.Bind();
+  shader.UniformInt("indirect", 1);
+  glBindVertexArray(pool.VertexArray());
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+  glBindBuffer(GL_PARAMETER_BUFFER, mCountBuffer);
+  if (GLEW_VERSION_4_6) {
+    glMultiDrawArraysIndirectCount(GL_TRIANGLES, nullptr, 0, count * CUBE_FACES, 0);
+  } else {
+    glMultiDrawArraysIndirectCountARB(GL_TRIANGLES, nullptr, 0, count * CUBE_FACES, 0);
+  }
+  // The number of draws and triangles is only known on the GPU
+  GpuProfiler::CountStateChange();
+  GpuProfiler::CountDraw(0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  glBindBuffer(GL_PARAMETER_BUFFER, 0);
+  glBindVertexArray(0);
+}
+
+void OcclusionCuller::BuildPyramid(const glm::mat4 &viewProjection) {
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glm::ivec2 size{viewport[2], viewport[3]};
+  if (size.x <= 0 || size.y <= 0) {
+    return;
+  }
+
+  if (size != mPyramidSize) {
+    DestroyPyramid();
+    CreatePyramid(size);
+  }
+
+  // Resolves the multisampled depth buffer, the values come from a single sample
+  glBlitNamedFramebuffer(0, mDepthFramebuffer, 0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_DEPTH_BUFFER_BIT,
+                         GL_NEAREST);
+
+  mPyramidShader->Bind();
+  glm::ivec2 levelSize = size;
+  for (int level = 0; level < mPyramidLevels; ++level) {
+    glBindTextureUnit(1, level == 0 ? mDepthTexture : mPyramid);
+    mPyramidShader->UniformInt("sourceLevel", std::max(level - 1, 0));
+    mPyramidShader->UniformInt("reduce", level > 0);
+    glBindImageTexture(0, mPyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute((levelSize.x + 7) / 8, (levelSize.y + 7) / 8, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    levelSize = glm::max(levelSize / 2, glm::ivec2(1));
+  }
+  mPyramidShader->Unbind();
+
+  mPyramidViewProjection = viewProjection;
+}
+
+void OcclusionCuller::CreatePyramid(const glm::ivec2 &size) {
+  mPyramidSize = size;
+  mPyramidLevels = static_cast<int>(std::floor(std::log2(std::max(size.x, size.y)))) + 1;
+
+  // Has to match the format of the default framebuffer's depth buffer for the blit
+  glCreateTextures(GL_TEXTURE_2D, 1, &mDepthTexture);
+  glTextureStorage2D(mDepthTexture, 1, GL_DEPTH_COMPONENT24, size.x, size.y);
+  // Drivers store 24 bit depth in 32 bits
+  MemoryTracker::RegisterTexture(mDepthTexture, GpuTag::Culling, MemoryTracker::TextureBytes(size.x, size.y, 1, 4));
+  glCreateFramebuffers(1, &mDepthFramebuffer);
+  glNamedFramebufferTexture(mDepthFramebuffer, GL_DEPTH_ATTACHMENT, mDepthTexture, 0);
+
+  glCreateTextures(GL_TEXTURE_2D, 1, &mPyramid);
+  glTextureStorage2D(mPyramid, mPyramidLevels, GL_R32F, size.x, size.y);
+  MemoryTracker::RegisterTexture(mPyramid, GpuTag::Culling,
+                                 MemoryTracker::TextureBytes(size.x, size.y, mPyramidLevels, 4));
+  glTextureParameteri(mPyramid, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+  glTextureParameteri(mPyramid, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void OcclusionCuller::DestroyPyramid() {
+  glDeleteFramebuffers(1, &mDepthFramebuffer);
+  MemoryTracker::ReleaseTexture(mDepthTexture);
+  MemoryTracker::ReleaseTexture(mPyramid);
+  glDeleteTextures(1, &mDepthTexture);
+  glDeleteTextures(1, &mPyramid);
+  mDepthFramebuffer = mDepthTexture = mPyramid = 0;
+  mPyramidSize = {0, 0};
+  mPyramidLevels = 0;
+}
+
+void OcclusionCuller::Verify(const std::vector<ChunkRecord> &chunks, size_t count, const glm::mat4 &viewProjection,
+                             const glm::vec3 &eye) {
+  uint32_t drawn = 0;
+  glGetNamedBufferSubData(mCountBuffer, 0, sizeof(drawn), &drawn);
+  std::vector<DrawCommand> commands(drawn);
+  glGetNamedBufferSubData(mCommandBuffer, 0, drawn * sizeof(DrawCommand), commands.data());
+  // Vertices drawn of each chunk, summed over its face ranges
+  std::unordered_map<uint32_t, uint32_t> vertices;
+  for (const auto &command : commands) {
+    vertices[command.baseInstance] += command.count;
+  }
+
+  Pyramid pyramid;
+  glm::ivec2 size = mPyramidSize;
+  for (int level = 0; level < mPyramidLevels; ++level) {
+    pyramid.sizes.push_back(size);
+    pyramid.levels.emplace_back(size.x * size.y);
+    glGetTextureImage(mPyramid, level, GL_RED, GL_FLOAT, size.x * size.y * sizeof(float),
+                      pyramid.levels.back().data());
+    size = glm::max(size / 2, glm::ivec2(1));
+  }
+
+  int mismatches = 0;
+  for (size_t i = 0; i < count; ++i) {
+    bool expected = InFrustum(chunks[i], viewProjection);
+    if (expected && mPyramid != 0 && Occluded(chunks[i], mPyramidViewProjection, pyramid)) {
+      expected = false;
+      mOccluded++;
+    }
+
+    uint32_t facing = expected ? FacingVertices(chunks[i], eye) : 0;
+    auto found = vertices.find(i);
+    mismatches += facing != (found != vertices.end() ? found->second : 0);
+  }
+
+  mVerifiedFrames++;
+  mVerifiedChunks += count;
+  mMismatches += mismatches;
+  if (mismatches > 0) {
+    SDL_Log("Occlusion culling: %d of %zu chunks differ from the CPU reference", mismatches, count);
+  }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "core/shader.h"
+#include "cube.h"
+#include "mesh_pool.h"
+#include <GL/glew.h>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+// Layout shared with cull.comp and basic.vert (std430)
+struct ChunkRecord {
+  glm::vec4 origin;
+  glm::vec4 boundsMin;
+  glm::vec4 boundsMax;
+  uint32_t first;
+  uint32_t count;
+  // Vertices of each face direction, they follow each other from first on in CubeFace order
+  uint32_t faces[CUBE_FACES];
+};
+
+// GPU driven chunk rendering. Every frame a compute shader tests each chunk's bounds against the view frustum and
+// against a depth pyramid (Hi-Z) built from the previous frame's depth buffer, and writes the draws of the visible
+// chunks into a compacted indirect buffer, which is then drawn with a single glMultiDrawArraysIndirectCount. A visible
+// chunk only draws the face directions which can face the eye.
+class OcclusionCuller {
+public:
+  static const size_t MAX_CHUNKS = 4096;
+  // A chunk draws at most one range per face direction
+  static const size_t MAX_DRAWS = MAX_CHUNKS * CUBE_FACES;
+
+  OcclusionCuller(std::unique_ptr<Shader> pyramidShader, std::unique_ptr<Shader> cullShader);
+  ~OcclusionCuller();
+
+  // Reads the GPU results back every frame and compares them with the same test run on the CPU. Slow, for checking
+  // the culling (e.g. on llvmpipe in headless mode).
+  void SetVerify(bool verify);
+
+  // Culls and draws the chunks with the given shader, which is left bound
+  void Draw(const Shader &shader, const MeshPool &pool, const std::vector<ChunkRecord> &chunks,
+            const glm::mat4 &viewProjection, const glm::vec3 &eye);
+  // Builds next frame's depth pyramid from the depth buffer as it is now
+  void BuildPyramid(const glm::mat4 &viewProjection);
+
+private:
+  struct DrawCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t first;
+    uint32_t baseInstance;
+  };
+
+  std::unique_ptr<Shader> mPyramidShader, mCullShader;
+  GLuint mChunkBuffer, mCommandBuffer, mCountBuffer;
+
+  // Single sampled copy of the depth buffer and the pyramid of farthest depths built from it
+  GLuint mDepthTexture, mDepthFramebuffer, mPyramid;
+  glm::ivec2 mPyramidSize;
+  int mPyramidLevels;
+  // The matrix the pyramid was rendered with, chunks are projected with it for the occlusion test
+  glm::mat4 mPyramidViewProjection;
+
+  bool mVerify;
+  int mVerifiedFrames;
+  long mVerifiedChunks, mMismatches, mOccluded;
+
+  void CreatePyramid(const glm::ivec2 &size);
+  void DestroyPyramid();
+  void Verify(const std::vector<ChunkRecord> &chunks, size_t count, const glm::mat4 &viewProjection,
+              const glm::vec3 &eye);
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "voxel_grid.h"
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <span>
+
+struct Aabb {
+  glm::vec3 min, max;
+};
+
+// A box moving through the voxels. A sweep moves it by velocity * dt and zeroes the velocity on every axis it hit.
+struct Body {
+  Aabb box;
+  glm::vec3 velocity;
+  // Set when the last sweep stopped the body moving down
+  bool grounded;
+};
+
+// Collision works on world columns: columns(x, z) returns the solid voxels of the column at world (x, z) with bit y
+// set for a solid voxel, like a VoxelGrid column. Everything below y = 0 is solid, everything above the column is air.
+//
+// Boxes are moved one axis at a time (y, then x, then z). Instead of testing the voxels a box sweeps through one by
+// one, every column it touches is tested with a single AND against the bits of the y range it covers.
+
+// Gap left between a box and the voxel it stopped against, so float rounding never leaves it inside the voxel
+static constexpr float SWEEP_SKIN = 1e-3f;
+
+// Cells overlapped by the interval [min, max), touching a cell boundary doesn't count
+inline int FirstCell(float min) {
+  return static_cast<int>(std::floor(min));
+}
+
+inline int LastCell(float max) {
+  return static_cast<int>(std::ceil(max)) - 1;
+}
+
+// Bits first to last of a column, clipped to the column height
+inline u64 ColumnRange(int first, int last) {
+  first = std::max(first, 0);
+  last = std::min(last, VoxelGrid::SIZE - 1);
+  if (first > last) {
+    return 0;
+  }
+
+  int width = last - first + 1;
+  u64 bits = width == VoxelGrid::SIZE ? ~static_cast<u64>(0) : (static_cast<u64>(1) << width) - 1;
+  return bits << first;
+}
+
+// How far the box can move along y before it runs into a solid voxel, at most distance
+template <typename Columns> float SweepVertical(const Columns &columns, const Aabb &box, float distance) {
+  bool up = distance > 0.0f;
+  int first = up ? LastCell(box.max.y) + 1 : FirstCell(box.min.y + distance);
+  int last = up ? LastCell(box.max.y + distance) : FirstCell(box.min.y) - 1;
+  if (first > last) {
+    return distance;
+  }
+
+  u64 range = ColumnRange(first, last);
+  int blocker = up ? INT_MAX : (first < 0 ? -1 : INT_MIN);
+  if (range != 0) {
+    for (int x = FirstCell(box.min.x); x <= LastCell(box.max.x); ++x) {
+      for (int z = FirstCell(box.min.z); z <= LastCell(box.max.z); ++z) {
+        u64 hits = columns(x, z) & range;
+        if (hits == 0) {
+          continue;
+        }
+
+        blocker = up ? std::min(blocker, std::countr_zero(hits)) : std::max(blocker, 63 - std::countl_zero(hits));
+      }
+    }
+  }
+
+  if (up) {
+    return blocker == INT_MAX ? distance : std::max(0.0f, blocker - box.max.y - SWEEP_SKIN);
+  }
+  return blocker == INT_MIN ? distance : std::min(0.0f, blocker + 1 - box.min.y + SWEEP_SKIN);
+}
+
+// How far the box can move along x (axis 0) or z (axis 2) before it runs into a solid voxel, at most distance
+template <typename Columns>
+float SweepHorizontal(const Columns &columns, const Aabb &box, int axis, float distance) {
+  int cross = 2 - axis;
+  int step = distance > 0.0f ? 1 : -1;
+  int first = step > 0 ? LastCell(box.max[axis]) + 1 : FirstCell(box.min[axis]) - 1;
+  int last = step > 0 ? LastCell(box.max[axis] + distance) : FirstCell(box.min[axis] + distance);
+
+  // A box reaching below the world is blocked by every column
+  u64 range = ColumnRange(FirstCell(box.min.y), LastCell(box.max.y));
+  bool belowWorld = FirstCell(box.min.y) < 0;
+
+  for (int cell = first; cell * step <= last * step; cell += step) {
+    for (int c = FirstCell(box.min[cross]); c <= LastCell(box.max[cross]); ++c) {
+      u64 column = axis == 0 ? columns(cell, c) : columns(c, cell);
+      if (belowWorld || (column & range) != 0) {
+        return step > 0 ? std::max(0.0f, cell - box.max[axis] - SWEEP_SKIN)
+                        : std::min(0.0f, cell + 1 - box.min[axis] + SWEEP_SKIN);
+      }
+    }
+  }
+
+  return distance;
+}
+
+template <typename Columns> void SweepBody(const Columns &columns, Body &body, float dt) {
+  body.grounded = false;
+  for (int axis : {1, 0, 2}) {
+    float distance = body.velocity[axis] * dt;
+    if (distance == 0.0f) {
+      continue;
+    }
+
+    float moved = axis == 1 ? SweepVertical(columns, body.box, distance)
+                            : SweepHorizontal(columns, body.box, axis, distance);
+    body.box.min[axis] += moved;
+    body.box.max[axis] += moved;
+    if (moved != distance) {
+      body.grounded = body.grounded || (axis == 1 && distance < 0.0f);
+      body.velocity[axis] = 0.0f;
+    }
+  }
+}
+
+// Batched version for many entities per tick, the column lookup is inlined into a single loop over the bodies
+template <typename Columns> void SweepBodies(const Columns &columns, std::span<Body> bodies, float dt) {
+  for (auto &body : bodies) {
+    SweepBody(columns, body, dt);
+  }
+}
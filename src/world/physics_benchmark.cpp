@@ -0,0 +1,217 @@
+#include "physics_benchmark.h"
+#include "SDL3/SDL_log.h"
+#include "core/benchmark.h"
+#include "physics.h"
+#include "terrain.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Bodies walk over a patch of this many columns, everything outside of it is air
+const int AREA = 256;
+const int STEPS = 200;
+const int RUNS = 3;
+const int VERIFY_BODIES = 2000;
+const float GRAVITY = 0.08f;
+
+struct Patch {
+  std::vector<u64> columns;
+
+  u64 operator()(int x, int z) const {
+    if (x < 0 || z < 0 || x >= AREA || z >= AREA) {
+      return 0;
+    }
+    return columns[x * AREA + z];
+  }
+
+  bool Solid(int x, int y, int z) const {
+    if (y < 0) {
+      return true;
+    }
+    return y < VoxelGrid::SIZE && ((*this)(x, z) & (static_cast<u64>(1) << y));
+  }
+};
+
+// The same sweep with every voxel the box moves into tested on its own
+float ReferenceSweep(const Patch &patch, const Aabb &box, int axis, float distance) {
+  int step = distance > 0.0f ? 1 : -1;
+  int first = step > 0 ? LastCell(box.max[axis]) + 1 : FirstCell(box.min[axis]) - 1;
+  int last = step > 0 ? LastCell(box.max[axis] + distance) : FirstCell(box.min[axis] + distance);
+
+  for (int cell = first; cell * step <= last * step; cell += step) {
+    glm::ivec3 min{FirstCell(box.min.x), FirstCell(box.min.y), FirstCell(box.min.z)};
+    glm::ivec3 max{LastCell(box.max.x), LastCell(box.max.y), LastCell(box.max.z)};
+    min[axis] = max[axis] = cell;
+
+    for (int x = min.x; x <= max.x; ++x) {
+      for (int y = min.y; y <= max.y; ++y) {
+        for (int z = min.z; z <= max.z; ++z) {
+          if (patch.Solid(x, y, z)) {
+            return step > 0 ? std::max(0.0f, cell - box.max[axis] - SWEEP_SKIN)
+                            : std::min(0.0f, cell + 1 - box.min[axis] + SWEEP_SKIN);
+          }
+        }
+      }
+    }
+  }
+
+  return distance;
+}
+
+void ReferenceBody(const Patch &patch, Body &body, float dt) {
+  body.grounded = false;
+  for (int axis : {1, 0, 2}) {
+    float distance = body.velocity[axis] * dt;
+    if (distance == 0.0f) {
+      continue;
+    }
+
+    float moved = ReferenceSweep(patch, body.box, axis, distance);
+    body.box.min[axis] += moved;
+    body.box.max[axis] += moved;
+    if (moved != distance) {
+      body.grounded = body.grounded || (axis == 1 && distance < 0.0f);
+      body.velocity[axis] = 0.0f;
+    }
+  }
+}
+
+// Player sized boxes dropped somewhere above the terrain, some of them starting well inside the air above it
+std::vector<Body> SpawnBodies(const Patch &patch, int count, std::mt19937 &random) {
+  std::uniform_real_distribution<float> position(8.0f, AREA - 8.0f);
+  std::uniform_real_distribution<float> lift(0.0f, 8.0f);
+  std::uniform_real_distribution<float> speed(-0.6f, 0.6f);
+
+  std::vector<Body> bodies;
+  bodies.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    glm::vec3 min{position(random), 0.0f, position(random)};
+    int top = 0;
+    for (int x = FirstCell(min.x); x <= LastCell(min.x + 0.6f); ++x) {
+      for (int z = FirstCell(min.z); z <= LastCell(min.z + 0.6f); ++z) {
+        top = std::max(top, VoxelGrid::SIZE - std::countl_zero(patch(x, z)));
+      }
+    }
+    min.y = top + SWEEP_SKIN + lift(random);
+    bodies.push_back({{min, min + glm::vec3(0.6f, 1.8f, 0.6f)}, {speed(random), 0.0f, speed(random)}, false});
+  }
+
+  return bodies;
+}
+
+// Gravity plus a new walking direction every now and then, so bodies keep running into walls
+void Steer(std::span<Body> bodies, int step, std::mt19937 &random) {
+  std::uniform_real_distribution<float> speed(-0.6f, 0.6f);
+  for (auto &body : bodies) {
+    body.velocity.y -= GRAVITY;
+    if (step % 20 == 0) {
+      body.velocity.x = speed(random);
+      body.velocity.z = speed(random);
+      if (body.grounded) {
+        body.velocity.y = 0.5f;
+      }
+    }
+  }
+}
+
+int Verify(const Patch &patch, int seed) {
+  std::mt19937 random(seed);
+  auto bodies = SpawnBodies(patch, VERIFY_BODIES, random);
+  auto reference = bodies;
+
+  int mismatches = 0;
+  for (int step = 0; step < STEPS; ++step) {
+    std::mt19937 steering(seed + step);
+    Steer(bodies, step, steering);
+    steering.seed(seed + step);
+    Steer(reference, step, steering);
+
+    SweepBodies(patch, std::span<Body>(bodies), 1.0f);
+    for (size_t i = 0; i < bodies.size(); ++i) {
+      ReferenceBody(patch, reference[i], 1.0f);
+      const auto &a = bodies[i];
+      const auto &b = reference[i];
+      if (a.box.min != b.box.min || a.box.max != b.box.max || a.velocity != b.velocity || a.grounded != b.grounded) {
+        if (mismatches < 10) {
+          SDL_Log("Physics mismatch: body %zu step %d at (%.4f, %.4f, %.4f), reference (%.4f, %.4f, %.4f)", i, step,
+                  a.box.min.x, a.box.min.y, a.box.min.z, b.box.min.x, b.box.min.y, b.box.min.z);
+        }
+        mismatches++;
+        // Keep comparing from the same state
+        reference[i] = bodies[i];
+      }
+    }
+  }
+
+  return mismatches;
+}
+
+struct Result {
+  int entities = 0;
+  float ms = 0.0f;
+  float referenceMs = 0.0f;
+};
+
+template <typename Sweep> float Measure(const Patch &patch, int seed, int entities, Sweep &&sweep) {
+  float best = 1e9f;
+  for (int run = 0; run < RUNS; ++run) {
+    std::mt19937 random(seed);
+    auto bodies = SpawnBodies(patch, entities, random);
+
+    // Steering isn't part of the measurement
+    uint64_t ticks = 0;
+    for (int step = 0; step < STEPS; ++step) {
+      Steer(bodies, step, random);
+      auto start = SDL_GetPerformanceCounter();
+      sweep(std::span<Body>(bodies));
+      ticks += SDL_GetPerformanceCounter() - start;
+    }
+    best = std::min(best, TicksToMs(ticks));
+  }
+
+  return best;
+}
+
+} // namespace
+
+bool RunPhysicsBenchmark(int seed, const std::string &path) {
+  Patch patch;
+  patch.columns.resize(AREA * AREA);
+  Terrain(seed).Region(0, 0, 0, AREA, AREA, patch.columns.data());
+
+  int mismatches = Verify(patch, seed);
+  SDL_Log("Physics verification: %d bodies, %d steps, %d mismatches against the per voxel reference", VERIFY_BODIES,
+          STEPS, mismatches);
+
+  std::vector<Result> results;
+  for (int entities : {1000, 10000}) {
+    Result result;
+    result.entities = entities;
+    result.ms = Measure(patch, seed, entities, [&](std::span<Body> bodies) { SweepBodies(patch, bodies, 1.0f); });
+    result.referenceMs = Measure(patch, seed, entities, [&](std::span<Body> bodies) {
+      for (auto &body : bodies) {
+        ReferenceBody(patch, body, 1.0f);
+      }
+    });
+    results.push_back(result);
+  }
+
+  BenchmarkCsv out(path);
+  if (!out.Ok()) {
+    return false;
+  }
+
+  out.Table("entities,steps,sweep_ms,entity_steps_per_second,reference_ms,reference_entity_steps_per_second");
+  for (const auto &result : results) {
+    float steps = static_cast<float>(result.entities) * STEPS;
+    float perSecond = steps / std::max(result.ms, 0.001f) * 1000.0f;
+    float referencePerSecond = steps / std::max(result.referenceMs, 0.001f) * 1000.0f;
+    out.Row(result.entities, STEPS, result.ms, perSecond, result.referenceMs, referencePerSecond);
+    SDL_Log("Physics benchmark %d entities: %.2f ms for %d steps (%.2fM entity steps/s), reference %.2f ms (%.2fM/s)",
+            result.entities, result.ms, STEPS, perSecond / 1e6f, result.referenceMs, referencePerSecond / 1e6f);
+  }
+
+  return mismatches == 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// Checks the bitmask sweep against a per voxel reference on random bodies walking over a patch of terrain, then
+// measures how many entity steps per second it manages with 1k and 10k entities. Runs on the CPU only.
+bool RunPhysicsBenchmark(int seed, const std::string &path);
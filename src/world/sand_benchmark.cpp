@@ -0,0 +1,287 @@
+#include "sand_benchmark.h"
+#include "SDL3/SDL_cpuinfo.h"
+#include "SDL3/SDL_log.h"
+#include "core/benchmark.h"
+#include "sand_simulation.h"
+#include "terrain.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+const int SIZE = VoxelGrid::SIZE;
+// Chunks per side of the patch the simulation is checked on, the reference is slow
+const int VERIFY_CHUNKS = 4;
+const int VERIFY_TICKS = 96;
+const int BENCH_CHUNKS = 16;
+const int BENCH_TICKS = 200;
+// Piles dropped onto every chunk
+const int PILES = 48;
+
+// Terrain columns of a square of chunks, chunk (0, 0) at its corner
+struct Patch {
+  int chunks;
+  int area;
+  std::vector<u64> columns;
+
+  Patch(int seed, int chunks) : chunks(chunks), area(chunks * SIZE), columns(area * area) {
+    Terrain(seed).Region(0, 0, 0, area, area, columns.data());
+  }
+
+  u64 Column(int x, int z) const {
+    return columns[x * area + z];
+  }
+
+  VoxelGrid Grid(int cx, int cz) const {
+    VoxelGrid grid;
+    for (int x = 0; x < SIZE; ++x) {
+      for (int z = 0; z < SIZE; ++z) {
+        grid.columns[x * SIZE + z] = Column(cx * SIZE + x, cz * SIZE + z);
+      }
+    }
+    return grid;
+  }
+};
+
+// Columns of sand a few voxels above the ground, they fall and then spread into heaps
+std::vector<glm::ivec3> Piles(const Patch &patch, int seed) {
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<int> position(0, patch.area - 1);
+  std::uniform_int_distribution<int> lift(0, 6);
+  std::uniform_int_distribution<int> height(4, 24);
+
+  std::vector<glm::ivec3> voxels;
+  for (int i = 0; i < PILES * patch.chunks * patch.chunks; ++i) {
+    int x = position(random);
+    int z = position(random);
+    int bottom = SIZE - std::countl_zero(patch.Column(x, z)) + lift(random);
+    int top = std::min(bottom + height(random), SIZE);
+    for (int y = bottom; y < top; ++y) {
+      voxels.push_back({x, y, z});
+    }
+  }
+  return voxels;
+}
+
+// The same rules, voxel by voxel, on every chunk in every tick
+class Reference {
+public:
+  Reference(const Patch &patch) : mChunks(patch.chunks), mArea(patch.area), mSolid(Voxels()), mSand(Voxels()) {
+    for (int x = 0; x < mArea; ++x) {
+      for (int z = 0; z < mArea; ++z) {
+        for (int y = 0; y < SIZE; ++y) {
+          mSolid[Index(x, y, z)] = (patch.Column(x, z) >> y) & 1;
+        }
+      }
+    }
+  }
+
+  bool AddSand(const glm::ivec3 &voxel) {
+    if (voxel.y < 0 || voxel.y >= SIZE || Occupied(voxel.x, voxel.y, voxel.z)) {
+      return false;
+    }
+    mSand[Index(voxel.x, voxel.y, voxel.z)] = 1;
+    return true;
+  }
+
+  void Tick(int tick) {
+    for (int parity = 0; parity < 4; ++parity) {
+      for (int cx = 0; cx < mChunks; ++cx) {
+        for (int cz = 0; cz < mChunks; ++cz) {
+          if (((cx & 1) | (cz & 1) << 1) == parity) {
+            Step(cx, cz, tick % 4);
+          }
+        }
+      }
+    }
+  }
+
+  u64 Column(int x, int z) const {
+    u64 column = 0;
+    for (int y = 0; y < SIZE; ++y) {
+      column |= static_cast<u64>(mSand[Index(x, y, z)]) << y;
+    }
+    return column;
+  }
+
+private:
+  int mChunks, mArea;
+  std::vector<uint8_t> mSolid, mSand;
+
+  std::vector<uint8_t> Voxels() const {
+    return std::vector<uint8_t>(static_cast<size_t>(mArea) * mArea * SIZE);
+  }
+
+  size_t Index(int x, int y, int z) const {
+    return (static_cast<size_t>(x) * mArea + z) * SIZE + y;
+  }
+
+  bool Occupied(int x, int y, int z) const {
+    return mSolid[Index(x, y, z)] || mSand[Index(x, y, z)];
+  }
+
+  void Step(int cx, int cz, int direction) {
+    // Bottom up, so a falling run moves as a whole
+    for (int x = cx * SIZE; x < (cx + 1) * SIZE; ++x) {
+      for (int z = cz * SIZE; z < (cz + 1) * SIZE; ++z) {
+        for (int y = 1; y < SIZE; ++y) {
+          if (mSand[Index(x, y, z)] && !Occupied(x, y - 1, z)) {
+            mSand[Index(x, y, z)] = 0;
+            mSand[Index(x, y - 1, z)] = 1;
+          }
+        }
+      }
+    }
+
+    // +x, -x, +z, -z, decided on the voxels before any of them slides
+    const glm::ivec2 offsets[] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    glm::ivec2 offset = offsets[direction];
+    std::vector<glm::ivec3> slides;
+    for (int x = cx * SIZE; x < (cx + 1) * SIZE; ++x) {
+      for (int z = cz * SIZE; z < (cz + 1) * SIZE; ++z) {
+        int tx = x + offset.x;
+        int tz = z + offset.y;
+        if (tx < 0 || tz < 0 || tx >= mArea || tz >= mArea) {
+          continue;
+        }
+
+        for (int y = 1; y < SIZE; ++y) {
+          if (mSand[Index(x, y, z)] && Occupied(x, y - 1, z) && !Occupied(tx, y, tz) && !Occupied(tx, y - 1, tz)) {
+            slides.push_back({x, y, z});
+          }
+        }
+      }
+    }
+
+    for (const auto &voxel : slides) {
+      mSand[Index(voxel.x, voxel.y, voxel.z)] = 0;
+      mSand[Index(voxel.x + offset.x, voxel.y - 1, voxel.z + offset.y)] = 1;
+    }
+  }
+};
+
+int WorkerThreads() {
+  return std::max(1, SDL_GetNumLogicalCPUCores() - 1);
+}
+
+void Fill(SandSimulation &simulation, const Patch &patch, const std::vector<glm::ivec3> &sand) {
+  for (int cx = 0; cx < patch.chunks; ++cx) {
+    for (int cz = 0; cz < patch.chunks; ++cz) {
+      simulation.AddChunk({cx, cz}, patch.Grid(cx, cz));
+    }
+  }
+  for (const auto &voxel : sand) {
+    simulation.AddSand(voxel);
+  }
+}
+
+// Chunks whose sand differs from the reference
+int Compare(const SandSimulation &simulation, const Reference &reference, const Patch &patch) {
+  int mismatches = 0;
+  for (int cx = 0; cx < patch.chunks; ++cx) {
+    for (int cz = 0; cz < patch.chunks; ++cz) {
+      const VoxelGrid *sand = simulation.Sand({cx, cz});
+      bool same = sand != nullptr;
+      for (int x = 0; x < SIZE && same; ++x) {
+        for (int z = 0; z < SIZE && same; ++z) {
+          same = sand->columns[x * SIZE + z] == reference.Column(cx * SIZE + x, cz * SIZE + z);
+        }
+      }
+      mismatches += !same;
+    }
+  }
+  return mismatches;
+}
+
+struct Result {
+  int threads = 0;
+  long chunkTicks = 0;
+  long moved = 0;
+  float ms = 0.0f;
+  int activeAtEnd = 0;
+};
+
+} // namespace
+
+bool RunSandBenchmark(int seed, const std::string &path) {
+  // Verification: the reference updates every chunk, so it also checks that resting chunks are skipped correctly
+  Patch small(seed, VERIFY_CHUNKS);
+  auto smallSand = Piles(small, seed);
+  Reference reference(small);
+  SandSimulation single(0), threaded(WorkerThreads());
+  Fill(single, small, smallSand);
+  Fill(threaded, small, smallSand);
+  for (const auto &voxel : smallSand) {
+    reference.AddSand(voxel);
+  }
+
+  int mismatches = 0;
+  long verifyChunkTicks = 0;
+  Uint64 referenceTicks = 0;
+  for (int tick = 0; tick < VERIFY_TICKS; ++tick) {
+    auto start = SDL_GetPerformanceCounter();
+    reference.Tick(tick);
+    referenceTicks += SDL_GetPerformanceCounter() - start;
+    single.Tick();
+    threaded.Tick();
+    verifyChunkTicks += single.GetStats().chunkTicks;
+
+    int singleMismatches = Compare(single, reference, small);
+    int threadedMismatches = Compare(threaded, reference, small);
+    if ((singleMismatches > 0 || threadedMismatches > 0) && mismatches < 10) {
+      SDL_Log("Sand mismatch in tick %d: %d chunks single threaded, %d threaded", tick, singleMismatches,
+              threadedMismatches);
+    }
+    mismatches += singleMismatches + threadedMismatches;
+  }
+  float referenceChunkTicks = static_cast<float>(VERIFY_CHUNKS * VERIFY_CHUNKS) * VERIFY_TICKS;
+  SDL_Log("Sand verification: %d chunks, %d ticks (%ld chunk ticks simulated), %d mismatches against the per voxel "
+          "reference",
+          VERIFY_CHUNKS * VERIFY_CHUNKS, VERIFY_TICKS, verifyChunkTicks, mismatches);
+
+  Patch large(seed, BENCH_CHUNKS);
+  auto largeSand = Piles(large, seed);
+  std::vector<Result> results;
+  for (int threads : {0, WorkerThreads()}) {
+    SandSimulation simulation(threads);
+    Fill(simulation, large, largeSand);
+
+    Result result;
+    result.threads = threads;
+    Uint64 ticks = 0;
+    for (int tick = 0; tick < BENCH_TICKS; ++tick) {
+      auto start = SDL_GetPerformanceCounter();
+      simulation.Tick();
+      ticks += SDL_GetPerformanceCounter() - start;
+      result.chunkTicks += simulation.GetStats().chunkTicks;
+      result.moved += simulation.GetStats().moved;
+    }
+    result.ms = TicksToMs(ticks);
+    result.activeAtEnd = simulation.ActiveChunks();
+    results.push_back(result);
+  }
+
+  BenchmarkCsv out(path);
+  if (!out.Ok()) {
+    return false;
+  }
+
+  out.Table("threads,chunks,ticks,chunk_ticks,moved_voxels,ms,chunk_ticks_per_second,active_at_end");
+  for (const auto &result : results) {
+    float perSecond = result.chunkTicks / std::max(result.ms, 0.001f) * 1000.0f;
+    out.Row(result.threads, BENCH_CHUNKS * BENCH_CHUNKS, BENCH_TICKS, result.chunkTicks, result.moved, result.ms,
+            perSecond, result.activeAtEnd);
+    SDL_Log("Sand benchmark, %d worker threads: %ld chunk ticks in %.2f ms (%.0f chunk ticks/s), %ld voxels moved, "
+            "%d chunks still active",
+            result.threads, result.chunkTicks, result.ms, perSecond, result.moved, result.activeAtEnd);
+  }
+  float referenceMs = TicksToMs(referenceTicks);
+  float referencePerSecond = referenceChunkTicks / std::max(referenceMs, 0.001f) * 1000.0f;
+  out.Row("reference", "", VERIFY_TICKS, referenceChunkTicks, "", referenceMs, referencePerSecond, "");
+  SDL_Log("Sand reference: %.0f chunk ticks/s", referencePerSecond);
+
+  return mismatches == 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+// Drops piles of sand onto a patch of terrain chunks and runs the sand simulation with and without worker threads,
+// comparing every tick with a per voxel reference that updates every chunk. Then measures simulated chunk ticks per
+// second on a larger patch. Runs on the CPU only.
+bool RunSandBenchmark(int seed, const std::string &path);
@@ -0,0 +1,320 @@
+#include "sand_simulation.h"
+#include <bit>
+
+namespace {
+
+const int SIZE = VoxelGrid::SIZE;
+
+// Chunk coordinate of a world voxel coordinate, rounding down
+int ChunkOf(int voxel) {
+  return voxel >= 0 ? voxel / SIZE : (voxel + 1) / SIZE - 1;
+}
+
+} // namespace
+
+SandSimulation::SandSimulation(int threadCount)
+    : mTicks(0), mQuit(false), mGeneration(0), mBusy(0), mDirection(PlusX), mNext(0) {
+  mMutex = SDL_CreateMutex();
+  mStart = SDL_CreateCondition();
+  mDone = SDL_CreateCondition();
+  for (int i = 0; i < threadCount; ++i) {
+    mWorkers.push_back(SDL_CreateThread(WorkerMain, "Sand", this));
+  }
+}
+
+SandSimulation::~SandSimulation() {
+  SDL_LockMutex(mMutex);
+  mQuit = true;
+  SDL_BroadcastCondition(mStart);
+  SDL_UnlockMutex(mMutex);
+  for (auto *worker : mWorkers) {
+    SDL_WaitThread(worker, nullptr);
+  }
+
+  SDL_DestroyCondition(mDone);
+  SDL_DestroyCondition(mStart);
+  SDL_DestroyMutex(mMutex);
+}
+
+u64 SandSimulation::Key(const glm::ivec2 &position) {
+  return (static_cast<u64>(static_cast<uint32_t>(position.x)) << 32) | static_cast<uint32_t>(position.y);
+}
+
+SandSimulation::Block *SandSimulation::Find(const glm::ivec2 &position) const {
+  auto it = mBlocks.find(Key(position));
+  return it != mBlocks.end() ? it->second.get() : nullptr;
+}
+
+void SandSimulation::Link(Block &block) {
+  const glm::ivec2 offsets[] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+  for (int i = 0; i < 4; ++i) {
+    block.neighbors[i] = Find(block.position + offsets[i]);
+    if (block.neighbors[i]) {
+      // The opposite direction is the other one of the pair
+      block.neighbors[i]->neighbors[i ^ 1] = &block;
+    }
+  }
+}
+
+void SandSimulation::Wake(Block &block) {
+  block.quiet = 0;
+  for (auto *neighbor : block.neighbors) {
+    if (neighbor) {
+      neighbor->quiet = 0;
+    }
+  }
+}
+
+void SandSimulation::AddChunk(const glm::ivec2 &position, const VoxelGrid &solid) {
+  auto &block = mBlocks[Key(position)];
+  if (!block) {
+    block = std::make_unique<Block>();
+  }
+
+  block->position = position;
+  block->solid = solid;
+  block->sand = {};
+  block->changed = false;
+  block->moved = 0;
+  Link(*block);
+  Wake(*block);
+}
+
+void SandSimulation::RemoveChunk(const glm::ivec2 &position) {
+  auto it = mBlocks.find(Key(position));
+  if (it == mBlocks.end()) {
+    return;
+  }
+
+  Block &block = *it->second;
+  for (int i = 0; i < 4; ++i) {
+    if (block.neighbors[i]) {
+      block.neighbors[i]->neighbors[i ^ 1] = nullptr;
+      block.neighbors[i]->quiet = 0;
+    }
+  }
+  mChanged.erase(it->first);
+  mBlocks.erase(it);
+}
+
+bool SandSimulation::AddSand(const glm::ivec3 &voxel) {
+  glm::ivec2 position(ChunkOf(voxel.x), ChunkOf(voxel.z));
+  Block *block = Find(position);
+  if (!block || voxel.y < 0 || voxel.y >= SIZE) {
+    return false;
+  }
+
+  int index = (voxel.x - position.x * SIZE) * SIZE + voxel.z - position.y * SIZE;
+  u64 bit = static_cast<u64>(1) << voxel.y;
+  if ((block->solid.columns[index] | block->sand.columns[index]) & bit) {
+    return false;
+  }
+
+  block->sand.columns[index] |= bit;
+  Wake(*block);
+  mChanged[Key(position)] = position;
+  return true;
+}
+
+const VoxelGrid *SandSimulation::Sand(const glm::ivec2 &position) const {
+  Block *block = Find(position);
+  return block ? &block->sand : nullptr;
+}
+
+SandSimulation::Stats SandSimulation::GetStats() const {
+  return mStats;
+}
+
+int SandSimulation::ActiveChunks() const {
+  int active = 0;
+  for (const auto &[key, block] : mBlocks) {
+    active += block->quiet < QUIET_TICKS;
+  }
+  return active;
+}
+
+void SandSimulation::Tick() {
+  mStats = {};
+  mDirection = static_cast<Direction>(mTicks++ % 4);
+
+  std::vector<Block *> active;
+  for (const auto &[key, block] : mBlocks) {
+    if (block->quiet < QUIET_TICKS) {
+      block->moved = 0;
+      active.push_back(block.get());
+    }
+  }
+  // Slides also change the neighbours, whether they are processed or not
+  for (auto *block : active) {
+    block->changed = false;
+    for (auto *neighbor : block->neighbors) {
+      if (neighbor) {
+        neighbor->changed = false;
+      }
+    }
+  }
+
+  // Chunks of one parity only share columns with chunks of the other ones
+  for (int parity = 0; parity < 4; ++parity) {
+    mBatch.clear();
+    for (auto *block : active) {
+      if (((block->position.x & 1) | (block->position.y & 1) << 1) == parity) {
+        mBatch.push_back(block);
+      }
+    }
+    RunBatch();
+  }
+
+  for (auto *block : active) {
+    block->quiet++;
+    mStats.chunkTicks++;
+    mStats.moved += block->moved;
+  }
+  // A chunk's moves depend on its own voxels and its neighbours', and nothing else can start them again
+  for (auto *block : active) {
+    if (block->changed) {
+      Wake(*block);
+    }
+  }
+  for (auto *block : active) {
+    for (auto *changed : {block, block->neighbors[0], block->neighbors[1], block->neighbors[2], block->neighbors[3]}) {
+      if (changed && changed->changed) {
+        mChanged[Key(changed->position)] = changed->position;
+      }
+    }
+  }
+}
+
+std::vector<glm::ivec2> SandSimulation::TakeChanged() {
+  std::vector<glm::ivec2> changed;
+  changed.reserve(mChanged.size());
+  for (const auto &[key, position] : mChanged) {
+    changed.push_back(position);
+  }
+  mChanged.clear();
+  return changed;
+}
+
+void SandSimulation::RunBatch() {
+  if (mWorkers.empty() || mBatch.size() < 2) {
+    for (auto *block : mBatch) {
+      Step(*block, mDirection);
+    }
+    return;
+  }
+
+  SDL_LockMutex(mMutex);
+  mNext = 0;
+  mBusy = mWorkers.size();
+  mGeneration++;
+  SDL_BroadcastCondition(mStart);
+  SDL_UnlockMutex(mMutex);
+
+  Drain();
+
+  SDL_LockMutex(mMutex);
+  while (mBusy > 0) {
+    SDL_WaitCondition(mDone, mMutex);
+  }
+  SDL_UnlockMutex(mMutex);
+}
+
+void SandSimulation::Drain() {
+  for (size_t i = mNext++; i < mBatch.size(); i = mNext++) {
+    Step(*mBatch[i], mDirection);
+  }
+}
+
+void SandSimulation::Step(Block &block, Direction direction) {
+  // Every run of sand with air below falls by one voxel. Adding the lowest voxel of a run to the column carries through
+  // the run and clears it, which leaves exactly the runs that fall.
+  for (int i = 0; i < SIZE * SIZE; ++i) {
+    u64 sand = block.sand.columns[i];
+    u64 free = ~(block.solid.columns[i] | sand);
+    u64 bottoms = sand & (free << 1);
+    if (bottoms == 0) {
+      continue;
+    }
+
+    u64 falling = sand & ~(sand + bottoms);
+    block.sand.columns[i] = (sand & ~falling) | (falling >> 1);
+    block.moved += std::popcount(falling);
+    block.changed = true;
+  }
+
+  // Slides stay within a line of columns along the direction, the line is decided as a whole before it moves. The
+  // line's last column slides into the neighbour.
+  bool alongX = direction == PlusX || direction == MinusX;
+  int step = direction == PlusX || direction == PlusZ ? 1 : -1;
+  Block *neighbor = block.neighbors[direction];
+  auto index = [&](int along, int line) { return alongX ? along * SIZE + line : line * SIZE + along; };
+
+  u64 slides[SIZE];
+  for (int line = 0; line < SIZE; ++line) {
+    bool any = false;
+    for (int along = 0; along < SIZE; ++along) {
+      int i = index(along, line);
+      u64 sand = block.sand.columns[i];
+      slides[along] = 0;
+      if (sand == 0) {
+        continue;
+      }
+
+      int target = along + step;
+      const Block *into = target >= 0 && target < SIZE ? &block : neighbor;
+      if (!into) {
+        continue;
+      }
+
+      int t = index((target + SIZE) % SIZE, line);
+      u64 resting = sand & ~(~(block.solid.columns[i] | sand) << 1);
+      u64 open = ~(into->solid.columns[t] | into->sand.columns[t]);
+      slides[along] = resting & open & (open << 1);
+      any = any || slides[along] != 0;
+    }
+    if (!any) {
+      continue;
+    }
+
+    for (int along = 0; along < SIZE; ++along) {
+      if (slides[along] == 0) {
+        continue;
+      }
+
+      int target = along + step;
+      Block *into = target >= 0 && target < SIZE ? &block : neighbor;
+      block.sand.columns[index(along, line)] &= ~slides[along];
+      into->sand.columns[index((target + SIZE) % SIZE, line)] |= slides[along] >> 1;
+      block.moved += std::popcount(slides[along]);
+      block.changed = true;
+      into->changed = true;
+    }
+  }
+}
+
+int SandSimulation::WorkerMain(void *data) {
+  static_cast<SandSimulation *>(data)->Work();
+  return 0;
+}
+
+void SandSimulation::Work() {
+  unsigned long seen = 0;
+  SDL_LockMutex(mMutex);
+  while (true) {
+    while (!mQuit && mGeneration == seen) {
+      SDL_WaitCondition(mStart, mMutex);
+    }
+    if (mQuit) {
+      break;
+    }
+
+    seen = mGeneration;
+    SDL_UnlockMutex(mMutex);
+    Drain();
+    SDL_LockMutex(mMutex);
+    if (--mBusy == 0) {
+      SDL_SignalCondition(mDone);
+    }
+  }
+  SDL_UnlockMutex(mMutex);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "voxel_grid.h"
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <glm/glm.hpp>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Falling sand on column bitmasks. Every chunk keeps the static voxels sand can't enter and a grid of sand voxels, both
+// one word per column like a VoxelGrid.
+//
+// A tick first lets sand fall: every run of sand with air below it moves down one voxel, found for a whole column at
+// once with a carry through the run. Sand that rests on something then slides one voxel down a slope, in a direction
+// which rotates through +x, -x, +z and -z from one tick to the next, when both the voxel beside it and the one below
+// that are free. Slides are decided on the state before any of them is applied.
+//
+// A chunk's slides write into the neighbouring chunk. Chunks are processed in four passes by the parity of their x and
+// z, so chunks updated at the same time are two apart and never touch the same columns; the result doesn't depend on
+// the number of threads. A chunk is only processed while something changed in it or its neighbours during the last
+// four ticks, after that it has tried every direction against the same voxels and is at rest.
+class SandSimulation {
+public:
+  // Ticks without change after which a chunk is at rest, one per slide direction
+  static const int QUIET_TICKS = 4;
+
+  struct Stats {
+    // Chunks processed by the last tick
+    int chunkTicks = 0;
+    // Sand voxels that fell or slid
+    int moved = 0;
+  };
+
+  // With threadCount 0 ticks run on the caller only
+  explicit SandSimulation(int threadCount);
+  ~SandSimulation();
+
+  SandSimulation(const SandSimulation &) = delete;
+  SandSimulation &operator=(const SandSimulation &) = delete;
+
+  // Chunks are at y = 0 and addressed by their (x, z). Adding a chunk that is there replaces its static voxels and
+  // clears its sand. Sand never leaves the loaded chunks, the space next to a missing chunk is solid.
+  void AddChunk(const glm::ivec2 &position, const VoxelGrid &solid);
+  void RemoveChunk(const glm::ivec2 &position);
+
+  // World voxel coordinates. Sand is only placed where there is neither sand nor a static voxel, returns false if it
+  // wasn't placed.
+  bool AddSand(const glm::ivec3 &voxel);
+  // Null if the chunk isn't loaded
+  const VoxelGrid *Sand(const glm::ivec2 &position) const;
+
+  void Tick();
+  // Chunks whose sand changed since the last call, by ticks or by AddSand()
+  std::vector<glm::ivec2> TakeChanged();
+
+  Stats GetStats() const;
+  // Chunks the next tick will process
+  int ActiveChunks() const;
+
+private:
+  enum Direction {
+    PlusX,
+    MinusX,
+    PlusZ,
+    MinusZ
+  };
+
+  struct Block {
+    glm::ivec2 position;
+    VoxelGrid solid;
+    VoxelGrid sand;
+    // Null where the neighbour isn't loaded, indexed by Direction
+    Block *neighbors[4];
+    int quiet;
+    // Set when the sand of the chunk changed during the current tick. Written by the chunk's own pass and by the pass
+    // of the neighbour sliding into it, which never run at the same time.
+    bool changed;
+    int moved;
+  };
+
+  std::unordered_map<u64, std::unique_ptr<Block>> mBlocks;
+  // Keyed like mBlocks
+  std::unordered_map<u64, glm::ivec2> mChanged;
+  unsigned long mTicks;
+  Stats mStats;
+
+  // Workers process mBatch from mNext on, the caller takes part as well
+  std::vector<SDL_Thread *> mWorkers;
+  SDL_Mutex *mMutex;
+  SDL_Condition *mStart, *mDone;
+  bool mQuit;
+  unsigned long mGeneration;
+  int mBusy;
+  std::vector<Block *> mBatch;
+  Direction mDirection;
+  std::atomic<size_t> mNext;
+
+  static u64 Key(const glm::ivec2 &position);
+  Block *Find(const glm::ivec2 &position) const;
+  void Link(Block &block);
+  void Wake(Block &block);
+
+  // Runs Step() on every chunk of the batch, on all threads
+  void RunBatch();
+  void Drain();
+  static void Step(Block &block, Direction direction);
+
+  static int WorkerMain(void *data);
+  void Work();
+};
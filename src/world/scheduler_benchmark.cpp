@@ -0,0 +1,170 @@
+#include "scheduler_benchmark.h"
+#include "SDL3/SDL_cpuinfo.h"
+#include "SDL3/SDL_log.h"
+#include "SDL3/SDL_timer.h"
+#include "chunk_scheduler.h"
+#include "chunk_store.h"
+#include "core/benchmark.h"
+#include "world.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const int SIZE = VoxelGrid::SIZE;
+const int LOAD_RADIUS = World::LOAD_RADIUS;
+const int TICK_RATE = 60;
+const int TICKS = 900;
+// Voxels per tick, a fast fly-through that keeps the load square moving
+const float SPEED = 4.0f;
+const glm::vec3 START(0.0f, 40.0f, 0.0f);
+
+// The path flies along +x for the first half and turns to +z for the second, so the queue is reordered for a new view
+// direction too
+glm::vec3 Direction(int tick) {
+  return tick < TICKS / 2 ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f);
+}
+
+glm::vec3 Eye(int tick) {
+  int first = std::min(tick, TICKS / 2);
+  return START + Direction(0) * (SPEED * first) + Direction(TICKS) * (SPEED * (tick - first));
+}
+
+u64 Key(const glm::ivec3 &position) {
+  return static_cast<u64>(static_cast<uint32_t>(position.x)) << 32 | static_cast<uint32_t>(position.z);
+}
+
+struct Visible {
+  glm::ivec3 position;
+  // Since the start of the flight
+  float requestedMs;
+  float ms;
+  // Horizontal distance from the eye when the chunk was handed back, in chunks
+  float distance;
+};
+
+float Percentile(std::vector<float> values, float percent) {
+  if (values.empty()) {
+    return 0.0f;
+  }
+  std::sort(values.begin(), values.end());
+  size_t index = static_cast<size_t>(percent / 100.0f * (values.size() - 1) + 0.5f);
+  return values[index];
+}
+
+} // namespace
+
+bool RunSchedulerBenchmark(int seed, const std::string &path) {
+  std::string directory = path + ".store";
+  std::error_code error;
+  std::filesystem::remove_all(directory, error);
+
+  TextureAtlas atlas(0, {{TextureType::Dirt, {0.0f, 0.5f}, {0.25f, 0.75f}}});
+  ChunkCache cache;
+  std::vector<Visible> visible;
+  int generated = 0, cancelled = 0, workers = std::max(1, SDL_GetNumLogicalCPUCores() - 1);
+  {
+    ChunkStore store(directory);
+    std::unordered_map<u64, std::shared_ptr<Chunk>> loaded;
+    ChunkScheduler scheduler(workers, nullptr);
+
+    std::optional<glm::ivec3> center;
+    glm::vec3 lastDirection(0.0f);
+    auto period = SDL_GetPerformanceFrequency() / TICK_RATE;
+    auto begin = SDL_GetPerformanceCounter();
+    auto nextTick = begin;
+    for (int tick = 0; tick < TICKS; ++tick) {
+      auto now = SDL_GetPerformanceCounter();
+      if (now < nextTick) {
+        SDL_DelayNS((nextTick - now) * 1000000000ull / SDL_GetPerformanceFrequency());
+      }
+      nextTick += period;
+
+      // The same as World::Update(): reorder and evict when the eye enters another chunk or turns
+      glm::vec3 eye = Eye(tick), direction = Direction(tick);
+      glm::ivec3 current(static_cast<int>(std::floor(eye.x / SIZE)), 0, static_cast<int>(std::floor(eye.z / SIZE)));
+      if (current != center || glm::dot(direction, lastDirection) < 0.95f) {
+        center = current;
+        lastDirection = direction;
+        scheduler.Reprioritize(eye, direction);
+        std::erase_if(loaded, [&](const auto &entry) {
+          glm::ivec3 offset = entry.second->mPosition - current;
+          bool evicted = offset.x < -LOAD_RADIUS - 1 || offset.x > LOAD_RADIUS || offset.z < -LOAD_RADIUS - 1 ||
+                         offset.z > LOAD_RADIUS;
+          if (evicted) {
+            entry.second->mCancelled = true;
+          }
+          return evicted;
+        });
+      }
+
+      for (int x = -LOAD_RADIUS; x < LOAD_RADIUS; ++x) {
+        for (int z = -LOAD_RADIUS; z < LOAD_RADIUS; ++z) {
+          glm::ivec3 position(current.x + x, 0, current.z + z);
+          auto &chunk = loaded[Key(position)];
+          if (!chunk) {
+            chunk = std::make_shared<Chunk>(atlas, cache, nullptr, store, position, seed);
+            chunk->mRequestedAt = SDL_GetPerformanceCounter();
+            scheduler.Enqueue(chunk);
+          }
+        }
+      }
+
+      now = SDL_GetPerformanceCounter();
+      for (auto &chunk : scheduler.CollectFinished()) {
+        if (chunk->mCancelled) {
+          cancelled++;
+          continue;
+        }
+
+        generated++;
+        // Nothing draws the meshes, so they don't have to stay around
+        chunk->mVertices.reset();
+        if (World::InViewCone(chunk->mPosition, eye, direction)) {
+          glm::vec2 toChunk = (glm::vec2(chunk->mPosition.x, chunk->mPosition.z) + 0.5f) * static_cast<float>(SIZE) -
+                              glm::vec2(eye.x, eye.z);
+          visible.push_back({chunk->mPosition, TicksToMs(chunk->mRequestedAt - begin),
+                             TicksToMs(now - chunk->mRequestedAt), glm::length(toChunk) / SIZE});
+        }
+      }
+    }
+
+    // The workers stop at the next check instead of finishing the queue
+    for (auto &[key, chunk] : loaded) {
+      chunk->mCancelled = true;
+    }
+  }
+  std::filesystem::remove_all(directory, error);
+
+  std::vector<float> times;
+  for (const auto &chunk : visible) {
+    times.push_back(chunk.ms);
+  }
+  float total = 0.0f;
+  for (float ms : times) {
+    total += ms;
+  }
+  float average = times.empty() ? 0.0f : total / times.size();
+  float median = Percentile(times, 50.0f), p95 = Percentile(times, 95.0f), max = Percentile(times, 100.0f);
+  SDL_Log("Scheduler fly-through with %d workers: %zu chunks in view, time to first visible avg %.2f ms, median %.2f "
+          "ms, 95th percentile %.2f ms, max %.2f ms; %d chunks generated, %d cancelled",
+          workers, visible.size(), average, median, p95, max, generated, cancelled);
+
+  BenchmarkCsv out(path);
+  if (!out.Ok()) {
+    return false;
+  }
+
+  out.Table("workers,ticks,speed,chunks_in_view,generated,cancelled,avg_ms,median_ms,p95_ms,max_ms");
+  out.Row(workers, TICKS, SPEED, visible.size(), generated, cancelled, average, median, p95, max);
+  out.Table("chunk_x,chunk_z,requested_ms,distance_chunks,time_to_visible_ms");
+  for (const auto &chunk : visible) {
+    out.Row(chunk.position.x, chunk.position.z, chunk.requestedMs, chunk.distance, chunk.ms);
+  }
+
+  return !visible.empty();
+}
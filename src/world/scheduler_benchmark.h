@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+// Flies a fixed path over the terrain without a GL context: the load square follows the camera like in the world, the
+// chunk scheduler generates it and chunks that fall out of the square are cancelled. Reports for every chunk in the
+// view cone the time from requesting it until a worker handed it back, the time to first visible without the upload.
+bool RunSchedulerBenchmark(int seed, const std::string &path);
@@ -0,0 +1,241 @@
+#include "shadow_maps.h"
+#include "SDL3/SDL_log.h"
+#include "core/gpu_profiler.h"
+#include "core/memory_tracker.h"
+#include "glm/ext/matrix_clip_space.hpp"
+#include "glm/ext/matrix_transform.hpp"
+#include "world.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+namespace {
+
+// Edge of the area each cascade covers around the camera, in voxels. The last one covers the load square.
+const float HALF_EXTENTS[ShadowMaps::CASCADES] = {32.0f, 112.0f, 352.0f};
+// How far the cascades reach towards and away from the sun, beyond their width. Casters closer to the sun than that
+// are clamped to the near plane and still cast.
+const float DEPTH_MARGIN = 4.0f * VoxelGrid::SIZE;
+
+// Changes whenever the chunk is replaced or remeshed
+u64 ChunkHash(const Chunk &chunk) {
+  u64 values[] = {reinterpret_cast<uintptr_t>(&chunk), reinterpret_cast<uintptr_t>(chunk.mVertices.get()),
+                  static_cast<u64>(static_cast<uint32_t>(chunk.mPosition.x)),
+                  static_cast<u64>(static_cast<uint32_t>(chunk.mPosition.z))};
+  u64 hash = 14695981039346656037ull;
+  for (u64 value : values) {
+    hash = (hash ^ value) * 1099511628211ull;
+  }
+
+  return hash;
+}
+
+int TileOf(float ndc) {
+  return std::clamp(static_cast<int>((ndc * 0.5f + 0.5f) * ShadowMaps::TILES), 0, ShadowMaps::TILES - 1);
+}
+
+} // namespace
+
+ShadowMaps::ShadowMaps(std::unique_ptr<Shader> shader, const glm::vec3 &sunPosition)
+    : mShader(std::move(shader)), mTexture(0), mFramebuffer(0), mCaching(true), mUpdates(0) {
+  glm::vec3 toSun = glm::normalize(sunPosition);
+  glm::vec3 up = std::abs(toSun.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+  mLightView = glm::lookAt(glm::vec3(0.0f), -toSun, up);
+
+  for (int i = 0; i < CASCADES; ++i) {
+    mCascades[i].halfExtent = HALF_EXTENTS[i];
+    mCascades[i].center = glm::vec3(0.0f);
+    mCascades[i].viewProjection = glm::mat4(1.0f);
+    mCascades[i].valid = false;
+    std::fill(std::begin(mCascades[i].drawn), std::end(mCascades[i].drawn), 0);
+  }
+
+  glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &mTexture);
+  glTextureStorage3D(mTexture, 1, GL_DEPTH_COMPONENT32F, RESOLUTION, RESOLUTION, CASCADES);
+  MemoryTracker::RegisterTexture(mTexture, GpuTag::Shadows,
+                                 MemoryTracker::TextureBytes(RESOLUTION, RESOLUTION, 1, 4) * CASCADES);
+  // Hardware filtered depth compares, sampled through a sampler2DArrayShadow
+  glTextureParameteri(mTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTextureParameteri(mTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTextureParameteri(mTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTextureParameteri(mTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTextureParameteri(mTexture, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+  glTextureParameteri(mTexture, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+  glCreateFramebuffers(1, &mFramebuffer);
+  glNamedFramebufferTextureLayer(mFramebuffer, GL_DEPTH_ATTACHMENT, mTexture, 0, 0);
+  glNamedFramebufferDrawBuffer(mFramebuffer, GL_NONE);
+  glNamedFramebufferReadBuffer(mFramebuffer, GL_NONE);
+  if (glCheckNamedFramebufferStatus(mFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    SDL_Log("Shadow map framebuffer is incomplete");
+  }
+}
+
+ShadowMaps::~ShadowMaps() {
+  glDeleteFramebuffers(1, &mFramebuffer);
+  MemoryTracker::ReleaseTexture(mTexture);
+  glDeleteTextures(1, &mTexture);
+}
+
+void ShadowMaps::SetCaching(bool caching) {
+  mCaching = caching;
+}
+
+ShadowMaps::Stats ShadowMaps::GetStats() const {
+  return mStats;
+}
+
+bool ShadowMaps::Place(Cascade &cascade, const glm::vec3 &eye) {
+  float step = 2.0f * cascade.halfExtent / RESOLUTION * SNAP_TEXELS;
+  glm::vec3 center = glm::floor(glm::vec3(mLightView * glm::vec4(eye, 1.0f)) / step) * step;
+  if (cascade.valid && center == cascade.center) {
+    return false;
+  }
+
+  // The camera stays within one snap step of the center, the cascades are sized so that is well inside
+  float half = cascade.halfExtent;
+  float depth = 2.0f * half + DEPTH_MARGIN;
+  glm::mat4 projection = glm::ortho(center.x - half, center.x + half, center.y - half, center.y + half,
+                                    -(center.z + depth), -(center.z - depth));
+  cascade.center = center;
+  cascade.viewProjection = projection * mLightView;
+  cascade.valid = true;
+  return true;
+}
+
+void ShadowMaps::Update(const World &world, const std::vector<std::shared_ptr<Chunk>> &chunks, const glm::vec3 &eye) {
+  mStats = {};
+  GLint viewport[4];
+  bool cullFace = false;
+  bool bound = false;
+
+  for (int i = 0; i < CASCADES; ++i) {
+    Cascade &cascade = mCascades[i];
+    bool moved = Place(cascade, eye) || !mCaching;
+    mStats.cascadesMoved += moved;
+
+    // Hashes are summed, so they don't depend on the order of the chunks
+    u64 hashes[TILES * TILES] = {};
+    std::vector<Caster> casters;
+    for (const auto &loaded : chunks) {
+      Chunk &chunk = *loaded;
+      if (!chunk.mReady || chunk.VertexCount() == 0) {
+        continue;
+      }
+
+      glm::vec3 origin = glm::vec3(chunk.mPosition * VoxelGrid::SIZE);
+      glm::vec2 low(1e9f), high(-1e9f);
+      for (int corner = 0; corner < 8; ++corner) {
+        glm::vec3 position = origin + glm::vec3((corner & 1) ? chunk.mBoundsMax.x : chunk.mBoundsMin.x,
+                                                (corner & 2) ? chunk.mBoundsMax.y : chunk.mBoundsMin.y,
+                                                (corner & 4) ? chunk.mBoundsMax.z : chunk.mBoundsMin.z);
+        glm::vec2 ndc = glm::vec2(cascade.viewProjection * glm::vec4(position, 1.0f));
+        low = glm::min(low, ndc);
+        high = glm::max(high, ndc);
+      }
+      if (high.x < -1.0f || low.x > 1.0f || high.y < -1.0f || low.y > 1.0f) {
+        continue;
+      }
+
+      Caster caster{&chunk, {TileOf(low.x), TileOf(low.y)}, {TileOf(high.x), TileOf(high.y)}};
+      u64 hash = ChunkHash(chunk);
+      for (int y = caster.firstTile.y; y <= caster.lastTile.y; ++y) {
+        for (int x = caster.firstTile.x; x <= caster.lastTile.x; ++x) {
+          hashes[y * TILES + x] += hash;
+        }
+      }
+      casters.push_back(caster);
+    }
+
+    // The nearest cascade is the one the player looks at, it is always brought up to date at once
+    std::vector<int> tiles;
+    size_t budget = i == 0 || moved ? TILES * TILES : FAR_TILE_BUDGET;
+    for (int tile = 0; tile < TILES * TILES && tiles.size() < budget; ++tile) {
+      if (moved || hashes[tile] != cascade.drawn[tile]) {
+        tiles.push_back(tile);
+        cascade.drawn[tile] = hashes[tile];
+      }
+    }
+    if (tiles.empty()) {
+      continue;
+    }
+
+    if (!bound) {
+      glGetIntegerv(GL_VIEWPORT, viewport);
+      cullFace = glIsEnabled(GL_CULL_FACE);
+      glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+      glViewport(0, 0, RESOLUTION, RESOLUTION);
+      glEnable(GL_DEPTH_TEST);
+      glEnable(GL_SCISSOR_TEST);
+      glEnable(GL_DEPTH_CLAMP);
+      glEnable(GL_POLYGON_OFFSET_FILL);
+      glPolygonOffset(2.0f, 4.0f);
+      glDisable(GL_CULL_FACE);
+      mShader->Bind();
+      GpuProfiler::CountStateChange();
+      bound = true;
+    }
+    Draw(world, i, casters, tiles);
+  }
+
+  if (bound) {
+    mShader->Unbind();
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glDisable(GL_DEPTH_CLAMP);
+    glDisable(GL_SCISSOR_TEST);
+    if (cullFace) {
+      glEnable(GL_CULL_FACE);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  }
+
+  mReported.tilesDrawn += mStats.tilesDrawn;
+  mReported.chunksDrawn += mStats.chunksDrawn;
+  mReported.cascadesMoved += mStats.cascadesMoved;
+  if (++mUpdates == REPORT_INTERVAL) {
+    SDL_Log("Shadows: %d tiles and %d chunk draws in %d frames, %d cascade moves%s", mReported.tilesDrawn,
+            mReported.chunksDrawn, mUpdates, mReported.cascadesMoved, mCaching ? "" : " (cache off)");
+    mReported = {};
+    mUpdates = 0;
+  }
+}
+
+void ShadowMaps::Draw(const World &world, int index, const std::vector<Caster> &casters,
+                      const std::vector<int> &tiles) {
+  // One scope per cascade, the far ones redraw less often and their times would disappear in a sum
+  GpuScope scope("shadows " + std::to_string(index));
+  glNamedFramebufferTextureLayer(mFramebuffer, GL_DEPTH_ATTACHMENT, mTexture, 0, index);
+  mShader->UniformMat4("viewProjection", mCascades[index].viewProjection);
+
+  const int size = RESOLUTION / TILES;
+  std::vector<Chunk *> overlapping;
+  for (int tile : tiles) {
+    int x = tile % TILES;
+    int y = tile / TILES;
+    glScissor(x * size, y * size, size, size);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    // Chunks reaching into the tile are drawn whole, the scissor keeps the rest of the map as it was
+    overlapping.clear();
+    for (const auto &caster : casters) {
+      if (x >= caster.firstTile.x && x <= caster.lastTile.x && y >= caster.firstTile.y && y <= caster.lastTile.y) {
+        overlapping.push_back(caster.chunk);
+      }
+    }
+    world.DrawShadowCasters(*mShader, overlapping);
+    mStats.tilesDrawn++;
+    mStats.chunksDrawn += overlapping.size();
+  }
+}
+
+void ShadowMaps::Bind(const Shader &shader, int unit) const {
+  glBindTextureUnit(unit, mTexture);
+  GpuProfiler::CountStateChange();
+  shader.UniformInt("shadowMap", unit);
+  shader.UniformInt("shadows", 1);
+  for (int i = 0; i < CASCADES; ++i) {
+    shader.UniformMat4("shadowMatrices[" + std::to_string(i) + "]", mCascades[i].viewProjection);
+  }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "chunk.h"
+#include "core/shader.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+class World;
+
+// Cascaded shadow maps for the sun, kept from one frame to the next. Every cascade is a fixed size square around the
+// camera whose center snaps to a grid of whole texels, so it only moves when the camera crosses a grid cell and the
+// depth it holds stays valid in between. Each cascade is split into tiles, and a tile is only redrawn when the chunks
+// overlapping it change, i.e. when one of them loads, is remeshed or unloads. The far cascades redraw at most a few
+// tiles per frame and catch up over the next ones.
+class ShadowMaps {
+public:
+  // basic.frag has the same count
+  static const int CASCADES = 3;
+  static const int RESOLUTION = 2048;
+  // Tiles per side of a cascade
+  static const int TILES = 4;
+
+  struct Stats {
+    int tilesDrawn = 0;
+    int chunksDrawn = 0;
+    // Cascades redrawn because the camera crossed a snap cell
+    int cascadesMoved = 0;
+  };
+
+  // The sun is far enough away for its light to be parallel, it shines from sunPosition towards the origin
+  ShadowMaps(std::unique_ptr<Shader> shader, const glm::vec3 &sunPosition);
+  ~ShadowMaps();
+
+  ShadowMaps(const ShadowMaps &) = delete;
+  ShadowMaps &operator=(const ShadowMaps &) = delete;
+
+  // Without the cache every cascade is redrawn every frame, for comparing pass times
+  void SetCaching(bool caching);
+
+  // Redraws whatever is out of date. Changes the framebuffer and viewport and restores them before it returns.
+  void Update(const World &world, const std::vector<std::shared_ptr<Chunk>> &chunks, const glm::vec3 &eye);
+  // Binds the maps to the texture unit and sets the shadow uniforms of basic.frag
+  void Bind(const Shader &shader, int unit) const;
+
+  // Work done by the last Update()
+  Stats GetStats() const;
+
+private:
+  struct Cascade {
+    float halfExtent;
+    // Snapped light space position of the camera the matrix was built around
+    glm::vec3 center;
+    glm::mat4 viewProjection;
+    bool valid;
+    // Hash of the chunks overlapping each tile when it was last drawn
+    u64 drawn[TILES * TILES];
+  };
+
+  // A chunk drawn into a cascade and the tiles it overlaps
+  struct Caster {
+    Chunk *chunk;
+    glm::ivec2 firstTile, lastTile;
+  };
+
+  // Tiles the far cascades redraw per frame when their chunks change
+  static const int FAR_TILE_BUDGET = 2;
+  // The cascade center moves in steps of this many texels
+  static const int SNAP_TEXELS = 128;
+  // Updates between two logs of the redraw counts
+  static const int REPORT_INTERVAL = 600;
+
+  std::unique_ptr<Shader> mShader;
+  glm::mat4 mLightView;
+  GLuint mTexture, mFramebuffer;
+  Cascade mCascades[CASCADES];
+  bool mCaching;
+  Stats mStats;
+  // Summed since the last report
+  Stats mReported;
+  int mUpdates;
+
+  // Moves the cascade when the camera left its snap cell, returns true if it moved
+  bool Place(Cascade &cascade, const glm::vec3 &eye);
+  void Draw(const World &world, int index, const std::vector<Caster> &casters, const std::vector<int> &tiles);
+};
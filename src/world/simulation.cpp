@@ -0,0 +1,196 @@
+#include "simulation.h"
+#include "SDL3/SDL_log.h"
+#include "SDL3/SDL_timer.h"
+#include "physics.h"
+#include <algorithm>
+
+// The player's box around the camera, which sits at eye height
+static const float PLAYER_HALF_WIDTH = 0.3f;
+static const float PLAYER_HEIGHT = 1.8f;
+static const float PLAYER_EYE_HEIGHT = 1.6f;
+
+// Sand is dropped this far in front of the camera, in voxels
+static const float SAND_REACH = 4.0f;
+
+static Aabb PlayerBox(const glm::vec3 &eye) {
+  glm::vec3 feet = eye - glm::vec3(0.0f, PLAYER_EYE_HEIGHT, 0.0f);
+  return {feet - glm::vec3(PLAYER_HALF_WIDTH, 0.0f, PLAYER_HALF_WIDTH),
+          feet + glm::vec3(PLAYER_HALF_WIDTH, PLAYER_HEIGHT, PLAYER_HALF_WIDTH)};
+}
+
+Simulation::Simulation(World &world, Camera &camera, uint32_t tickRate)
+    : mWorld(world), mCamera(camera), mTickRate(tickRate), mTick(0), mPoseHash(14695981039346656037ull),
+      mRecording(nullptr), mThread(nullptr), mQuit(false), mInputMutex(SDL_CreateMutex()), mInput{},
+      mHasSnapshot(false), mPrevious{glm::vec3(0.0f), 0.0f, 0.0f} {
+}
+
+Simulation::~Simulation() {
+  Stop();
+  SDL_DestroyMutex(mInputMutex);
+}
+
+void Simulation::Start() {
+  if (!mThread) {
+    mQuit = false;
+    mThread = SDL_CreateThread(ThreadMain, "Simulation", this);
+  }
+}
+
+void Simulation::Stop() {
+  if (mThread) {
+    mQuit = true;
+    SDL_WaitThread(mThread, nullptr);
+    mThread = nullptr;
+  }
+}
+
+void Simulation::SetKeyboard(const KeyboardState &keyboard) {
+  SDL_LockMutex(mInputMutex);
+  mInput.keyboard = keyboard;
+  SDL_UnlockMutex(mInputMutex);
+}
+
+void Simulation::AddMouse(const glm::vec2 &relative) {
+  SDL_LockMutex(mInputMutex);
+  mInput.mouse += relative;
+  SDL_UnlockMutex(mInputMutex);
+}
+
+void Simulation::SetRecording(InputRecording *recording) {
+  mRecording = recording;
+}
+
+int Simulation::ThreadMain(void *data) {
+  static_cast<Simulation *>(data)->Run();
+  return 0;
+}
+
+void Simulation::Run() {
+  const uint64_t frequency = SDL_GetPerformanceFrequency();
+  const uint64_t period = frequency / mTickRate;
+  uint64_t next = SDL_GetPerformanceCounter();
+
+  // Reported every few seconds, shows whether the tick rate holds up while rendering is slow
+  const uint64_t reportInterval = 5 * frequency;
+  uint64_t reportStart = next;
+  uint32_t reportTicks = 0;
+  int lateTicks = 0;
+
+  while (!mQuit) {
+    uint64_t now = SDL_GetPerformanceCounter();
+    if (now < next) {
+      SDL_DelayNS((next - now) * 1000000000ull / frequency);
+      continue;
+    }
+
+    // Don't try to catch up after a long hitch, it would only delay the next snapshot further
+    if (now - next > frequency / 4) {
+      next = now;
+    }
+    bool late = now - next > period;
+    lateTicks += late;
+
+    SDL_LockMutex(mInputMutex);
+    TickInput input = mInput;
+    mInput.mouse = {0.0f, 0.0f};
+    mStats.ticks++;
+    mStats.lateTicks += late;
+    mStats.last = now;
+    SDL_UnlockMutex(mInputMutex);
+
+    Tick(input);
+    next += period;
+    reportTicks++;
+
+    if (now - reportStart >= reportInterval) {
+      float seconds = static_cast<float>(now - reportStart) / frequency;
+      SDL_Log("Simulation: %u ticks in %.2f s (%.1f Hz, target %u Hz), %d late", reportTicks, seconds,
+              reportTicks / seconds, mTickRate, lateTicks);
+      reportStart = now;
+      reportTicks = 0;
+      lateTicks = 0;
+    }
+  }
+}
+
+void Simulation::Tick(const TickInput &input) {
+  if (mRecording) {
+    mRecording->Record(mTick, input);
+  }
+
+  mCamera.HandleMouseEvent(input.mouse);
+
+  // The camera still flies, the player's box only keeps it out of the terrain
+  glm::vec3 start = mCamera.GetPosition();
+  mCamera.HandleKeyboardEvent(input.keyboard);
+  Body player{PlayerBox(start), mCamera.GetPosition() - start, false};
+  SweepBody([this](int x, int z) { return mWorld.Column(x, z); }, player, 1.0f);
+  mCamera.SetPose(start + (player.box.min - PlayerBox(start).min), mCamera.GetYaw(), mCamera.GetPitch());
+  if (input.keyboard.pressed[static_cast<int>(Key::Sand)]) {
+    mWorld.AddSand(glm::ivec3(glm::floor(mCamera.GetPosition() + mCamera.GetFront() * SAND_REACH)));
+  }
+  mWorld.Update(mCamera.GetPosition(), mCamera.GetFront());
+
+  glm::vec3 pose[2] = {mCamera.GetPosition(), mCamera.GetFront()};
+  auto *bytes = reinterpret_cast<const unsigned char *>(pose);
+  for (size_t i = 0; i < sizeof(pose); ++i) {
+    mPoseHash = (mPoseHash ^ bytes[i]) * 1099511628211ull;
+  }
+
+  mTick++;
+
+  auto &snapshot = mSnapshots.Back();
+  snapshot.tick = mTick;
+  snapshot.time = SDL_GetPerformanceCounter();
+  snapshot.pose = {mCamera.GetPosition(), mCamera.GetYaw(), mCamera.GetPitch()};
+  snapshot.chunks = mWorld.Chunks();
+  mSnapshots.Publish();
+}
+
+bool Simulation::Acquire() {
+  CameraPose previous = mSnapshots.Front().pose;
+  if (!mSnapshots.Acquire()) {
+    return mHasSnapshot;
+  }
+
+  mPrevious = mHasSnapshot ? previous : mSnapshots.Front().pose;
+  mHasSnapshot = true;
+  return true;
+}
+
+const FrameSnapshot &Simulation::Latest() const {
+  return mSnapshots.Front();
+}
+
+CameraPose Simulation::Interpolate(uint64_t now) const {
+  const auto &latest = mSnapshots.Front();
+  float alpha = InterpolationFactor(now);
+
+  return {
+      glm::mix(mPrevious.position, latest.pose.position, alpha),
+      glm::mix(mPrevious.yaw, latest.pose.yaw, alpha),
+      glm::mix(mPrevious.pitch, latest.pose.pitch, alpha),
+  };
+}
+
+float Simulation::InterpolationFactor(uint64_t now) const {
+  // A snapshot published after now was read is treated as just published
+  const auto &latest = mSnapshots.Front();
+  float elapsed = now > latest.time ? static_cast<float>(now - latest.time) : 0.0f;
+  return std::min(elapsed * mTickRate / SDL_GetPerformanceFrequency(), 1.0f);
+}
+
+uint32_t Simulation::TickCount() const {
+  return mTick;
+}
+
+uint64_t Simulation::PoseHash() const {
+  return mPoseHash;
+}
+
+Simulation::TickStats Simulation::GetTickStats() const {
+  SDL_LockMutex(mInputMutex);
+  TickStats stats = mStats;
+  SDL_UnlockMutex(mInputMutex);
+  return stats;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "core/camera.h"
+#include "core/camera_path.h"
+#include "core/input_recording.h"
+#include "core/triple_buffer.h"
+#include "world.h"
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Everything the render thread needs from one simulation tick
+struct FrameSnapshot {
+  uint32_t tick = 0;
+  // Performance counter value when the tick was published
+  uint64_t time = 0;
+  CameraPose pose{glm::vec3(0.0f), 0.0f, 0.0f};
+  std::vector<std::shared_ptr<Chunk>> chunks;
+};
+
+// Fixed timestep simulation: applies the input to the camera, keeps the world's chunks around it and publishes a
+// snapshot after every tick. Start() runs it on its own thread at the tick rate, the render thread picks the snapshots
+// up without locking. Without the thread, Tick() can be driven by hand, e.g. one tick per frame in a replay.
+class Simulation {
+public:
+  // Counted by the thread started with Start()
+  struct TickStats {
+    uint32_t ticks = 0;
+    // Ticks that started more than a tick period after they were due
+    uint32_t lateTicks = 0;
+    // Performance counter value when the latest tick started
+    uint64_t last = 0;
+  };
+
+  Simulation(World &world, Camera &camera, uint32_t tickRate);
+  ~Simulation();
+
+  void Start();
+  void Stop();
+
+  // Input from the event loop, picked up by the next tick
+  void SetKeyboard(const KeyboardState &keyboard);
+  void AddMouse(const glm::vec2 &relative);
+  // Every tick's input is recorded into it, only touch it again after Stop()
+  void SetRecording(InputRecording *recording);
+
+  void Tick(const TickInput &input);
+
+  // Render thread: picks up the newest snapshot, returns false until the first one is published
+  bool Acquire();
+  const FrameSnapshot &Latest() const;
+  // Pose between the previous and the latest snapshot, one tick behind the simulation so motion stays smooth at any
+  // frame rate
+  CameraPose Interpolate(uint64_t now) const;
+  // How far Interpolate() goes from the previous snapshot to the latest one, from 0.0f to 1.0f
+  float InterpolationFactor(uint64_t now) const;
+
+  uint32_t TickCount() const;
+  // FNV-1a over every camera pose, used to check that a replay followed the same path
+  uint64_t PoseHash() const;
+  // Safe to call from the render thread
+  TickStats GetTickStats() const;
+
+private:
+  World &mWorld;
+  Camera &mCamera;
+  uint32_t mTickRate;
+  uint32_t mTick;
+  uint64_t mPoseHash;
+  InputRecording *mRecording;
+
+  SDL_Thread *mThread;
+  std::atomic<bool> mQuit;
+  // Guards the input and the tick stats
+  SDL_Mutex *mInputMutex;
+  TickInput mInput;
+  TickStats mStats;
+
+  TripleBuffer<FrameSnapshot> mSnapshots;
+  // Render thread state
+  bool mHasSnapshot;
+  CameraPose mPrevious;
+
+  static int ThreadMain(void *data);
+  void Run();
+};
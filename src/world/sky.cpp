@@ -1,7 +1,10 @@
 #include "sky.h"
 #include "SDL3/SDL_surface.h"
+#include "core/baked_image.h"
+#include "core/gpu_profiler.h"
+#include "core/memory_tracker.h"
+#include "core/profiler.h"
 #include "core/shader.h"
-#include <SDL3_image/SDL_image.h>
 #include <string>
 #include <vector>
 
@@ -25,31 +28,44 @@ float skyboxVertices[] = {
     -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, -1.0f,
     1.0f,  -1.0f, -1.0f, -1.0f, -1.0f, 1.0f,  1.0f,  -1.0f, 1.0f};
 
-Sky::Sky() {
+std::unique_ptr<BakedImage> Sky::LoadFaces() {
+  // The cross layout is only cut into faces when baking, afterwards the faces are uploaded straight from the cache
+  return BakedImage::Load("assets/sky/sky.png", "cubemap", false, [](SDL_Surface *image) {
+    const int SIZE = 512;
+
+    std::vector<SDL_Rect> faceRects;
+    faceRects.push_back({2 * SIZE, SIZE, SIZE, SIZE}); // right
+    faceRects.push_back({0, SIZE, SIZE, SIZE});        // left
+    faceRects.push_back({SIZE, 0, SIZE, SIZE});        // top
+    faceRects.push_back({SIZE, 2 * SIZE, SIZE, SIZE}); // bottom
+    faceRects.push_back({SIZE, SIZE, SIZE, SIZE});     // front
+    faceRects.push_back({3 * SIZE, SIZE, SIZE, SIZE}); // back
+
+    SDL_SetSurfaceBlendMode(image, SDL_BLENDMODE_NONE);
+    std::vector<SDL_Surface *> result;
+    for (auto &faceRect : faceRects) {
+      SDL_Surface *face = SDL_CreateSurface(SIZE, SIZE, SDL_PIXELFORMAT_RGBA32);
+      SDL_BlitSurface(image, &faceRect, face, NULL);
+      result.push_back(face);
+    }
+
+    return result;
+  });
+}
+
+Sky::Sky(std::unique_ptr<Shader> shader, std::unique_ptr<BakedImage> faces) : mShader(std::move(shader)) {
+  auto profiler = Profiler::Create();
   glGenTextures(1, &mTexture);
   glBindTexture(GL_TEXTURE_CUBE_MAP, mTexture);
 
-  const int SIZE = 512;
-  SDL_Surface *image = IMG_Load("assets/sky/sky.png");
-  SDL_Surface *face = SDL_CreateSurface(SIZE, SIZE, image->format);
-
-  std::vector<SDL_Rect> faceRects;
-  faceRects.push_back({2 * SIZE, SIZE, SIZE, SIZE}); // right
-  faceRects.push_back({0, SIZE, SIZE, SIZE});        // left
-  faceRects.push_back({SIZE, 0, SIZE, SIZE});        // top
-  faceRects.push_back({SIZE, 2 * SIZE, SIZE, SIZE}); // bottom
-  faceRects.push_back({SIZE, SIZE, SIZE, SIZE});     // front
-  faceRects.push_back({3 * SIZE, SIZE, SIZE, SIZE}); // back
-
-  int i = 0;
-  for (auto &faceRect : faceRects) {
-    SDL_BlitSurface(image, &faceRect, face, NULL);
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, SIZE, SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, face->pixels);
-    ++i;
+  size_t textureBytes = 0;
+  for (int i = 0; faces && i < faces->Layers(); ++i) {
+    auto face = faces->Level(i, 0);
+    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA8, face.width, face.height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, face.pixels);
+    textureBytes += MemoryTracker::TextureBytes(face.width, face.height, 1, 4);
   }
-
-  SDL_DestroySurface(image);
-  SDL_DestroySurface(face);
+  MemoryTracker::RegisterTexture(mTexture, GpuTag::Sky, textureBytes);
 
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -62,13 +78,15 @@ Sky::Sky() {
   glBindVertexArray(mVao);
   glBindBuffer(GL_ARRAY_BUFFER, mVbo);
   glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), skyboxVertices, GL_STATIC_DRAW);
+  MemoryTracker::RegisterBuffer(mVbo, GpuTag::Sky, sizeof(skyboxVertices));
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
   glEnableVertexAttribArray(0);
-
-  mShader = Shader::Load("assets/shaders/skybox.vert", "assets/shaders/skybox.frag");
+  profiler.LogEnd("Sky uploaded");
 }
 
 Sky::~Sky() {
+  MemoryTracker::ReleaseTexture(mTexture);
+  MemoryTracker::ReleaseBuffer(mVbo);
   glDeleteTextures(1, &mTexture);
   glDeleteVertexArrays(1, &mVao);
   glDeleteBuffers(1, &mVbo);
@@ -77,10 +95,13 @@ Sky::~Sky() {
 void Sky::Render(const glm::mat4 &projection, const glm::mat4 &view) const {
   glDepthMask(GL_FALSE);
   glBindVertexArray(mVao);
+  GpuProfiler::CountStateChange();
   glBindTexture(GL_TEXTURE_CUBE_MAP, mTexture);
+  GpuProfiler::CountStateChange();
   mShader->Bind();
   mShader->UniformMat4("projection", projection);
   mShader->UniformMat4("view", glm::mat4(glm::mat3(view)));
   glDrawArrays(GL_TRIANGLES, 0, sizeof(skyboxVertices) / sizeof(float));
+  GpuProfiler::CountDraw(sizeof(skyboxVertices) / sizeof(float) / 9);
   glDepthMask(GL_TRUE);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "core/baked_image.h"
 #include "core/shader.h"
 #include <GL/glew.h>
 #include <glm/glm.hpp>
@@ -12,7 +13,10 @@ class Sky {
   std::unique_ptr<Shader> mShader;
 
 public:
-  Sky();
+  // Decodes the cubemap faces, this doesn't need the GL context and can run on any thread
+  static std::unique_ptr<BakedImage> LoadFaces();
+
+  Sky(std::unique_ptr<Shader> shader, std::unique_ptr<BakedImage> faces);
   ~Sky();
 
   void Render(const glm::mat4 &projection, const glm::mat4 &view) const;
@@ -0,0 +1,69 @@
+#include "slow_render_check.h"
+#include "SDL3/SDL_log.h"
+#include "SDL3/SDL_timer.h"
+#include <algorithm>
+#include <cmath>
+
+// Long enough for the simulation's own report, which comes every five seconds
+static const float DURATION_SECONDS = 12.0f;
+// How far the measured tick rate may be off the target
+static const float RATE_TOLERANCE = 0.02f;
+// Share of the ticks which may start more than a period late, e.g. when the OS schedules something else
+static const float MAX_LATE_SHARE = 0.01f;
+
+SlowRenderCheck::SlowRenderCheck(uint32_t tickRate)
+    : mTickRate(tickRate), mStartTime(0), mLastTime(0), mFrames(0), mMinFactor(1.0f), mMaxFactor(0.0f),
+      mFactorsOutOfRange(0), mLastTick(0), mTicksBackwards(0) {
+}
+
+void SlowRenderCheck::Record(const Simulation &simulation, uint64_t now) {
+  if (mFrames == 0) {
+    mStart = simulation.GetTickStats();
+    mStartTime = now;
+  }
+
+  float factor = simulation.InterpolationFactor(now);
+  // Written so a NaN fails it as well
+  mFactorsOutOfRange += !(factor >= 0.0f && factor <= 1.0f);
+  mMinFactor = std::min(mMinFactor, factor);
+  mMaxFactor = std::max(mMaxFactor, factor);
+
+  uint32_t tick = simulation.Latest().tick;
+  mTicksBackwards += tick < mLastTick;
+  mLastTick = tick;
+  mLastTime = now;
+  mFrames++;
+}
+
+bool SlowRenderCheck::Done() const {
+  return mFrames > 0 && mLastTime - mStartTime >= DURATION_SECONDS * SDL_GetPerformanceFrequency();
+}
+
+bool SlowRenderCheck::Passed(const Simulation &simulation) const {
+  auto end = simulation.GetTickStats();
+  uint32_t ticks = end.ticks - mStart.ticks;
+  uint32_t late = end.lateTicks - mStart.lateTicks;
+  float seconds = static_cast<float>(end.last - mStart.last) / SDL_GetPerformanceFrequency();
+  float rate = seconds > 0.0f ? ticks / seconds : 0.0f;
+  float frameMs = 1000.0f * (mLastTime - mStartTime) / SDL_GetPerformanceFrequency() / std::max(mFrames - 1, 1);
+
+  bool rateHeld = std::abs(rate - mTickRate) <= RATE_TOLERANCE * mTickRate;
+  bool fewLate = late <= MAX_LATE_SHARE * ticks;
+  bool factorsInRange = mFactorsOutOfRange == 0;
+  SDL_Log("Slow render check: %d frames of %.1f ms, %u ticks at %.2f Hz (target %u Hz), %u late, interpolation "
+          "factors %.3f to %.3f, snapshots went back %d times",
+          mFrames, frameMs, ticks, rate, mTickRate, late, mMinFactor, mMaxFactor, mTicksBackwards);
+  if (!rateHeld) {
+    SDL_Log("Slow render check failed: the tick rate is more than %.0f%% off", 100.0f * RATE_TOLERANCE);
+  }
+  if (!fewLate) {
+    SDL_Log("Slow render check failed: more than %.0f%% of the ticks were late", 100.0f * MAX_LATE_SHARE);
+  }
+  if (!factorsInRange) {
+    SDL_Log("Slow render check failed: %d interpolation factors outside [0, 1]", mFactorsOutOfRange);
+  }
+  if (mTicksBackwards > 0) {
+    SDL_Log("Slow render check failed: a frame got an older snapshot than the one before");
+  }
+  return rateHeld && fewLate && factorsInRange && mTicksBackwards == 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "simulation.h"
+#include <cstdint>
+
+// --slow-render: the render loop sleeps after every frame while the simulation ticks on its own thread. After a fixed
+// time the simulation has to have held its tick rate with hardly any late ticks, every frame's interpolation factor
+// has to lie in [0, 1] and the snapshots must never have gone back in time.
+class SlowRenderCheck {
+public:
+  SlowRenderCheck(uint32_t tickRate);
+
+  // Called once per frame with the time the frame's pose was interpolated for
+  void Record(const Simulation &simulation, uint64_t now);
+  bool Done() const;
+  // Logs the results, false if any check failed
+  bool Passed(const Simulation &simulation) const;
+
+private:
+  uint32_t mTickRate;
+  Simulation::TickStats mStart;
+  uint64_t mStartTime;
+  uint64_t mLastTime;
+  int mFrames;
+  float mMinFactor, mMaxFactor;
+  int mFactorsOutOfRange;
+  uint32_t mLastTick;
+  int mTicksBackwards;
+};
@@ -0,0 +1,174 @@
+#include "store_benchmark.h"
+#include "SDL3/SDL_log.h"
+#include "chunk_store.h"
+#include "core/benchmark.h"
+#include "terrain.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Distinct terrain chunks, in each direction
+const int CHUNKS = 8;
+const int SAVES = 4096;
+// Records in the journal the recovery cases cut up
+const int RECOVERY_CHUNKS = 16;
+const int SIZE = VoxelGrid::SIZE;
+
+struct Recovery {
+  std::string name;
+  std::streamoff cut;
+  int expected;
+  int recovered;
+  bool ok;
+};
+
+bool Matches(const std::optional<ChunkStore::SavedChunk> &loaded, const std::shared_ptr<const VoxelGrid> &grid) {
+  return loaded && loaded->content == ChunkContent::Mixed && loaded->grid &&
+         std::memcmp(loaded->grid->columns, grid->columns, sizeof(VoxelGrid)) == 0;
+}
+
+// Opens a store on a copy of the journal with everything from cut on thrown away, or with the byte at flip inverted
+Recovery Recover(const std::string &name, const std::string &journal, const std::string &directory,
+                 std::streamoff cut, std::streamoff flip, const std::vector<std::streamoff> &ends,
+                 const std::vector<std::shared_ptr<const VoxelGrid>> &grids) {
+  std::error_code error;
+  std::filesystem::remove_all(directory, error);
+  std::filesystem::create_directories(directory, error);
+  std::string copy = directory + "/chunks.journal";
+  std::filesystem::copy_file(journal, copy, error);
+  std::filesystem::resize_file(copy, cut, error);
+  if (flip >= 0) {
+    std::fstream file(copy, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekg(flip);
+    char byte = static_cast<char>(file.get() ^ 0xff);
+    file.seekp(flip);
+    file.put(byte);
+  }
+
+  // Only records which end before the damage survive
+  std::streamoff damage = flip >= 0 ? flip : cut;
+  Recovery recovery{name, flip >= 0 ? flip : cut, 0, 0, true};
+  while (recovery.expected < RECOVERY_CHUNKS && ends[recovery.expected + 1] <= damage) {
+    recovery.expected++;
+  }
+
+  ChunkStore store(directory);
+  recovery.recovered = static_cast<int>(store.Size());
+  recovery.ok = recovery.recovered == recovery.expected;
+  for (int i = 0; i < RECOVERY_CHUNKS; ++i) {
+    auto loaded = store.Load({i, 0, 0});
+    recovery.ok = recovery.ok && (i < recovery.expected ? Matches(loaded, grids[i]) : !loaded);
+  }
+  return recovery;
+}
+
+} // namespace
+
+bool RunStoreBenchmark(int seed, const std::string &path) {
+  Terrain terrain(seed);
+  std::vector<std::shared_ptr<const VoxelGrid>> grids;
+  for (int cx = 0; cx < CHUNKS; ++cx) {
+    for (int cz = 0; cz < CHUNKS; ++cz) {
+      auto grid = std::make_shared<VoxelGrid>();
+      terrain.Region(cx * SIZE, 0, cz * SIZE, SIZE, SIZE, grid->columns);
+      grids.push_back(grid);
+    }
+  }
+
+  std::string directory = path + ".store";
+  std::error_code error;
+  std::filesystem::remove_all(directory, error);
+
+  // Throughput: every save goes to a different chunk, so nothing is merged in the queue
+  float enqueueMs = 0.0f, writeMs = 0.0f, compactMs = 0.0f;
+  size_t bytes = 0;
+  bool pendingVisible = true, reloaded = true;
+  {
+    ChunkStore store(directory + "/throughput");
+    auto start = SDL_GetPerformanceCounter();
+    Uint64 enqueue = 0;
+    for (int i = 0; i < SAVES; ++i) {
+      auto before = SDL_GetPerformanceCounter();
+      store.Save({i % 64, 0, i / 64}, ChunkContent::Mixed, grids[i % grids.size()]);
+      enqueue += SDL_GetPerformanceCounter() - before;
+    }
+    // Whatever the thread hasn't written yet has to come out of the queue
+    pendingVisible = Matches(store.Load({(SAVES - 1) % 64, 0, (SAVES - 1) / 64}), grids[(SAVES - 1) % grids.size()]);
+    store.Flush();
+    writeMs = ElapsedMs(start);
+    enqueueMs = TicksToMs(enqueue);
+    bytes = store.GetStats().bytesWritten;
+
+    start = SDL_GetPerformanceCounter();
+    store.Compact();
+    compactMs = ElapsedMs(start);
+    for (int i = 0; i < SAVES; i += 97) {
+      reloaded = reloaded && Matches(store.Load({i % 64, 0, i / 64}), grids[i % grids.size()]);
+    }
+  }
+
+  // Recovery: one record per flush, so the end of every record in the journal is known
+  std::vector<std::streamoff> ends;
+  std::string journal = directory + "/journal.copy";
+  {
+    ChunkStore store(directory + "/source");
+    ends.push_back(std::filesystem::file_size(store.JournalPath(), error));
+    for (int i = 0; i < RECOVERY_CHUNKS; ++i) {
+      store.Save({i, 0, 0}, ChunkContent::Mixed, grids[i]);
+      store.Flush();
+      ends.push_back(std::filesystem::file_size(store.JournalPath(), error));
+    }
+    // What the disk holds if the process dies now, closing the store would merge the journal into storage
+    std::filesystem::copy_file(store.JournalPath(), journal, error);
+  }
+
+  std::vector<Recovery> recoveries;
+  std::mt19937 random(seed);
+  for (int i = 0; i <= RECOVERY_CHUNKS; ++i) {
+    recoveries.push_back(Recover("cut at record end", journal, directory + "/recover", ends[i], -1, ends, grids));
+    if (i < RECOVERY_CHUNKS) {
+      std::uniform_int_distribution<std::streamoff> inside(ends[i] + 1, ends[i + 1] - 1);
+      recoveries.push_back(
+          Recover("cut inside record", journal, directory + "/recover", inside(random), -1, ends, grids));
+    }
+  }
+  int damaged = RECOVERY_CHUNKS / 2;
+  std::uniform_int_distribution<std::streamoff> inside(ends[damaged], ends[damaged + 1] - 1);
+  recoveries.push_back(
+      Recover("flipped byte", journal, directory + "/recover", ends.back(), inside(random), ends, grids));
+  std::filesystem::remove_all(directory, error);
+
+  BenchmarkCsv out(path);
+  if (!out.Ok()) {
+    return false;
+  }
+
+  float mb = bytes / (1024.0f * 1024.0f);
+  float writeSeconds = writeMs / 1000.0f;
+  out.Table("chunks,enqueue_us_per_chunk,write_ms,chunks_per_second,mb_per_second,compact_ms");
+  out.Row(SAVES, enqueueMs * 1000.0f / SAVES, writeMs, SAVES / writeSeconds, mb / writeSeconds, compactMs);
+  SDL_Log("Store benchmark: %.2f us per save on the caller, %.0f chunks/s (%.1f MB/s) to the journal, compaction "
+          "%.1f ms",
+          enqueueMs * 1000.0f / SAVES, SAVES / writeSeconds, mb / writeSeconds, compactMs);
+  if (!pendingVisible || !reloaded) {
+    SDL_Log("Store benchmark: %s", pendingVisible ? "chunks read back differently" : "queued save not visible");
+  }
+
+  bool recovered = true;
+  out.Table("case,offset,expected_records,recovered_records,ok");
+  for (const auto &recovery : recoveries) {
+    out.Row(recovery.name, recovery.cut, recovery.expected, recovery.recovered, recovery.ok);
+    recovered = recovered && recovery.ok;
+    if (!recovery.ok) {
+      SDL_Log("Store recovery failed (%s at %lld): %d records expected, %d recovered", recovery.name.c_str(),
+              static_cast<long long>(recovery.cut), recovery.expected, recovery.recovered);
+    }
+  }
+  SDL_Log("Store recovery: %zu damaged journals, %s", recoveries.size(), recovered ? "all recovered" : "FAILED");
+
+  return pendingVisible && reloaded && recovered;
+}
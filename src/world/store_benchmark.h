@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+// Saves terrain chunks through the chunk store and reports how long a save keeps the caller busy, how many chunks per
+// second reach the journal, synced to the disk, and how long a compaction takes. Then cuts the journal off at every
+// record and in the middle of every record, flips a byte in one record, and checks that reopening the store recovers
+// exactly the records before the damage.
+//
+// The cuts cover how replay handles a journal whose last append was torn, whatever the cause. They don't crash the
+// process or the machine, so whether synced records really reach the disk is left to the OS keeping its fsync()
+// promise. Runs on the CPU only, the store lives next to the results in <path>.store.
+bool RunStoreBenchmark(int seed, const std::string &path);
@@ -0,0 +1,125 @@
+#include "terrain.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Lattice samples per lattice column, one on every chunk border
+static const int LATTICE_Y = VoxelGrid::SIZE / Terrain::LATTICE_STEP + 1;
+
+// Voxels between the surface and a density of 1, the caves can't reach further from the surface than that
+static const float SURFACE_FALLOFF = 24.0f;
+static const float CAVE_STRENGTH = 1.0f;
+
+static int LatticeIndex(int voxel) {
+  return voxel >= 0 ? voxel / Terrain::LATTICE_STEP : (voxel + 1) / Terrain::LATTICE_STEP - 1;
+}
+
+// Density of a column from the four lattice columns around it, tx and tz are its position between them
+static void InterpolateColumn(const float *c00, const float *c10, const float *c01, const float *c11, float tx,
+                              float tz, float *density) {
+  float lattice[LATTICE_Y];
+  for (int j = 0; j < LATTICE_Y; ++j) {
+    float front = c00[j] + (c10[j] - c00[j]) * tx;
+    float back = c01[j] + (c11[j] - c01[j]) * tx;
+    lattice[j] = front + (back - front) * tz;
+  }
+
+  for (int y = 0; y < VoxelGrid::SIZE; ++y) {
+    int j = y / Terrain::LATTICE_STEP;
+    float t = static_cast<float>(y % Terrain::LATTICE_STEP) / Terrain::LATTICE_STEP;
+    density[y] = lattice[j] + (lattice[j + 1] - lattice[j]) * t;
+  }
+}
+
+// Branch free, both loops vectorize
+static u64 Threshold(const float *density) {
+  uint8_t solid[VoxelGrid::SIZE];
+  for (int y = 0; y < VoxelGrid::SIZE; ++y) {
+    solid[y] = density[y] > 0.0f;
+  }
+
+  u64 column = 0;
+  for (int y = 0; y < VoxelGrid::SIZE; ++y) {
+    column |= static_cast<u64>(solid[y]) << y;
+  }
+  return column;
+}
+
+Terrain::Terrain(int seed) {
+  mNoise.SetSeed(seed);
+  mNoise.SetNoiseType(FastNoiseLite::NoiseType_Cellular);
+  mNoise.SetFrequency(0.005);
+  mNoise.SetFractalType(FastNoiseLite::FractalType_FBm);
+
+  mCaves.SetSeed(seed + 1);
+  mCaves.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+  mCaves.SetFrequency(0.02);
+  mCaves.SetFractalType(FastNoiseLite::FractalType_None);
+}
+
+float Terrain::Surface(float x, float z) const {
+  // Noise mapped to roughly [0, 1] of the chunk height
+  return (mNoise.GetNoise(x, 0.0f, z) + 0.5f) * VoxelGrid::SIZE;
+}
+
+float Terrain::Density(float x, float y, float z, float surface) const {
+  return (surface - y) / SURFACE_FALLOFF + mCaves.GetNoise(x, y, z) * CAVE_STRENGTH;
+}
+
+void Terrain::SampleLattice(int x, int chunkY, int z, float *samples) const {
+  float surface = Surface(x, z);
+  for (int j = 0; j < LATTICE_Y; ++j) {
+    float y = static_cast<float>(chunkY * VoxelGrid::SIZE + j * LATTICE_STEP);
+    samples[j] = Density(x, y, z, surface);
+  }
+}
+
+u64 Terrain::Column(int x, int chunkY, int z) const {
+  u64 column;
+  Region(x, chunkY, z, 1, 1, &column);
+  return column;
+}
+
+void Terrain::Region(int x, int chunkY, int z, int width, int depth, u64 *columns) const {
+  int firstX = LatticeIndex(x);
+  int firstZ = LatticeIndex(z);
+  int latticeWidth = LatticeIndex(x + width - 1) - firstX + 2;
+  int latticeDepth = LatticeIndex(z + depth - 1) - firstZ + 2;
+
+  std::vector<float> lattice(latticeWidth * latticeDepth * LATTICE_Y);
+  for (int i = 0; i < latticeWidth; ++i) {
+    for (int k = 0; k < latticeDepth; ++k) {
+      SampleLattice((firstX + i) * LATTICE_STEP, chunkY, (firstZ + k) * LATTICE_STEP,
+                    &lattice[(i * latticeDepth + k) * LATTICE_Y]);
+    }
+  }
+
+  float density[VoxelGrid::SIZE];
+  for (int i = 0; i < width; ++i) {
+    int li = LatticeIndex(x + i);
+    float tx = static_cast<float>(x + i - li * LATTICE_STEP) / LATTICE_STEP;
+    for (int k = 0; k < depth; ++k) {
+      int lk = LatticeIndex(z + k);
+      float tz = static_cast<float>(z + k - lk * LATTICE_STEP) / LATTICE_STEP;
+      auto corner = [&](int di, int dk) {
+        return &lattice[((li - firstX + di) * latticeDepth + lk - firstZ + dk) * LATTICE_Y];
+      };
+
+      InterpolateColumn(corner(0, 0), corner(1, 0), corner(0, 1), corner(1, 1), tx, tz, density);
+      columns[i * depth + k] = Threshold(density);
+    }
+  }
+}
+
+void Terrain::ColumnDensity(int x, int chunkY, int z, float *density) const {
+  int li = LatticeIndex(x);
+  int lk = LatticeIndex(z);
+  float corners[4][LATTICE_Y];
+  for (int corner = 0; corner < 4; ++corner) {
+    SampleLattice((li + corner % 2) * LATTICE_STEP, chunkY, (lk + corner / 2) * LATTICE_STEP, corners[corner]);
+  }
+
+  float tx = static_cast<float>(x - li * LATTICE_STEP) / LATTICE_STEP;
+  float tz = static_cast<float>(z - lk * LATTICE_STEP) / LATTICE_STEP;
+  InterpolateColumn(corners[0], corners[1], corners[2], corners[3], tx, tz, density);
+}
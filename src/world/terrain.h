@@ -0,0 +1,38 @@
+#pragma once
+
+#include "voxel_grid.h"
+#include <FastNoiseLite.h>
+
+// Terrain generator shared by everything that needs to know what the world looks like, so chunks and the columns
+// around them always agree.
+//
+// The terrain is a 3D density field, a voxel is solid where the density is positive: a height map term that falls off
+// with the distance to the surface, plus 3D noise which carves caves and pushes out overhangs. Noise is only sampled on
+// a lattice every LATTICE_STEP voxels and interpolated trilinearly in between, a 64^3 chunk takes 17^3 samples instead
+// of 64^3. Lattice points sit at fixed world positions, so a column comes out the same no matter which region it was
+// generated with.
+class Terrain {
+public:
+  static const int LATTICE_STEP = 4;
+
+  Terrain(int seed);
+
+  // Solid voxels of the column at world position (x, z), bit n is the voxel at chunkY * SIZE + n
+  u64 Column(int x, int chunkY, int z) const;
+  // Columns of the world area [x, x + width) x [z, z + depth), stored at columns[i * depth + k]. Shares the lattice
+  // between neighbouring columns, use it for anything bigger than a few columns.
+  void Region(int x, int chunkY, int z, int width, int depth, u64 *columns) const;
+
+  // The density the lattice interpolates, sampled at full resolution
+  float Surface(float x, float z) const;
+  float Density(float x, float y, float z, float surface) const;
+  // Interpolated density of the SIZE voxels of a column, what Column() thresholds
+  void ColumnDensity(int x, int chunkY, int z, float *density) const;
+
+private:
+  FastNoiseLite mNoise;
+  FastNoiseLite mCaves;
+
+  // Density at the lattice points of one lattice column, LATTICE_Y values from the bottom of the chunk up
+  void SampleLattice(int x, int chunkY, int z, float *samples) const;
+};
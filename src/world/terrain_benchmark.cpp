@@ -0,0 +1,161 @@
+#include "terrain_benchmark.h"
+#include "SDL3/SDL_log.h"
+#include "core/benchmark.h"
+#include "terrain.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Chunks generated per method, in each direction
+const int CHUNKS = 4;
+const int RUNS = 3;
+const int SIZE = VoxelGrid::SIZE;
+
+struct Result {
+  const char *method;
+  long samplesPerChunk;
+  float msPerChunk;
+  long solidVoxels;
+};
+
+// Noise sampled at every voxel: the surface once per column, the caves once per voxel
+long GenerateFull(const Terrain &terrain, int cx, int cz, VoxelGrid &grid, std::vector<float> *density) {
+  long samples = 0;
+  for (int x = 0; x < SIZE; ++x) {
+    for (int z = 0; z < SIZE; ++z) {
+      float worldX = cx * SIZE + x;
+      float worldZ = cz * SIZE + z;
+      float surface = terrain.Surface(worldX, worldZ);
+      u64 column = 0;
+      for (int y = 0; y < SIZE; ++y) {
+        float value = terrain.Density(worldX, y, worldZ, surface);
+        column |= static_cast<u64>(value > 0.0f) << y;
+        if (density) {
+          (*density)[(x * SIZE + z) * SIZE + y] = value;
+        }
+      }
+      grid.columns[x * SIZE + z] = column;
+      samples += 1 + SIZE;
+    }
+  }
+  return samples;
+}
+
+long CountSolid(const VoxelGrid &grid) {
+  long solid = 0;
+  for (u64 column : grid.columns) {
+    solid += std::popcount(column);
+  }
+  return solid;
+}
+
+template <typename Generate> Result Measure(const char *method, Generate &&generate) {
+  Result result{method, 0, 0.0f, 0};
+  VoxelGrid grid;
+  float ms = BestOfRuns(RUNS, [&] {
+    result.samplesPerChunk = 0;
+    result.solidVoxels = 0;
+    for (int cx = 0; cx < CHUNKS; ++cx) {
+      for (int cz = 0; cz < CHUNKS; ++cz) {
+        result.samplesPerChunk += generate(cx, cz, grid);
+        result.solidVoxels += CountSolid(grid);
+      }
+    }
+  });
+  result.msPerChunk = ms / (CHUNKS * CHUNKS);
+  result.samplesPerChunk /= CHUNKS * CHUNKS;
+  return result;
+}
+
+struct ErrorStats {
+  float maxError = 0.0f;
+  double squaredError = 0.0;
+  long voxels = 0;
+  long mismatches = 0;
+  // Largest second differences of the full resolution density along x, y and z
+  float curvature[3] = {0.0f, 0.0f, 0.0f};
+};
+
+void MeasureError(const Terrain &terrain, int cx, int cz, ErrorStats &stats) {
+  VoxelGrid grid;
+  std::vector<float> exact(SIZE * SIZE * SIZE);
+  GenerateFull(terrain, cx, cz, grid, &exact);
+  auto at = [&](int x, int y, int z) { return exact[(x * SIZE + z) * SIZE + y]; };
+
+  float interpolated[SIZE];
+  for (int x = 0; x < SIZE; ++x) {
+    for (int z = 0; z < SIZE; ++z) {
+      terrain.ColumnDensity(cx * SIZE + x, 0, cz * SIZE + z, interpolated);
+      for (int y = 0; y < SIZE; ++y) {
+        float error = std::abs(interpolated[y] - at(x, y, z));
+        stats.maxError = std::max(stats.maxError, error);
+        stats.squaredError += error * error;
+        stats.voxels++;
+        stats.mismatches += (interpolated[y] > 0.0f) != (at(x, y, z) > 0.0f);
+
+        float center = 2.0f * at(x, y, z);
+        if (x > 0 && x < SIZE - 1) {
+          stats.curvature[0] = std::max(stats.curvature[0], std::abs(at(x - 1, y, z) - center + at(x + 1, y, z)));
+        }
+        if (y > 0 && y < SIZE - 1) {
+          stats.curvature[1] = std::max(stats.curvature[1], std::abs(at(x, y - 1, z) - center + at(x, y + 1, z)));
+        }
+        if (z > 0 && z < SIZE - 1) {
+          stats.curvature[2] = std::max(stats.curvature[2], std::abs(at(x, y, z - 1) - center + at(x, y, z + 1)));
+        }
+      }
+    }
+  }
+}
+
+} // namespace
+
+bool RunTerrainBenchmark(int seed, const std::string &path) {
+  Terrain terrain(seed);
+
+  Result results[] = {
+      Measure("lattice",
+              [&](int cx, int cz, VoxelGrid &grid) {
+                terrain.Region(cx * SIZE, 0, cz * SIZE, SIZE, SIZE, grid.columns);
+                // One surface sample per lattice column plus one cave sample per lattice point
+                long lattice = SIZE / Terrain::LATTICE_STEP + 1;
+                return lattice * lattice * (1 + lattice);
+              }),
+      Measure("full", [&](int cx, int cz, VoxelGrid &grid) { return GenerateFull(terrain, cx, cz, grid, nullptr); }),
+  };
+
+  // Trilinear interpolation of a function with second derivatives up to f'' is off by at most h^2 / 8 times the sum of
+  // f'' along the three axes, h being the lattice step
+  ErrorStats stats;
+  for (int cx = 0; cx < CHUNKS; ++cx) {
+    for (int cz = 0; cz < CHUNKS; ++cz) {
+      MeasureError(terrain, cx, cz, stats);
+    }
+  }
+  float step = Terrain::LATTICE_STEP;
+  float bound = step * step / 8.0f * (stats.curvature[0] + stats.curvature[1] + stats.curvature[2]);
+  float rmsError = std::sqrt(stats.squaredError / std::max(stats.voxels, 1l));
+  bool withinBound = stats.maxError <= bound * 1.01f + 1e-5f;
+
+  BenchmarkCsv out(path);
+  if (!out.Ok()) {
+    return false;
+  }
+
+  out.Table("method,chunks,samples_per_chunk,ms_per_chunk,solid_voxels");
+  for (const auto &result : results) {
+    out.Row(result.method, CHUNKS * CHUNKS, result.samplesPerChunk, result.msPerChunk, result.solidVoxels);
+    SDL_Log("Terrain benchmark %s: %ld samples and %.3f ms per chunk, %ld solid voxels", result.method,
+            result.samplesPerChunk, result.msPerChunk, result.solidVoxels);
+  }
+  out.Table("max_error,rms_error,error_bound,voxels,mismatched_voxels");
+  out.Row(stats.maxError, rmsError, bound, stats.voxels, stats.mismatches);
+  SDL_Log("Terrain interpolation: max error %.4f, rms %.4f, bound %.4f, %ld of %ld voxels differ (%.2f%%)%s",
+          stats.maxError, rmsError, bound, stats.mismatches, stats.voxels, 100.0f * stats.mismatches / stats.voxels,
+          withinBound ? "" : ", ERROR BOUND EXCEEDED");
+
+  return withinBound;
+}
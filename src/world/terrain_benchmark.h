@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+// Generates the same chunks from the interpolated noise lattice and from noise sampled at every voxel, and reports
+// samples and milliseconds per chunk for both. Also checks that the interpolated density stays within the error bound
+// of trilinear interpolation. Runs on the CPU only.
+bool RunTerrainBenchmark(int seed, const std::string &path);
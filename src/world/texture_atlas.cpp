@@ -1,28 +1,59 @@
 #include "texture_atlas.h"
+#include "core/baked_image.h"
+#include "core/gpu_profiler.h"
+#include "core/memory_tracker.h"
+#include "core/profiler.h"
 #include <GL/glew.h>
 #include <SDL3/SDL.h>
-#include <SDL3_image/SDL_image.h>
+#include <algorithm>
 #include <cassert>
 #include <glm/glm.hpp>
 
+// Edge of the atlas texture when it holds more than one tile
+static const int ATLAS_SIZE = 4096;
+
 TextureAtlasBuilder::TextureAtlasBuilder(const int tileSize) : mTileSize(tileSize) {
 }
 
 void TextureAtlasBuilder::AddTexture(TextureType type, const std::string &texture) {
-  mEntries.push_back({.type = type, .texturePath = texture});
+  mEntries.push_back({.type = type, .texturePath = texture, .image = nullptr});
 }
 
 std::unique_ptr<TextureAtlas> TextureAtlasBuilder::Build() {
+  if (!Decode()) {
+    return nullptr;
+  }
+
+  return Upload();
+}
+
+bool TextureAtlasBuilder::Decode() {
+  auto profiler = Profiler::Create();
+  auto whole = [](SDL_Surface *surface) { return std::vector<SDL_Surface *>{surface}; };
+
+  for (auto &entry : mEntries) {
+    entry.image = BakedImage::Load(entry.texturePath, "tile", true, whole);
+    if (!entry.image) {
+      return false;
+    }
+  }
+
+  profiler.LogEnd("Texture atlas decoded");
+  return true;
+}
+
+std::unique_ptr<TextureAtlas> TextureAtlasBuilder::Upload() {
   if (mEntries.size() == 0) {
     return nullptr;
   }
 
+  auto profiler = Profiler::Create();
+
   // TODO: This is an optimization, if the atlas only has 1 texture we just create a texture of that size
   // Note: This is ugly and should be refactored in some way
   if (mEntries.size() == 1) {
-    auto entry = *mEntries.begin();
-    SDL_Surface *surface = IMG_Load(entry.texturePath.c_str());
-    entry.image = surface;
+    auto &entry = *mEntries.begin();
+    auto &image = entry.image;
 
     GLuint texture;
     glCreateTextures(GL_TEXTURE_2D, 1, &texture);
@@ -32,25 +63,27 @@ std::unique_ptr<TextureAtlas> TextureAtlasBuilder::Build() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, 8.0f);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, surface->w, surface->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, surface->pixels);
-    std::vector<TextureAtlasEntry> entries;
-    entries.push_back({
-        .type = entry.type,
-        .start = {0.0f, 0.0f},
-        .end = {1.0f, 1.0f},
-    });
-    SDL_DestroySurface(entry.image);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    glTextureStorage2D(texture, image->Levels(), GL_RGBA8, image->Width(), image->Height());
+    MemoryTracker::RegisterTexture(texture, GpuTag::Atlas,
+                                   MemoryTracker::TextureBytes(image->Width(), image->Height(), image->Levels(), 4));
+    for (int level = 0; level < image->Levels(); ++level) {
+      auto data = image->Level(0, level);
+      glTextureSubImage2D(texture, level, 0, 0, data.width, data.height, GL_RGBA, GL_UNSIGNED_BYTE, data.pixels);
+    }
 
-    return std::make_unique<TextureAtlas>(texture, entries);
+    entry.image.reset();
+    profiler.LogEnd("Texture atlas uploaded");
+    return std::make_unique<TextureAtlas>(texture, Entries());
   } else {
     // If there are 2 or more entries in the list, we want to create a texture atlas with all textures copied into a
     // single, larger texture
-    const float size = 4096.0f;
+    const float size = ATLAS_SIZE;
 
-    for (auto &entry : mEntries) {
-      SDL_Surface *surface = IMG_Load(entry.texturePath.c_str());
-      entry.image = surface;
+    // Mip levels stop at one texel per tile, further levels would blend neighbouring tiles together. Since tiles are
+    // aligned to their size, level N of the atlas is just level N of every tile at offset / 2^N.
+    int levels = 1;
+    while ((mTileSize >> levels) > 0) {
+      levels++;
     }
 
     GLuint texture;
@@ -60,38 +93,68 @@ std::unique_ptr<TextureAtlas> TextureAtlasBuilder::Build() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
-
-    std::vector<TextureAtlasEntry> entries;
-    int offsetX = 0;
-    int offsetY = 0;
-
-    for (auto &entry : mEntries) {
-      glTextureSubImage2D(texture, 0, offsetX, offsetY, mTileSize, mTileSize, GL_RGBA, GL_UNSIGNED_BYTE,
-                          entry.image->pixels);
-
-      // TODO: Here we are removing 1px from all sides of the texture to prevent a black artifact around the edges of
-      // the texture There is probably a better way to do it, e.g. to create textures with +2 on both sides, repeating
-      // the textures outer 1 pixel, essentially adding a border to the texture.
-      entries.push_back({
-          .type = entry.type,
-          .start = {(offsetX + 1) / size, (offsetY + 1) / size},
-          .end = {(offsetX + mTileSize - 1) / size, (offsetY + mTileSize - 1) / size},
-      });
-
-      offsetX += mTileSize;
-      if (offsetX + mTileSize >= size) {
-        offsetX = 0;
-        offsetY += mTileSize;
+    glTextureStorage2D(texture, levels, GL_RGBA8, size, size);
+    MemoryTracker::RegisterTexture(texture, GpuTag::Atlas, MemoryTracker::TextureBytes(size, size, levels, 4));
+
+    auto offsets = TileOffsets();
+    for (size_t i = 0; i < mEntries.size(); ++i) {
+      auto &image = mEntries[i].image;
+      for (int level = 0; level < std::min(levels, image->Levels()); ++level) {
+        auto data = image->Level(0, level);
+        glTextureSubImage2D(texture, level, offsets[i].x >> level, offsets[i].y >> level, data.width, data.height,
+                            GL_RGBA, GL_UNSIGNED_BYTE, data.pixels);
       }
 
-      SDL_DestroySurface(entry.image);
+      image.reset();
     }
 
-    glGenerateMipmap(GL_TEXTURE_2D);
+    profiler.LogEnd("Texture atlas uploaded");
+    return std::make_unique<TextureAtlas>(texture, Entries());
+  }
+}
 
-    return std::make_unique<TextureAtlas>(texture, entries);
+std::vector<glm::ivec2> TextureAtlasBuilder::TileOffsets() const {
+  std::vector<glm::ivec2> offsets;
+  int offsetX = 0;
+  int offsetY = 0;
+  for (size_t i = 0; i < mEntries.size(); ++i) {
+    offsets.push_back({offsetX, offsetY});
+    offsetX += mTileSize;
+    if (offsetX + mTileSize >= ATLAS_SIZE) {
+      offsetX = 0;
+      offsetY += mTileSize;
+    }
   }
+
+  return offsets;
+}
+
+std::vector<TextureAtlasEntry> TextureAtlasBuilder::Entries() const {
+  std::vector<TextureAtlasEntry> entries;
+  if (mEntries.size() == 1) {
+    entries.push_back({
+        .type = mEntries.front().type,
+        .start = {0.0f, 0.0f},
+        .end = {1.0f, 1.0f},
+    });
+    return entries;
+  }
+
+  const float size = ATLAS_SIZE;
+  auto offsets = TileOffsets();
+  for (size_t i = 0; i < mEntries.size(); ++i) {
+    // TODO: Here we are removing 1px from all sides of the texture to prevent a black artifact around the edges of
+    // the texture There is probably a better way to do it, e.g. to create textures with +2 on both sides, repeating
+    // the textures outer 1 pixel, essentially adding a border to the texture.
+    auto offset = offsets[i];
+    entries.push_back({
+        .type = mEntries[i].type,
+        .start = {(offset.x + 1) / size, (offset.y + 1) / size},
+        .end = {(offset.x + mTileSize - 1) / size, (offset.y + mTileSize - 1) / size},
+    });
+  }
+
+  return entries;
 }
 
 void TextureAtlas::Bind(const unsigned int unit) const {
@@ -120,6 +183,7 @@ void TextureAtlas::Bind(const unsigned int unit) const {
       break;
   }
   glBindTexture(GL_TEXTURE_2D, mId);
+  GpuProfiler::CountStateChange();
 }
 
 TextureAtlas::TextureAtlas(const GLuint id, const std::vector<TextureAtlasEntry> &entries)
@@ -127,6 +191,11 @@ TextureAtlas::TextureAtlas(const GLuint id, const std::vector<TextureAtlasEntry>
 }
 
 TextureAtlas::~TextureAtlas() {
+  if (mId == 0) {
+    return;
+  }
+
+  MemoryTracker::ReleaseTexture(mId);
   glDeleteTextures(1, &mId);
 }
 
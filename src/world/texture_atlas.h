@@ -1,5 +1,6 @@
 #pragma once
 
+#include "core/baked_image.h"
 #include <GL/glew.h>
 #include <SDL3/SDL.h>
 #include <glm/glm.hpp>
@@ -28,6 +29,7 @@ class TextureAtlas {
   std::vector<TextureAtlasEntry> mEntries;
 
 public:
+  // Without a texture (id 0) the atlas only hands out texture coordinates, e.g. for meshing without a GL context
   TextureAtlas(const GLuint id, const std::vector<TextureAtlasEntry> &entries);
   ~TextureAtlas();
 
@@ -40,14 +42,24 @@ class TextureAtlasBuilder {
   struct Entry {
     TextureType type;
     std::string texturePath;
-    SDL_Surface *image;
+    std::unique_ptr<BakedImage> image;
   };
 
   std::vector<Entry> mEntries;
   int mTileSize;
 
+  // Top left pixel of every tile in a multi tile atlas
+  std::vector<glm::ivec2> TileOffsets() const;
+
 public:
   TextureAtlasBuilder(const int tileSize);
   void AddTexture(const TextureType type, const std::string &texture);
   std::unique_ptr<TextureAtlas> Build();
+
+  // Build() split in two: Decode() only touches the CPU and may run on any thread, Upload() needs the GL context
+  bool Decode();
+  std::unique_ptr<TextureAtlas> Upload();
+
+  // Texture coordinates of every tile, the same ones Upload() gives the atlas. Needs neither Decode() nor GL.
+  std::vector<TextureAtlasEntry> Entries() const;
 };
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+struct Vertex {
+  glm::vec3 position;
+  glm::vec2 textureCoords;
+  glm::vec3 normal;
+  // Light and ambient occlusion share the four bytes light took as a float. Both are normalized bytes, see UnitByte().
+  uint8_t light;
+  uint8_t occlusion;
+  uint8_t padding[2];
+};
+
+// A level from 0 to max as a normalized byte, which the shader reads as level / max. Light (max 15) and ambient
+// occlusion (max 3) both divide 255, so the levels come out exact.
+inline uint8_t UnitByte(int level, int max) {
+  return static_cast<uint8_t>(level * (255 / max));
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+// Solid voxels of a Size^3 chunk, one word per (x, z) column with bit y set for a solid voxel. The edge size is a
+// template parameter so the mesher's bounds are compile-time constants.
+template <int Size>
+struct BasicVoxelGrid {
+  static_assert(Size == 16 || Size == 32 || Size == 64, "Chunk edge must match a column word size");
+
+  using Column = std::conditional_t<Size == 16, u16, std::conditional_t<Size == 32, u32, u64>>;
+
+  static constexpr int SIZE = Size;
+  Column columns[SIZE * SIZE];
+
+  bool operator()(int x, int y, int z) const {
+    return columns[x * SIZE + z] & (static_cast<Column>(1) << y);
+  }
+};
+
+using VoxelGrid = BasicVoxelGrid<64>;
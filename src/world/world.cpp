@@ -1,92 +1,601 @@
 #include "world.h"
-#include "SDL3/SDL_thread.h"
-#include "core/profiler.h"
+#include "SDL3/SDL_cpuinfo.h"
+#include "SDL3/SDL_timer.h"
+#include "core/gpu_profiler.h"
+#include "core/memory_tracker.h"
 #include "glm/ext/matrix_transform.hpp"
+#include <algorithm>
 #include <memory>
+#include <string>
+#include <unordered_set>
 #include <utility>
 
-int GenerateChunkVertices(void *data) {
-  auto profiler = Profiler::Create();
-  Chunk *chunk = static_cast<Chunk *>(data);
-  chunk->GenerateVertices();
-  profiler.LogEnd("Chunk generated");
-  return 0;
-}
+// Staging space for chunk meshes, a typical chunk is well under a megabyte
+static const size_t STREAMING_BUFFER_SIZE = 64 * 1024 * 1024;
+// Every loaded chunk mesh, chunks that don't fit get a buffer of their own
+static const size_t MESH_POOL_SIZE = 256 * 1024 * 1024;
+
+// Edited and pregenerated chunks are stored under <SAVE_DIRECTORY>/world-<seed>
+static const char *SAVE_DIRECTORY = "saves";
+
+// Chunks within this angle of the view direction count as visible for the streaming stats (~60 degrees)
+static const float VIEW_CONE_COS = 0.5f;
+
+// Below this speed in voxels per update the load square is far enough ahead on its own
+static const float PREFETCH_MIN_SPEED = 0.25f;
+// Anything faster is a teleport, e.g. a camera path jumping back to its start
+static const float TELEPORT_DISTANCE = 2.0f * VoxelGrid::SIZE;
+// Weight of the newest movement in the smoothed velocity
+static const float VELOCITY_SMOOTHING = 0.2f;
+// Prefetch statistics are logged at most this often, in updates
+static const unsigned long PREFETCH_REPORT_INTERVAL = 600;
+
+// The sand ticks next to the chunk workers, which already take all but one core
+static const int SAND_THREADS = 1;
 
-World::World(const int seed, const glm::ivec3 &chunkDimensions) : mSeed(seed), mChunkDimensions(chunkDimensions) {
+TextureAtlasBuilder World::CreateAtlasBuilder() {
   TextureAtlasBuilder atlasBuilder(16);
   atlasBuilder.AddTexture(TextureType::Dirt, "assets/textures/dirt.png");
   // atlasBuilder.AddTexture(TextureType::Dirt, "assets/textures/sand.png");
-  mTextureAtlas = atlasBuilder.Build();
+  return atlasBuilder;
+}
+
+std::string World::SavePath(int seed) {
+  return std::string(SAVE_DIRECTORY) + "/world-" + std::to_string(seed);
+}
+
+bool World::InViewCone(const glm::ivec3 &chunkPosition, const glm::vec3 &eye, const glm::vec3 &viewDirection) {
+  glm::vec3 center = (glm::vec3(chunkPosition) + 0.5f) * static_cast<float>(VoxelGrid::SIZE);
+  glm::vec3 toChunk = center - eye;
+  toChunk.y = 0.0f;
+  glm::vec3 direction{viewDirection.x, 0.0f, viewDirection.z};
+  return glm::length(toChunk) <= 0.001f || glm::length(direction) <= 0.001f ||
+         glm::dot(glm::normalize(toChunk), glm::normalize(direction)) >= VIEW_CONE_COS;
+}
 
-  Update({0, 0, 0});
+World::World(const int seed, std::unique_ptr<TextureAtlas> atlas)
+    : mSeed(seed), mTerrain(seed), mChunkDimensions(VoxelGrid::SIZE), mChunks(2 * LOAD_RADIUS + 2),
+      mTextureAtlas(std::move(atlas)), mCenterChunk(0), mViewDirection(0.0f), mPrefetch(true), mGpuMeshing(false),
+      mUpdates(0), mLastPosition(0.0f), mVelocity(0.0f) {
+  mPool = std::make_unique<MeshPool>(MESH_POOL_SIZE / sizeof(Vertex));
+  mStore = std::make_unique<ChunkStore>(SavePath(seed));
+  mStreaming = std::make_unique<StreamingBuffer>(STREAMING_BUFFER_SIZE);
+  mScheduler = std::make_unique<ChunkScheduler>(std::max(1, SDL_GetNumLogicalCPUCores() - 1), mStreaming.get());
+  mSand = std::make_unique<SandSimulation>(SAND_THREADS);
 }
 
 World::~World() {
-  for (auto &entry : mChunks) {
-    delete entry.second;
+  // Only queued here, the store writes them out when it is destroyed after the chunks
+  mChunks.ForEach([&](Chunk &chunk) {
+    if (chunk.mDirty.exchange(false)) {
+      mStore->Save(chunk.mPosition, chunk.mContent, chunk.mGrid);
+    }
+    chunk.mCancelled = true;
+  });
+  // Newer than the loaded chunks, saved after them
+  while (!mRemeshing.empty()) {
+    DropSand(mRemeshing.begin()->second->mPosition);
+  }
+  for (auto &[key, prefetched] : mPrefetched) {
+    prefetched.chunk->mCancelled = true;
+  }
+
+  // Stop the workers before anything they might still be reading is freed, a worker could be waiting for staging space
+  // which is never going to be released. Whatever the grid and the scheduler still hold ends up in the release queue,
+  // which deletes it last.
+  mStreaming->Shutdown();
+  mScheduler.reset();
+  mChunks.Clear();
+  mPrefetched.clear();
+  mRemeshing.clear();
+}
+
+World::ReleaseQueue::ReleaseQueue() : mMutex(SDL_CreateMutex()) {
+}
+
+World::ReleaseQueue::~ReleaseQueue() {
+  for (auto *chunk : mChunks) {
+    delete chunk;
   }
+  SDL_DestroyMutex(mMutex);
+}
 
-  mChunks.clear();
+void World::ReleaseQueue::Push(Chunk *chunk) {
+  SDL_LockMutex(mMutex);
+  mChunks.push_back(chunk);
+  SDL_UnlockMutex(mMutex);
 }
 
-void World::Update(const glm::vec3 &playerPosition) {
-  auto profiler = Profiler::Create();
+void World::ReleaseQueue::Drain() {
+  std::vector<Chunk *> chunks;
+  if (!SDL_TryLockMutex(mMutex)) {
+    return;
+  }
+  chunks.swap(mChunks);
+  SDL_UnlockMutex(mMutex);
+
+  for (auto *chunk : chunks) {
+    delete chunk;
+  }
+}
+
+void World::Update(const glm::vec3 &playerPosition, const glm::vec3 &viewDirection) {
+  glm::vec3 moved = mUpdates > 0 ? playerPosition - mLastPosition : glm::vec3(0.0f);
+  if (glm::length(moved) > TELEPORT_DISTANCE) {
+    mVelocity = glm::vec3(0.0f);
+  } else {
+    mVelocity = glm::mix(mVelocity, moved, VELOCITY_SMOOTHING);
+  }
+  mLastPosition = playerPosition;
+  mUpdates++;
+
   const glm::ivec3 currentChunk{
       static_cast<int>(std::floor(playerPosition.x / mChunkDimensions.x)),
       0,
       static_cast<int>(std::floor(playerPosition.z / mChunkDimensions.z)),
   };
 
-  glm::ivec3 dim = {5, 1, 5};
+  // Only reorder the queue when it could actually change the order, turning a few degrees is not enough
+  if (currentChunk != mCenterChunk || glm::dot(viewDirection, mViewDirection) < 0.95f) {
+    mCenterChunk = currentChunk;
+    mViewDirection = viewDirection;
+    mScheduler->Reprioritize(playerPosition, viewDirection);
+    EvictChunks(currentChunk);
+  }
 
-  std::vector<SDL_Thread *> threads;
-  for (int x = -dim.x; x < dim.x; ++x) {
-    for (int z = -dim.z; z < dim.z; ++z) {
-      auto *thread = EnsureChunkExists({currentChunk.x + x, 0, currentChunk.z + z});
-      if (thread != nullptr) {
-        threads.push_back(thread);
+  for (int x = -LOAD_RADIUS; x < LOAD_RADIUS; ++x) {
+    for (int z = -LOAD_RADIUS; z < LOAD_RADIUS; ++z) {
+      EnsureChunkExists({currentChunk.x + x, 0, currentChunk.z + z});
+    }
+  }
+
+  Prefetch(playerPosition, currentChunk);
+  UpdateSand();
+}
+
+u64 World::ChunkKey(const glm::ivec3 &chunkPosition) {
+  return static_cast<u64>(static_cast<uint32_t>(chunkPosition.x)) << 32 | static_cast<uint32_t>(chunkPosition.z);
+}
+
+void World::Prefetch(const glm::vec3 &playerPosition, const glm::ivec3 &centerChunk) {
+  // The predicted path hasn't gone through these in a while, the player turned away before reaching them
+  for (auto it = mPrefetched.begin(); it != mPrefetched.end();) {
+    if (mUpdates - it->second.wanted > PREFETCH_TIMEOUT) {
+      Retire(std::move(it->second.chunk));
+      it = mPrefetched.erase(it);
+      mPrefetchStats.discarded++;
+    } else {
+      ++it;
+    }
+  }
+
+  glm::vec3 velocity{mVelocity.x, 0.0f, mVelocity.z};
+  float speed = glm::length(velocity);
+  if (mPrefetch && speed >= PREFETCH_MIN_SPEED) {
+    // Walk the predicted path a chunk at a time and request the parts of the load square around each point that the
+    // current square doesn't cover, nearest first
+    glm::vec3 direction = velocity / speed;
+    float distance = speed * PREFETCH_LOOKAHEAD;
+    bool full = false;
+    for (float travelled = VoxelGrid::SIZE; travelled <= distance && !full; travelled += VoxelGrid::SIZE) {
+      glm::vec3 point = playerPosition + direction * travelled;
+      glm::ivec3 predicted{static_cast<int>(std::floor(point.x / mChunkDimensions.x)), 0,
+                           static_cast<int>(std::floor(point.z / mChunkDimensions.z))};
+
+      for (int x = -LOAD_RADIUS; x < LOAD_RADIUS && !full; ++x) {
+        for (int z = -LOAD_RADIUS; z < LOAD_RADIUS && !full; ++z) {
+          glm::ivec3 position{predicted.x + x, 0, predicted.z + z};
+          glm::ivec3 offset = position - centerChunk;
+          if ((offset.x >= -LOAD_RADIUS && offset.x < LOAD_RADIUS && offset.z >= -LOAD_RADIUS &&
+               offset.z < LOAD_RADIUS) ||
+              mChunks.Get(position)) {
+            continue;
+          }
+
+          auto it = mPrefetched.find(ChunkKey(position));
+          if (it != mPrefetched.end()) {
+            it->second.wanted = mUpdates;
+            continue;
+          }
+
+          if (mPrefetched.size() >= PREFETCH_BUDGET) {
+            full = true;
+            break;
+          }
+
+          mPrefetched.emplace(ChunkKey(position), Prefetched{CreateChunk(position), mUpdates});
+          mPrefetchStats.issued++;
+        }
       }
     }
   }
 
-  if (threads.size() == 0) {
+  auto &reported = mReportedPrefetchStats;
+  if (mUpdates % PREFETCH_REPORT_INTERVAL == 0 && (mPrefetchStats.used != reported.used ||
+                                                    mPrefetchStats.discarded != reported.discarded)) {
+    int resolved = mPrefetchStats.used + mPrefetchStats.discarded;
+    SDL_Log("Chunk prefetch: %d issued, %d used, %d discarded, hit rate %.1f%%", mPrefetchStats.issued,
+            mPrefetchStats.used, mPrefetchStats.discarded, 100.0f * mPrefetchStats.used / resolved);
+    reported = mPrefetchStats;
+  }
+}
+
+void World::SetPrefetch(bool enabled) {
+  mPrefetch = enabled;
+}
+
+void World::SetGpuMeshing(bool enabled) {
+  mGpuMeshing = enabled;
+}
+
+World::PrefetchStats World::GetPrefetchStats() const {
+  return mPrefetchStats;
+}
+
+World::ViewCoverage World::GetViewCoverage(const glm::vec3 &playerPosition, const glm::vec3 &viewDirection) const {
+  ViewCoverage coverage;
+  for (int x = -LOAD_RADIUS; x < LOAD_RADIUS; ++x) {
+    for (int z = -LOAD_RADIUS; z < LOAD_RADIUS; ++z) {
+      glm::ivec3 position{mCenterChunk.x + x, 0, mCenterChunk.z + z};
+      if (!InViewCone(position, playerPosition, viewDirection)) {
+        continue;
+      }
+
+      const Chunk *chunk = mChunks.Get(position);
+      coverage.inView++;
+      coverage.missing += !chunk || !chunk->mReady;
+    }
+  }
+
+  return coverage;
+}
+
+std::vector<std::shared_ptr<Chunk>> World::Chunks() const {
+  return mChunks.All();
+}
+
+u64 World::Column(int x, int z) const {
+  const int size = VoxelGrid::SIZE;
+  // Rounded down, the columns left of the origin belong to chunk -1
+  glm::ivec3 chunkPosition((x >= 0 ? x : x - size + 1) / size, 0, (z >= 0 ? z : z - size + 1) / size);
+  const Chunk *chunk = mChunks.Get(chunkPosition);
+  if (!chunk || !chunk->mGenerated) {
+    return mTerrain.Column(x, 0, z);
+  }
+
+  switch (chunk->mContent) {
+    case ChunkContent::Air:
+      return 0;
+    case ChunkContent::Solid:
+      return ~static_cast<u64>(0);
+    default:
+      return chunk->mGrid->columns[(x - chunkPosition.x * size) * size + z - chunkPosition.z * size];
+  }
+}
+
+bool World::AddSand(const glm::ivec3 &voxel) {
+  return mSand->AddSand(voxel);
+}
+
+void World::UpdateSand() {
+  // A remeshed chunk takes over once the render side has its mesh, until then the old one is drawn
+  for (auto it = mRemeshing.begin(); it != mRemeshing.end();) {
+    if (!it->second->mReady) {
+      ++it;
+      continue;
+    }
+    // Its sand is in the new chunk, which is saved instead
+    it->second->mDirty = true;
+    auto previous = mChunks.Insert(it->second);
+    if (previous) {
+      previous->mDirty = false;
+      Retire(std::move(previous));
+    }
+    it = mRemeshing.erase(it);
+  }
+
+  mChunks.ForEach([&](Chunk &chunk) {
+    glm::ivec2 position(chunk.mPosition.x, chunk.mPosition.z);
+    if (!chunk.mGenerated || mSand->Sand(position)) {
+      return;
+    }
+
+    static const VoxelGrid air{};
+    static const VoxelGrid solid = [] {
+      VoxelGrid grid;
+      std::fill(std::begin(grid.columns), std::end(grid.columns), ~static_cast<u64>(0));
+      return grid;
+    }();
+    switch (chunk.mContent) {
+      case ChunkContent::Air:
+        mSand->AddChunk(position, air);
+        break;
+      case ChunkContent::Solid:
+        mSand->AddChunk(position, solid);
+        break;
+      default:
+        mSand->AddChunk(position, *chunk.mGrid);
+        break;
+    }
+  });
+
+  mSand->Tick();
+  for (const auto &position : mSand->TakeChanged()) {
+    glm::ivec3 chunkPosition(position.x, 0, position.y);
+    mSandChanged.emplace(ChunkKey(chunkPosition), chunkPosition);
+  }
+
+  // One remesh per chunk at a time, sand that moved in the meantime goes into the next one
+  for (auto it = mSandChanged.begin(); it != mSandChanged.end();) {
+    if (mRemeshing.contains(it->first)) {
+      ++it;
+      continue;
+    }
+    glm::ivec2 position(it->second.x, it->second.z);
+    auto sand = std::make_shared<const VoxelGrid>(*mSand->Sand(position));
+    mRemeshing.emplace(it->first, CreateChunk(it->second, std::move(sand)));
+    it = mSandChanged.erase(it);
+  }
+}
+
+void World::DropSand(const glm::ivec3 &chunkPosition) {
+  u64 key = ChunkKey(chunkPosition);
+  mSand->RemoveChunk({chunkPosition.x, chunkPosition.z});
+  mSandChanged.erase(key);
+  auto it = mRemeshing.find(key);
+  if (it == mRemeshing.end()) {
+    return;
+  }
+
+  // It has the newest sand, worth saving once it has a grid
+  it->second->mDirty = it->second->mGenerated.load();
+  Retire(std::move(it->second));
+  mRemeshing.erase(it);
+}
+
+void World::Upload(const glm::vec3 &playerPosition, const glm::vec3 &viewDirection,
+                   const std::vector<std::shared_ptr<Chunk>> &chunks) {
+  CollectChunks(playerPosition, viewDirection, chunks);
+  mStreaming->EndFrame();
+  mReleased.Drain();
+}
+
+std::shared_ptr<Chunk> World::CreateChunk(const glm::ivec3 &chunkPosition, std::shared_ptr<const VoxelGrid> sand) {
+  auto chunk = std::shared_ptr<Chunk>(new Chunk(*mTextureAtlas, mCache, mPool.get(), *mStore, chunkPosition, mSeed),
+                                      [this](Chunk *chunk) { mReleased.Push(chunk); });
+  chunk->mRequestedAt = SDL_GetPerformanceCounter();
+  chunk->mGpuMeshing = mGpuMeshing;
+  chunk->mSand = std::move(sand);
+  mScheduler->Enqueue(chunk);
+  return chunk;
+}
+
+void World::EnsureChunkExists(const glm::ivec3 &chunkPosition) {
+  if (mChunks.Get(chunkPosition)) {
+    return;
+  }
+
+  std::shared_ptr<Chunk> chunk;
+  auto prefetched = mPrefetched.find(ChunkKey(chunkPosition));
+  if (prefetched != mPrefetched.end()) {
+    chunk = std::move(prefetched->second.chunk);
+    mPrefetched.erase(prefetched);
+    mPrefetchStats.used++;
+  } else {
+    chunk = CreateChunk(chunkPosition);
+  }
+
+  auto previous = mChunks.Insert(std::move(chunk));
+  if (previous) {
+    DropSand(previous->mPosition);
+    Retire(std::move(previous));
+  }
+}
+
+void World::EvictChunks(const glm::ivec3 &centerChunk) {
+  // Keep one extra ring around the load square so walking back and forth over a border doesn't regenerate chunks
+  std::vector<glm::ivec3> evicted;
+  mChunks.ForEach([&](Chunk &chunk) {
+    glm::ivec3 offset = chunk.mPosition - centerChunk;
+    if (offset.x < -LOAD_RADIUS - 1 || offset.x > LOAD_RADIUS || offset.z < -LOAD_RADIUS - 1 ||
+        offset.z > LOAD_RADIUS) {
+      evicted.push_back(chunk.mPosition);
+    }
+  });
+
+  for (auto &position : evicted) {
+    Retire(mChunks.Remove(position));
+    DropSand(position);
+  }
+}
+
+void World::Retire(std::shared_ptr<Chunk> chunk) {
+  // Stops the workers if they still have it, and tells the render side not to upload it. Snapshots the render side
+  // still holds keep it alive until they are replaced.
+  chunk->mCancelled = true;
+  if (chunk->mDirty.exchange(false)) {
+    mStore->Save(chunk->mPosition, chunk->mContent, chunk->mGrid);
+  }
+}
+
+void World::CollectChunks(const glm::vec3 &playerPosition, const glm::vec3 &viewDirection,
+                          const std::vector<std::shared_ptr<Chunk>> &chunks) {
+  auto finished = mScheduler->CollectFinished();
+  if (finished.empty()) {
     return;
   }
 
-  // TODO: Need to refactor this so we don't have to wait on the main thread for the threads to finish
-  for (auto *thread : threads) {
-    int status;
-    SDL_WaitThread(thread, &status);
+  auto now = SDL_GetPerformanceCounter();
+  for (auto &chunk : finished) {
+    if (chunk->mCancelled) {
+      if (chunk->mStaging) {
+        mStreaming->Discard(*chunk->mStaging);
+        chunk->mStaging.reset();
+      }
+      continue;
+    }
+
+    chunk->SetupVAO(*mStreaming, mMesher.get());
+    if (!InViewCone(chunk->mPosition, playerPosition, viewDirection)) {
+      continue;
+    }
+
+    float ms = static_cast<float>(now - chunk->mRequestedAt) / SDL_GetPerformanceFrequency() * 1000.0f;
+    mStats.visibleChunks++;
+    mStats.totalMs += ms;
+    mStats.maxMs = std::max(mStats.maxMs, ms);
   }
 
-  for (auto &entry : mChunks) {
-    entry.second->SetupVAO();
+  if (mScheduler->Idle() && mStats.visibleChunks > 0) {
+    SDL_Log("Chunk streaming: %d chunks in view, time to first visible avg %.2f ms, max %.2f ms", mStats.visibleChunks,
+            mStats.totalMs / mStats.visibleChunks, mStats.maxMs);
+    auto generation = mScheduler->TakeStats();
+    SDL_Log("Chunk generation: %d chunks on the workers, avg %.2f ms, max %.2f ms", generation.chunks,
+            generation.totalMs / std::max(generation.chunks, 1), generation.maxMs);
+    if (mMesher) {
+      auto meshing = mMesher->TakeStats();
+      SDL_Log("GPU meshing: %d chunks, %.2f MB of vertices written from %.2f MB of input", meshing.chunks,
+              meshing.vertices * sizeof(Vertex) / (1024.0f * 1024.0f), meshing.inputBytes / (1024.0f * 1024.0f));
+    }
+    mStats = {};
+    LogMemory(chunks);
+  }
+}
+
+void World::LogMemory(const std::vector<std::shared_ptr<Chunk>> &chunkList) {
+  struct Usage {
+    size_t unshared = 0;
+    size_t shared = 0;
+  };
+
+  Usage grids, lights, meshes;
+  int chunks = 0, uniform = 0;
+  std::unordered_set<const void *> seen;
+  auto count = [&](Usage &usage, const void *data, size_t bytes) {
+    usage.unshared += bytes;
+    if (seen.insert(data).second) {
+      usage.shared += bytes;
+    }
+  };
+
+  for (const auto &loaded : chunkList) {
+    const Chunk &chunk = *loaded;
+    chunks++;
+    // Without the uniform tag every chunk would have a full grid
+    grids.unshared += sizeof(VoxelGrid);
+    if (chunk.mGrid && seen.insert(chunk.mGrid.get()).second) {
+      grids.shared += sizeof(VoxelGrid);
+    }
+    if (chunk.mContent != ChunkContent::Mixed) {
+      uniform++;
+    }
+    if (chunk.mLight) {
+      count(lights, chunk.mLight.get(), chunk.mLight->Bytes());
+    }
+    // Meshes built by the GPU mesher have no CPU side copy
+    if (chunk.mVertices) {
+      count(meshes, chunk.mVertices.get(), chunk.mVertices->size() * sizeof(Vertex));
+    }
   }
 
-  profiler.LogEnd("World building completed");
+  auto mb = [](size_t bytes) { return bytes / (1024.0f * 1024.0f); };
+  SDL_Log("Chunk memory: %d chunks (%d uniform), grids %.2f MB (%.2f MB unshared), light %.2f MB (%.2f MB unshared), "
+          "meshes %.2f MB (%.2f MB unshared)",
+          chunks, uniform, mb(grids.shared), mb(grids.unshared), mb(lights.shared), mb(lights.unshared),
+          mb(meshes.shared), mb(meshes.unshared));
+  MemoryTracker::LogSummary();
 }
 
-SDL_Thread *World::EnsureChunkExists(const glm::ivec3 &chunkPosition) {
-  if (mChunks.contains(chunkPosition)) {
-    return nullptr;
+void World::DrawShadowCasters(const Shader &shader, const std::vector<Chunk *> &chunks) const {
+  bool poolBound = false;
+  for (auto *chunk : chunks) {
+    glm::vec3 translationVector = chunk->mPosition * mChunkDimensions;
+    shader.UniformMat4("model", glm::translate(glm::identity<glm::mat4>(), translationVector));
+    if (!chunk->mPoolRange) {
+      chunk->Render();
+      poolBound = false;
+      continue;
+    }
+
+    if (!poolBound) {
+      glBindVertexArray(mPool->VertexArray());
+      poolBound = true;
+    }
+    glDrawArrays(GL_TRIANGLES, chunk->mPoolRange->offset, chunk->mPoolRange->size);
+    GpuProfiler::CountDraw(chunk->mPoolRange->size / 3);
   }
+  glBindVertexArray(0);
+}
 
-  auto *chunk = new Chunk(*mTextureAtlas, chunkPosition, mChunkDimensions, mSeed);
+bool World::IsLoaded() const {
+  return mScheduler->Idle();
+}
 
-  mChunks.insert(std::make_pair(chunkPosition, chunk));
+void World::SetCuller(std::unique_ptr<OcclusionCuller> culler) {
+  mCuller = std::move(culler);
+}
 
-  return SDL_CreateThread(GenerateChunkVertices, "GenerateChunkVertices", (void *)chunk);
+void World::SetGpuMesher(std::unique_ptr<Shader> shader) {
+  mMesher = std::make_unique<GpuMesher>(std::move(shader), *mTextureAtlas);
 }
 
-void World::Render(const Shader &shader) {
+void World::Render(const Shader &shader, const glm::mat4 &viewProjection, const glm::vec3 &eye,
+                   const std::vector<std::shared_ptr<Chunk>> &chunks) {
   mTextureAtlas->Bind(0);
+  shader.UniformInt("indirect", 0);
 
-  for (auto &pair : mChunks) {
-    glm::vec3 translationVector = pair.second->mPosition * mChunkDimensions;
-    const glm::mat4 model = glm::translate(glm::identity<glm::mat4>(), translationVector);
+  std::vector<ChunkRecord> pooled;
+  std::vector<Chunk *> pooledChunks;
+  for (const auto &loaded : chunks) {
+    Chunk &chunk = *loaded;
+    glm::vec3 translationVector = chunk.mPosition * mChunkDimensions;
+    if (chunk.mPoolRange) {
+      ChunkRecord record{
+          .origin = glm::vec4(translationVector, 0.0f),
+          .boundsMin = glm::vec4(translationVector + chunk.mBoundsMin, 0.0f),
+          .boundsMax = glm::vec4(translationVector + chunk.mBoundsMax, 0.0f),
+          .first = static_cast<uint32_t>(chunk.mPoolRange->offset),
+          .count = static_cast<uint32_t>(chunk.mPoolRange->size),
+          .faces = {},
+      };
+      std::copy(std::begin(chunk.mFaceCounts), std::end(chunk.mFaceCounts), record.faces);
+      pooled.push_back(record);
+      pooledChunks.push_back(&chunk);
+      continue;
+    }
 
+    const glm::mat4 model = glm::translate(glm::identity<glm::mat4>(), translationVector);
     shader.UniformMat4("model", model);
-    pair.second->Render();
+    chunk.Render(chunk.VisibleFaces(eye));
+  }
+
+  if (mCuller) {
+    // The culler only knows on the GPU which chunks it draws, the count covers every chunk handed to it
+    for (const auto *chunk : pooledChunks) {
+      GpuProfiler::CountSkippedVertices(chunk->mPoolRange->size - chunk->FaceVertices(chunk->VisibleFaces(eye)));
+    }
+    mCuller->Draw(shader, *mPool, pooled, viewProjection, eye);
+    mCuller->BuildPyramid(viewProjection);
+    shader.Bind();
+    return;
+  }
+
+  glBindVertexArray(mPool->VertexArray());
+  for (const auto *chunk : pooledChunks) {
+    unsigned faces = chunk->VisibleFaces(eye);
+    GLint first[CUBE_FACES];
+    GLsizei count[CUBE_FACES];
+    int ranges = chunk->FaceRanges(faces, chunk->mPoolRange->offset, first, count);
+    uint32_t drawn = chunk->FaceVertices(faces);
+    GpuProfiler::CountSkippedVertices(chunk->mPoolRange->size - drawn);
+    if (ranges == 0) {
+      continue;
+    }
+
+    glm::vec3 translationVector = chunk->mPosition * mChunkDimensions;
+    shader.UniformMat4("model", glm::translate(glm::identity<glm::mat4>(), translationVector));
+    glMultiDrawArrays(GL_TRIANGLES, first, count, ranges);
+    GpuProfiler::CountDraw(drawn / 3);
   }
+  glBindVertexArray(0);
 }
@@ -1,27 +1,179 @@
 #pragma once
 
-#define GLM_ENABLE_EXPERIMENTAL
-#include "glm/gtx/hash.hpp"
-
 #include "chunk.h"
+#include "chunk_cache.h"
+#include "chunk_grid.h"
+#include "chunk_scheduler.h"
+#include "chunk_store.h"
+#include "core/streaming_buffer.h"
 #include "core/shader.h"
+#include "gpu_mesher.h"
+#include "mesh_pool.h"
+#include "occlusion_culler.h"
+#include "sand_simulation.h"
+#include "terrain.h"
 #include "texture_atlas.h"
+#include <SDL3/SDL.h>
 #include <glm/glm.hpp>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 class World {
 public:
-  World(const int seed, const glm::ivec3 &chunkDimensions);
+  struct PrefetchStats {
+    int issued = 0;
+    // Prefetched chunks the player got close enough to for them to join the load square
+    int used = 0;
+    // Prefetched chunks which were dropped because the player went somewhere else
+    int discarded = 0;
+  };
+
+  // Chunks of the load square inside the view cone, and how many of them have nothing to draw yet
+  struct ViewCoverage {
+    int inView = 0;
+    int missing = 0;
+  };
+
+  // Chunks are loaded in [-LOAD_RADIUS, LOAD_RADIUS) around the player and kept until they are one further away
+  static const int LOAD_RADIUS = 5;
+
+  // The block textures, decode them with TextureAtlasBuilder::Decode() and pass the uploaded atlas to the constructor
+  static TextureAtlasBuilder CreateAtlasBuilder();
+  // Where the chunk store of a world lives, shared with the pregeneration tool
+  static std::string SavePath(int seed);
+  // Whether the chunk counts as visible for the streaming stats. Only the horizontal direction to its center matters,
+  // the chunk the eye is in is always visible.
+  static bool InViewCone(const glm::ivec3 &chunkPosition, const glm::vec3 &eye, const glm::vec3 &viewDirection);
+
+  World(const int seed, std::unique_ptr<TextureAtlas> atlas);
   ~World();
 
-  void Update(const glm::vec3 &playerPosition);
-  void Render(const Shader &shader);
+  // The world is split between two threads. The simulation side decides which chunks are loaded and hands the
+  // chunk list to the render side, which uploads finished meshes and draws. Both can run on the same thread.
+
+  // Simulation side: requests and evicts chunks around the player, never touches GL
+  void Update(const glm::vec3 &playerPosition, const glm::vec3 &viewDirection);
+  std::vector<std::shared_ptr<Chunk>> Chunks() const;
+  // Requests chunks ahead of the player along its recent velocity, on by default
+  void SetPrefetch(bool enabled);
+  // Mixed chunks requested from now on are meshed by the GPU mesher when they are uploaded, off by default
+  void SetGpuMeshing(bool enabled);
+  PrefetchStats GetPrefetchStats() const;
+  // Reads the upload state of the chunks, so only call it when the simulation and the render side share a thread
+  ViewCoverage GetViewCoverage(const glm::vec3 &playerPosition, const glm::vec3 &viewDirection) const;
+  // Solid voxels of the world column at (x, z), for collision. Read from the loaded chunk, so edits and saved chunks
+  // count. Columns of chunks that aren't generated yet come from the terrain generator. Simulation side only.
+  u64 Column(int x, int z) const;
+  // Drops a sand voxel at the world voxel if it is free and its chunk is loaded. Sand falls and slides with every
+  // update, the chunks it changes are remeshed and swapped in once their new mesh is uploaded. Simulation side only.
+  bool AddSand(const glm::ivec3 &voxel);
+
+  // Render side: uploads the chunks the workers finished and deletes the ones nobody references anymore
+  void Upload(const glm::vec3 &playerPosition, const glm::vec3 &viewDirection,
+              const std::vector<std::shared_ptr<Chunk>> &chunks);
+  // Without a culler the pooled chunk meshes are drawn one by one from the CPU
+  void SetCuller(std::unique_ptr<OcclusionCuller> culler);
+  // Builds the mesher from mesh.comp. Without one, chunks prepared for it are meshed on the CPU when they are uploaded.
+  void SetGpuMesher(std::unique_ptr<Shader> shader);
+  // Face directions of a chunk which point away from the eye are skipped
+  void Render(const Shader &shader, const glm::mat4 &viewProjection, const glm::vec3 &eye,
+              const std::vector<std::shared_ptr<Chunk>> &chunks);
+  // Draws the chunks one by one with the shader's model matrix, no culling. For passes which aren't seen from the
+  // camera, like the shadow maps.
+  void DrawShadowCasters(const Shader &shader, const std::vector<Chunk *> &chunks) const;
+
+  // True once every requested chunk has been generated and uploaded
+  bool IsLoaded() const;
 
 private:
+  // Time from requesting a chunk until its mesh is uploaded, only counted for chunks inside the view cone
+  struct StreamingStats {
+    int visibleChunks = 0;
+    float totalMs = 0.0f;
+    float maxMs = 0.0f;
+  };
+
+  // Chunks own GL objects but their last reference can go away on any thread, so it only queues them here and the
+  // render side deletes them
+  class ReleaseQueue {
+  public:
+    ReleaseQueue();
+    ~ReleaseQueue();
+
+    void Push(Chunk *chunk);
+    // Never blocks, if the queue is busy the chunks are deleted next time
+    void Drain();
+
+  private:
+    SDL_Mutex *mMutex;
+    std::vector<Chunk *> mChunks;
+  };
+
+  struct Prefetched {
+    std::shared_ptr<Chunk> chunk;
+    // Update in which the predicted path last went through the chunk
+    unsigned long wanted;
+  };
+
+  // At most this many prefetched chunks are waiting for the player at a time, about two edges of the load square
+  static const int PREFETCH_BUDGET = 4 * LOAD_RADIUS;
+  // How far ahead the path is predicted, in updates
+  static const int PREFETCH_LOOKAHEAD = 60;
+  // Prefetched chunks the path hasn't gone through for this many updates are dropped
+  static const int PREFETCH_TIMEOUT = 120;
+
   int mSeed;
+  Terrain mTerrain;
   glm::ivec3 mChunkDimensions;
-  std::unordered_map<glm::ivec3, Chunk *> mChunks;
+  ChunkCache mCache;
+  // Declared before the chunks, they give their mesh ranges back when they are destroyed
+  std::unique_ptr<MeshPool> mPool;
+  ReleaseQueue mReleased;
+  // Outlives the chunks, the dirty ones are saved when the world goes away
+  std::unique_ptr<ChunkStore> mStore;
+  ChunkGrid mChunks;
+  // Keyed by ChunkKey(), they don't fit into the grid's window
+  std::unordered_map<u64, Prefetched> mPrefetched;
   std::unique_ptr<TextureAtlas> mTextureAtlas;
+  std::unique_ptr<StreamingBuffer> mStreaming;
+  std::unique_ptr<ChunkScheduler> mScheduler;
+  std::unique_ptr<OcclusionCuller> mCuller;
+  std::unique_ptr<GpuMesher> mMesher;
+  // Holds the loaded chunks once they are generated
+  std::unique_ptr<SandSimulation> mSand;
+  // Keyed by ChunkKey(). Chunks being remeshed with new sand, the loaded chunk stays until they are uploaded.
+  std::unordered_map<u64, std::shared_ptr<Chunk>> mRemeshing;
+  // Chunks whose sand changed since their remesh was requested
+  std::unordered_map<u64, glm::ivec3> mSandChanged;
+
+  glm::ivec3 mCenterChunk;
+  glm::vec3 mViewDirection;
+  StreamingStats mStats;
+
+  bool mPrefetch;
+  bool mGpuMeshing;
+  unsigned long mUpdates;
+  glm::vec3 mLastPosition;
+  // Smoothed movement per update
+  glm::vec3 mVelocity;
+  PrefetchStats mPrefetchStats;
+  PrefetchStats mReportedPrefetchStats;
 
-  SDL_Thread *EnsureChunkExists(const glm::ivec3 &chunkPosition);
+  static u64 ChunkKey(const glm::ivec3 &chunkPosition);
+  std::shared_ptr<Chunk> CreateChunk(const glm::ivec3 &chunkPosition, std::shared_ptr<const VoxelGrid> sand = nullptr);
+  void EnsureChunkExists(const glm::ivec3 &chunkPosition);
+  void Prefetch(const glm::vec3 &playerPosition, const glm::ivec3 &centerChunk);
+  void EvictChunks(const glm::ivec3 &centerChunk);
+  // Saves the chunk if it was edited and cancels whatever work is still queued for it
+  void Retire(std::shared_ptr<Chunk> chunk);
+  // Ticks the sand, adds newly generated chunks to it and remeshes the chunks it changed
+  void UpdateSand();
+  // Takes an unloaded chunk out of the sand simulation, a remesh still underway is saved if it got that far
+  void DropSand(const glm::ivec3 &chunkPosition);
+  void CollectChunks(const glm::vec3 &playerPosition, const glm::vec3 &viewDirection,
+                     const std::vector<std::shared_ptr<Chunk>> &chunks);
+  // Chunk voxel, light and mesh memory, next to what it would be if nothing was shared
+  void LogMemory(const std::vector<std::shared_ptr<Chunk>> &chunks);
 };
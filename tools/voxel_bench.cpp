@@ -0,0 +1,171 @@
+// Runs the engine's benchmarks outside the game. Every benchmark generates its own input from the seed, checks its
+// results against a reference where it has one, logs a summary and writes its measurements to <out>/<name>.csv.
+//
+// voxel_bench <name>... [--seed <n>] [--out <directory>]
+//
+// Names: mesh, physics, terrain, store, sand, ao, relight, ring, scheduler, grid, gpu-mesh, or all for every one of
+// them. gpu-mesh needs a GL context, which it creates on SDL's offscreen driver without a display. Exits with failure
+// if any benchmark failed its checks.
+
+#include "core/ring_benchmark.h"
+#include "core/shader.h"
+#include "world/gpu_mesh_benchmark.h"
+#include "world/grid_benchmark.h"
+#include "world/light_benchmark.h"
+#include "world/mesh_benchmark.h"
+#include "world/occlusion_benchmark.h"
+#include "world/physics_benchmark.h"
+#include "world/sand_benchmark.h"
+#include "world/scheduler_benchmark.h"
+#include "world/store_benchmark.h"
+#include "world/terrain_benchmark.h"
+#include "world/texture_atlas.h"
+#include "world/world.h"
+#include <GL/glew.h>
+#include <SDL3/SDL.h>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+  std::vector<std::string> names;
+  int seed = 0;
+  std::string output = ".";
+};
+
+struct Benchmark {
+  const char *name;
+  bool (*run)(int seed, const std::string &path);
+};
+
+bool RunGpuMesh(int seed, const std::string &path);
+
+const Benchmark BENCHMARKS[] = {
+    {"mesh", RunMeshBenchmark},
+    {"physics", RunPhysicsBenchmark},
+    {"terrain", RunTerrainBenchmark},
+    {"store", RunStoreBenchmark},
+    {"sand", RunSandBenchmark},
+    {"ao", RunOcclusionBenchmark},
+    {"relight", RunLightBenchmark},
+    {"ring", RunRingBenchmark},
+    {"scheduler", RunSchedulerBenchmark},
+    {"grid", RunGridBenchmark},
+    {"gpu-mesh", RunGpuMesh},
+};
+
+const Benchmark *Find(const std::string &name) {
+  for (const auto &benchmark : BENCHMARKS) {
+    if (name == benchmark.name) {
+      return &benchmark;
+    }
+  }
+  return nullptr;
+}
+
+bool ParseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--seed" && i + 1 < argc) {
+      options.seed = std::atoi(argv[++i]);
+    } else if (arg == "--out" && i + 1 < argc) {
+      options.output = argv[++i];
+    } else if (arg == "all") {
+      for (const auto &benchmark : BENCHMARKS) {
+        options.names.push_back(benchmark.name);
+      }
+    } else if (Find(arg)) {
+      options.names.push_back(arg);
+    } else {
+      std::fprintf(stderr, "Unknown argument: %s\n", arg.c_str());
+      return false;
+    }
+  }
+
+  if (options.names.empty()) {
+    std::fprintf(stderr, "Usage: voxel_bench <name>... [--seed <n>] [--out <directory>]\nNames: all");
+    for (const auto &benchmark : BENCHMARKS) {
+      std::fprintf(stderr, ", %s", benchmark.name);
+    }
+    std::fprintf(stderr, "\n");
+    return false;
+  }
+
+  return true;
+}
+
+// Compares the GPU mesher against the CPU one, on a hidden window's context
+bool RunGpuMesh(int seed, const std::string &path) {
+  SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+  if (!SDL_Init(SDL_INIT_VIDEO)) {
+    SDL_Log("Failed to initialize SDL: %s", SDL_GetError());
+    return false;
+  }
+
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 6);
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+  SDL_Window *window = SDL_CreateWindow("voxel_bench", 64, 64, SDL_WINDOW_HIDDEN | SDL_WINDOW_OPENGL);
+  if (!window) {
+    SDL_Log("Failed to create SDL window: %s", SDL_GetError());
+    SDL_Quit();
+    return false;
+  }
+
+  // Same fallback as the game, llvmpipe only has 4.5
+  auto glContext = SDL_GL_CreateContext(window);
+  if (!glContext) {
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
+    glContext = SDL_GL_CreateContext(window);
+  }
+
+  bool passed = false;
+  if (glContext) {
+    SDL_GL_MakeCurrent(window, glContext);
+    glewInit();
+
+    // The benchmark only needs the atlas's texture coordinates
+    TextureAtlas atlas(0, World::CreateAtlasBuilder().Entries());
+    ShaderCompiler compiler(false);
+    auto meshShader = compiler.AddCompute("assets/shaders/mesh.comp");
+    auto shaders = compiler.Build();
+    passed = shaders[meshShader] && RunGpuMeshBenchmark(seed, path, std::move(shaders[meshShader]), atlas);
+    SDL_GL_DestroyContext(glContext);
+  } else {
+    SDL_Log("Failed to create OpenGL context: %s", SDL_GetError());
+  }
+
+  SDL_DestroyWindow(window);
+  SDL_Quit();
+  return passed;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    return EXIT_FAILURE;
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(options.output, error);
+
+  std::vector<std::string> failed;
+  for (const auto &name : options.names) {
+    std::string path = (std::filesystem::path(options.output) / (name + ".csv")).string();
+    if (!Find(name)->run(options.seed, path)) {
+      failed.push_back(name);
+    }
+  }
+
+  for (const auto &name : failed) {
+    std::fprintf(stderr, "%s failed\n", name.c_str());
+  }
+  return failed.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,182 @@
+// Generates, lights and meshes a region of chunks ahead of time and writes their voxels and baked meshes to the world's
+// chunk store. The game then expands the meshes as they are, without running the terrain generator, the light or the
+// occlusion lookups. Runs the same Chunk::GenerateVertices() as the game on every core, without a window or a GL
+// context.
+//
+// voxel_pregen --seed <n> --region <x0> <z0> <x1> <z1> [--out <directory>] [--threads <n>] [--verbose]
+//
+// The region is in chunk coordinates, [x0, x1) x [z0, z1). The output defaults to the store the game opens for the
+// seed. Chunks already in the store, e.g. ones the player changed, are kept.
+
+#include "world/chunk.h"
+#include "world/chunk_cache.h"
+#include "world/chunk_store.h"
+#include "world/texture_atlas.h"
+#include "world/world.h"
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+  int seed = 0;
+  glm::ivec2 min = glm::ivec2(0);
+  glm::ivec2 max = glm::ivec2(0);
+  std::string output;
+  int threads = 0;
+  bool verbose = false;
+};
+
+struct Pregen {
+  const Options &options;
+  const TextureAtlas &atlas;
+  ChunkCache &cache;
+  ChunkStore &store;
+  std::vector<glm::ivec3> positions;
+  std::atomic<size_t> next = 0;
+  std::atomic<size_t> done = 0;
+  // Already in the store, not generated again
+  std::atomic<size_t> kept = 0;
+  std::atomic<size_t> faces = 0;
+};
+
+bool ParseOptions(int argc, char **argv, Options &options) {
+  bool region = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--seed" && i + 1 < argc) {
+      options.seed = std::atoi(argv[++i]);
+    } else if (arg == "--region" && i + 4 < argc) {
+      options.min = {std::atoi(argv[i + 1]), std::atoi(argv[i + 2])};
+      options.max = {std::atoi(argv[i + 3]), std::atoi(argv[i + 4])};
+      region = true;
+      i += 4;
+    } else if (arg == "--out" && i + 1 < argc) {
+      options.output = argv[++i];
+    } else if (arg == "--threads" && i + 1 < argc) {
+      options.threads = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--verbose") {
+      options.verbose = true;
+    } else {
+      std::fprintf(stderr, "Unknown argument: %s\n", arg.c_str());
+      return false;
+    }
+  }
+
+  if (!region || options.max.x <= options.min.x || options.max.y <= options.min.y) {
+    std::fprintf(stderr, "Usage: voxel_pregen --seed <n> --region <x0> <z0> <x1> <z1> [--out <directory>] "
+                         "[--threads <n>] [--verbose]\n");
+    return false;
+  }
+
+  if (options.output.empty()) {
+    options.output = World::SavePath(options.seed);
+  }
+  if (options.threads == 0) {
+    options.threads = std::max(1, SDL_GetNumLogicalCPUCores());
+  }
+  return true;
+}
+
+int Worker(void *data) {
+  auto &pregen = *static_cast<Pregen *>(data);
+  for (size_t i = pregen.next++; i < pregen.positions.size(); i = pregen.next++) {
+    const glm::ivec3 &position = pregen.positions[i];
+    if (pregen.store.Load(position)) {
+      pregen.kept++;
+      pregen.done++;
+      continue;
+    }
+
+    Chunk chunk(pregen.atlas, pregen.cache, nullptr, pregen.store, position, pregen.options.seed);
+    chunk.GenerateVertices();
+    auto mesh = chunk.BakeMesh();
+    pregen.faces += mesh->faces.size();
+    pregen.store.Save(position, {.content = chunk.mContent, .grid = chunk.mGrid, .mesh = std::move(mesh)});
+    pregen.done++;
+  }
+
+  return 0;
+}
+
+float Seconds(Uint64 start) {
+  return static_cast<float>(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    return EXIT_FAILURE;
+  }
+
+  // The store logs at info priority, errors included
+  if (!options.verbose) {
+    SDL_SetLogPriorities(SDL_LOG_PRIORITY_WARN);
+  }
+
+  // The atlas only provides texture coordinates here, the same ones the game's atlas has
+  TextureAtlas atlas(0, World::CreateAtlasBuilder().Entries());
+  ChunkCache cache;
+  ChunkStore store(options.output);
+  Pregen pregen{.options = options, .atlas = atlas, .cache = cache, .store = store};
+
+  // Closest to the middle of the region first, so a run that is stopped early still covers the spawn
+  glm::vec2 center = glm::vec2(options.min + options.max) * 0.5f;
+  for (int x = options.min.x; x < options.max.x; ++x) {
+    for (int z = options.min.y; z < options.max.y; ++z) {
+      pregen.positions.push_back({x, 0, z});
+    }
+  }
+  std::stable_sort(pregen.positions.begin(), pregen.positions.end(), [&](const glm::ivec3 &a, const glm::ivec3 &b) {
+    auto distance = [&](const glm::ivec3 &p) {
+      glm::vec2 offset = glm::vec2(p.x + 0.5f, p.z + 0.5f) - center;
+      return glm::dot(offset, offset);
+    };
+    return distance(a) < distance(b);
+  });
+
+  std::printf("Pregenerating %zu chunks of seed %d into %s on %d threads\n", pregen.positions.size(), options.seed,
+              options.output.c_str(), options.threads);
+  auto start = SDL_GetPerformanceCounter();
+  std::vector<SDL_Thread *> threads;
+  for (int i = 0; i < options.threads; ++i) {
+    threads.push_back(SDL_CreateThread(Worker, "Pregen", &pregen));
+  }
+
+  while (pregen.done < pregen.positions.size()) {
+    SDL_Delay(1000);
+    size_t done = pregen.done;
+    std::printf("%zu / %zu chunks (%.0f%%), %.0f chunks/s\n", done, pregen.positions.size(),
+                100.0f * done / pregen.positions.size(), done / Seconds(start));
+    std::fflush(stdout);
+  }
+  for (auto *thread : threads) {
+    SDL_WaitThread(thread, nullptr);
+  }
+
+  float generated = Seconds(start);
+  store.Flush();
+  float written = Seconds(start);
+  auto stats = store.GetStats();
+  size_t kept = pregen.kept;
+  size_t generatedChunks = pregen.positions.size() - kept;
+  std::printf("Generated %zu chunks with %zu faces in %.2f s, %.0f chunks/s, kept %zu already stored; %.1f MB "
+              "written in %.2f s\n",
+              generatedChunks, pregen.faces.load(), generated, generatedChunks / generated, kept,
+              stats.bytesWritten / (1024.0f * 1024.0f), written);
+  if (stats.written < static_cast<int>(generatedChunks)) {
+    std::fprintf(stderr, "Only %d of %zu chunks were written, rerun with --verbose for the errors\n", stats.written,
+                 generatedChunks);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}